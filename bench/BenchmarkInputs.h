@@ -0,0 +1,70 @@
+// Inputs shared by the benchmarks: test images and larger images built from them.
+
+#ifndef BENCHMARKINPUTS_H
+#define BENCHMARKINPUTS_H
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+
+/** All PNG images below the directory (recursive), sorted by path, as pairs of file name and image.
+ */
+inline std::vector<std::pair<std::string, cv::Mat>> loadTestImages(const std::string &directory)
+{
+	std::vector<std::string> paths;
+
+	if (std::filesystem::is_directory(directory))
+	{
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(directory))
+		{
+			if (entry.path().extension() == ".png")
+			{
+				paths.push_back(entry.path().string());
+			}
+		}
+	}
+
+	std::sort(paths.begin(), paths.end());
+
+	std::vector<std::pair<std::string, cv::Mat>> images;
+
+	for (const auto& path : paths)
+	{
+		cv::Mat img = cv::imread(path, 0);
+
+		if (img.data)
+		{
+			images.push_back({std::filesystem::path(path).filename().string(), img});
+		}
+	}
+
+	return images;
+}
+
+/** Repeats the image factor times in both directions. Keeps the structure (line widths, junctions, density) of the
+ *  image, unlike interpolation, which would thicken the edges.
+ */
+inline cv::Mat tileImage(const cv::Mat &img, int factor)
+{
+	cv::Mat tiled = cv::Mat::zeros(img.rows * factor, img.cols * factor, CV_8UC1);
+
+	for (int y = 0; y < tiled.rows; y++)
+	{
+		const uchar *source = img.ptr<uchar>(y % img.rows);
+		uchar *target = tiled.ptr<uchar>(y);
+
+		for (int x = 0; x < tiled.cols; x++)
+		{
+			target[x] = source[x % img.cols];
+		}
+	}
+
+	return tiled;
+}
+
+#endif // BENCHMARKINPUTS_H
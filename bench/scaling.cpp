@@ -0,0 +1,182 @@
+// Scaling benchmark for parallel tracing: runs EdgeProcessor::traceEdges with 1 to N threads on all test images and on
+// synthetic large inputs, reports the time, speedup and throughput and checks that all results equal the serial result.
+//
+// Usage: tracing_scaling [test image directory (default: testimages)] [maximum number of threads (default: all)] [repetitions (default: 3)]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "BenchmarkInputs.h"
+#include "EdgeProcessor.h"
+
+namespace
+{
+	constexpr int SYNTHETIC_MEGAPIXELS = 32; // Test images are tiled to roughly this size
+
+	/** Repeats the image in both directions until it has at least the given number of megapixels.
+	 */
+	cv::Mat tileImageToSize(const cv::Mat &img, int megapixels)
+	{
+		int factor = 1;
+
+		while ((double)img.rows * img.cols * factor * factor < megapixels * 1e6)
+		{
+			factor++;
+		}
+
+		return tileImage(img, factor);
+	}
+
+	/** Rectangular spiral with a gap of one pixel, a single edge which crosses all tiles.
+	 */
+	cv::Mat createSpiral(int size)
+	{
+		cv::Mat img = cv::Mat::zeros(size, size, CV_8UC1);
+		int x0 = 1, y0 = 1, x1 = size - 2, y1 = size - 2;
+
+		while (x0 < x1 && y0 < y1)
+		{
+			for (int x = x0; x <= x1; x++) img.at<uchar>(y0, x) = 255;
+			for (int y = y0; y <= y1; y++) img.at<uchar>(y, x1) = 255;
+			for (int x = x0; x <= x1; x++) img.at<uchar>(y1, x) = 255;
+			for (int y = y0 + 2; y <= y1; y++) img.at<uchar>(y, x0) = 255;
+			x0 += 2; y0 += 2; x1 -= 2; y1 -= 2;
+		}
+
+		return img;
+	}
+
+	/** Checks if two processors traced the same edges and edgeIds.
+	 */
+	bool isSameResult(const EdgeProcessor &a, const EdgeProcessor &b)
+	{
+		const Edges &edgesA = a.getEdges();
+		const Edges &edgesB = b.getEdges();
+
+		if (edgesA.size() != edgesB.size())
+		{
+			return false;
+		}
+
+		for (size_t edgeId = 0; edgeId < edgesA.size(); edgeId++)
+		{
+			if (edgesA.getEdge(edgeId) != edgesB.getEdge(edgeId))
+			{
+				return false;
+			}
+		}
+
+		const EdgeMap &mapA = a.getEdgeIdMap();
+		const EdgeMap &mapB = b.getEdgeIdMap();
+
+		for (int y = 0; y < mapA.getRows(); y++)
+		{
+			for (int x = 0; x < mapA.getCols(); x++)
+			{
+				EdgeIdSpan edgeIdsA = mapA.getEdgeIds(x, y);
+				EdgeIdSpan edgeIdsB = mapB.getEdgeIds(x, y);
+
+				if (!std::equal(edgeIdsA.begin(), edgeIdsA.end(), edgeIdsB.begin(), edgeIdsB.end()))
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/** Traces the image and returns the best time out of all repetitions (in seconds).
+	 */
+	double traceEdges(cv::Mat &img, int numberOfThreads, int repetitions, EdgeProcessor &edgeProcessor)
+	{
+		double bestTime = 0.0;
+
+		for (int i = 0; i < repetitions; i++)
+		{
+			edgeProcessor.setNumberOfThreads(numberOfThreads);
+
+			auto start = std::chrono::steady_clock::now();
+			edgeProcessor.traceEdges(img);
+			double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			bestTime = (i == 0) ? time : std::min(bestTime, time);
+		}
+
+		return bestTime;
+	}
+}
+
+int main(int argc, const char *argv[])
+{
+	std::string directory = (argc > 1) ? argv[1] : "testimages";
+	int maxThreads = (argc > 2) ? std::stoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+	int repetitions = (argc > 3) ? std::stoi(argv[3]) : 3;
+
+	// Inputs: all test images, tiled test images and a large spiral
+	std::vector<std::pair<std::string, cv::Mat>> inputs = loadTestImages(directory);
+
+	for (const auto& name : {"retina.png", "edge-image-canny.png"})
+	{
+		for (const auto& input : std::vector<std::pair<std::string, cv::Mat>>(inputs))
+		{
+			if (input.first == name)
+			{
+				inputs.push_back({input.first + " tiled", tileImageToSize(input.second, SYNTHETIC_MEGAPIXELS)});
+			}
+		}
+	}
+
+	inputs.push_back({"spiral 4000x4000", createSpiral(4000)});
+
+	// Thread counts: powers of two up to maxThreads and maxThreads itself
+	std::vector<int> threadCounts;
+
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+
+	threadCounts.push_back(maxThreads);
+
+	// Tracing prints a line per merge, which is not part of the measurement
+	std::ostringstream sink;
+	std::streambuf *coutBuffer = std::cout.rdbuf(sink.rdbuf());
+
+	std::printf("%-28s %10s %8s %12s %10s %10s %s\n", "image", "pixels", "threads", "time [ms]", "speedup", "MP/s", "result");
+
+	for (auto& input : inputs)
+	{
+		cv::Mat &img = input.second;
+
+		// Serial reference
+		EdgeProcessor reference;
+		double serialTime = traceEdges(img, 1, repetitions, reference);
+
+		for (int threads : threadCounts)
+		{
+			EdgeProcessor edgeProcessor;
+			double time = (threads == 1) ? serialTime : traceEdges(img, threads, repetitions, edgeProcessor);
+			bool equal = (threads == 1) || isSameResult(edgeProcessor, reference);
+
+			std::printf("%-28s %10zu %8d %12.2f %10.2f %10.1f %s\n", input.first.c_str(), (size_t)img.total(), threads, time * 1e3,
+				serialTime / time, img.total() / time / 1e6, equal ? "equal" : "DIFFERENT");
+			std::fflush(stdout);
+
+			sink.str("");
+		}
+	}
+
+	std::cout.rdbuf(coutBuffer);
+
+	return 0;
+}
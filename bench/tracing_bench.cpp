@@ -0,0 +1,377 @@
+// Microbenchmarks of the single stages of edge tracing: preprocessing, tracing, merging, cleanup, postprocessing and
+// the writers of the Visualizer. Each stage is timed on its own (the stages before it are set up untimed) on all test
+// images and on tiled versions of them, and reported per pixel and per edge.
+//
+// Uses Google Benchmark if it was found by CMake, otherwise a small built-in harness which reports the best time out
+// of all repetitions.
+//
+// Usage (Google Benchmark): tracing_bench [benchmark options] [test image directory (default: testimages)] [scales (default: 1,2,4)]
+// Usage (built-in harness): tracing_bench [test image directory (default: testimages)] [scales (default: 1,2,4)] [repetitions (default: 5)]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#ifdef TRACING_BENCH_GOOGLE_BENCHMARK
+#include <benchmark/benchmark.h>
+#endif
+
+#include "BenchmarkInputs.h"
+#include "EdgeProcessor.h"
+#include "ResultFile.h"
+#include "Visualizer.h"
+
+/** Access to the private stages of the EdgeProcessor (declared as friend).
+ */
+class TracingBenchmark
+{
+public:
+	/** Reset and initialization of traceEdges.
+	 */
+	static void init(EdgeProcessor &edgeProcessor, const cv::Mat &img)
+	{
+		edgeProcessor.resetTracing(img);
+	}
+
+	static void preprocessClusters(EdgeProcessor &edgeProcessor, const cv::Mat &img)
+	{
+		edgeProcessor.preprocessClusters(img);
+	}
+
+	static void traceEdgesSerial(EdgeProcessor &edgeProcessor, const cv::Mat &img)
+	{
+		edgeProcessor.traceEdgesSerial(img);
+	}
+
+	static void mergeEdges(EdgeProcessor &edgeProcessor, int firstId, int secondId)
+	{
+		edgeProcessor.mergeEdges(firstId, secondId);
+	}
+
+	static void flattenJoinedEdges(EdgeProcessor &edgeProcessor)
+	{
+		edgeProcessor.edges.flattenJoinedEdges();
+	}
+};
+
+namespace
+{
+	constexpr double MAX_MEGAPIXELS = 16.0; // Larger tiled images are skipped (keeps a run over all scales in the range of minutes)
+
+	/** One stage: setup brings the EdgeProcessor into the state before the stage (untimed), run executes the stage.
+	 */
+	struct Kernel
+	{
+		std::string name;
+		std::function<void(EdgeProcessor &, cv::Mat &)> setup;
+		std::function<void(EdgeProcessor &, cv::Mat &)> run;
+	};
+
+	/** One input image with the number of edges traced from it (used for the time per edge).
+	 */
+	struct Input
+	{
+		std::string name;
+		cv::Mat img;
+		size_t numberOfEdges;
+	};
+
+	/** Stages print progress (e.g. each merge), which is not part of the measurement.
+	 */
+	class CoutSilencer
+	{
+	public:
+		CoutSilencer() : coutBuffer(std::cout.rdbuf(sink.rdbuf())) {}
+		~CoutSilencer() { std::cout.rdbuf(coutBuffer); }
+
+	private:
+		std::ostringstream sink;
+		std::streambuf *coutBuffer;
+	};
+
+	size_t countNonEmptyEdges(const EdgeProcessor &edgeProcessor)
+	{
+		const Edges &edges = edgeProcessor.getEdges();
+		size_t count = 0;
+
+		for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+		{
+			count += (edges.getEdgeSize(edgeId) > 0);
+		}
+
+		return count;
+	}
+
+	volatile long long edgePointSum; // Result of the readEdges kernels (keeps the pass from being optimized away)
+
+	/** Sum of the coordinates of all edge points.
+	 */
+	long long sumEdgePoints(const Edges &edges)
+	{
+		long long sum = 0;
+
+		for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+		{
+			for (const auto& point : edges.getPoints(edgeId))
+			{
+				sum += point.x + point.y;
+			}
+		}
+
+		return sum;
+	}
+
+	/** Pairs of traced edges which share an end point in a cluster (the pairs postprocessing would connect).
+	 */
+	std::vector<std::pair<int, int>> findEdgePairs(const EdgeProcessor &edgeProcessor)
+	{
+		const Edges &edges = edgeProcessor.getEdges();
+		const EdgeMap &edgeMap = edgeProcessor.getEdgeIdMap();
+		std::map<std::pair<int, int>, int> unpairedEdges; // End point -> edgeId without partner
+		std::vector<std::pair<int, int>> pairs;
+		std::vector<bool> paired(edges.size(), false);
+
+		for (size_t id = 0; id < edges.size(); id++)
+		{
+			if (edges.getEdgeSize(id) == 0)
+			{
+				continue;
+			}
+
+			for (const auto& point : {edges.getStartPoint(id), edges.getEndPoint(id)})
+			{
+				if (paired[id] || edgeMap.getNumberOfClusterPoints(point.x, point.y) == 0)
+				{
+					continue;
+				}
+
+				auto unpaired = unpairedEdges.emplace(std::make_pair(point.x, point.y), id);
+
+				if (!unpaired.second && unpaired.first->second != (int)id && !paired[unpaired.first->second])
+				{
+					pairs.push_back({unpaired.first->second, (int)id});
+					paired[unpaired.first->second] = true;
+					paired[id] = true;
+					unpairedEdges.erase(unpaired.first);
+				}
+			}
+		}
+
+		return pairs;
+	}
+
+	std::vector<Kernel> createKernels()
+	{
+		auto trace = [](EdgeProcessor &edgeProcessor, cv::Mat &img) { edgeProcessor.traceEdges(img); };
+		std::string outputDirectory = (std::filesystem::temp_directory_path() / "tracing_bench").string();
+		std::filesystem::create_directories(outputDirectory);
+
+		// Pairs found during setup, merged by the run (the same processor is used for setup and run)
+		auto pairs = std::make_shared<std::vector<std::pair<int, int>>>();
+
+		// Next frame of traceNextFrame: the image with a 16x16 patch in the center inverted
+		auto nextFrame = std::make_shared<cv::Mat>();
+
+		std::vector<Kernel> kernels = {
+			{"preprocessClusters",
+				[](EdgeProcessor &edgeProcessor, cv::Mat &img) { TracingBenchmark::init(edgeProcessor, img); },
+				[](EdgeProcessor &edgeProcessor, cv::Mat &img) { TracingBenchmark::preprocessClusters(edgeProcessor, img); }},
+			{"traceEdge",
+				[](EdgeProcessor &edgeProcessor, cv::Mat &img) { TracingBenchmark::init(edgeProcessor, img); TracingBenchmark::preprocessClusters(edgeProcessor, img); },
+				[](EdgeProcessor &edgeProcessor, cv::Mat &img) { TracingBenchmark::traceEdgesSerial(edgeProcessor, img); }},
+			{"mergeEdges",
+				[pairs](EdgeProcessor &edgeProcessor, cv::Mat &img) { edgeProcessor.traceEdges(img); *pairs = findEdgePairs(edgeProcessor); },
+				[pairs](EdgeProcessor &edgeProcessor, cv::Mat &) { for (const auto& pair : *pairs) TracingBenchmark::mergeEdges(edgeProcessor, pair.first, pair.second);
+					TracingBenchmark::flattenJoinedEdges(edgeProcessor); }},
+			{"cleanUpEdges",
+				[](EdgeProcessor &edgeProcessor, cv::Mat &img) { edgeProcessor.traceEdges(img); edgeProcessor.connectEdgesInClusters(5, 40.0); },
+				[](EdgeProcessor &edgeProcessor, cv::Mat &) { edgeProcessor.cleanUpEdges(); }},
+			{"connectEdgesInClusters", trace,
+				[](EdgeProcessor &edgeProcessor, cv::Mat &) { edgeProcessor.connectEdgesInClusters(5, 40.0); }},
+			{"bridgeEdgeGaps", trace,
+				[](EdgeProcessor &edgeProcessor, cv::Mat &) { edgeProcessor.bridgeEdgeGaps(5, 30.0, 8); }},
+			{"bridgeEdgeGapsGlobal",
+				[](EdgeProcessor &edgeProcessor, cv::Mat &img) { edgeProcessor.setGlobalGapBridging(true); edgeProcessor.traceEdges(img); },
+				[](EdgeProcessor &edgeProcessor, cv::Mat &) { edgeProcessor.bridgeEdgeGaps(5, 30.0, 8); }},
+			{"traceNextFrame",
+				[nextFrame](EdgeProcessor &edgeProcessor, cv::Mat &img) { edgeProcessor.traceNextFrame(img); *nextFrame = img.clone();
+					cv::Mat patch = (*nextFrame)(cv::Rect(img.cols / 2, img.rows / 2, 16, 16) & cv::Rect(0, 0, img.cols, img.rows)); cv::bitwise_not(patch, patch); },
+				[nextFrame](EdgeProcessor &edgeProcessor, cv::Mat &) { edgeProcessor.traceNextFrame(*nextFrame); }},
+			{"removeEdgesShorterThan", trace,
+				[](EdgeProcessor &edgeProcessor, cv::Mat &) { edgeProcessor.removeEdgesShorterThan(30); }},
+			{"saveResultAsSVG", trace,
+				[outputDirectory](EdgeProcessor &edgeProcessor, cv::Mat &img) { Visualizer::saveResultAsSVG(img, edgeProcessor.getEdges(), edgeProcessor.getEdgeIdMap(), true, outputDirectory + "/tracedEdges.svg"); }},
+			{"saveResultAsCompactSVG", trace,
+				[outputDirectory](EdgeProcessor &edgeProcessor, cv::Mat &img) { Visualizer::saveResultAsCompactSVG(img, edgeProcessor.getEdges(), edgeProcessor.getEdgeIdMap(), true, outputDirectory + "/tracedEdgesCompact.svg"); }},
+			{"writeResultFile", trace,
+				[outputDirectory](EdgeProcessor &edgeProcessor, cv::Mat &) { ResultFileWriter::write(edgeProcessor.getEdges(), edgeProcessor.getEdgeIdMap(), true, outputDirectory + "/tracedEdges.etr"); }},
+			{"saveEdgeIdMapAsSVG", trace,
+				[outputDirectory](EdgeProcessor &edgeProcessor, cv::Mat &img) { Visualizer::saveEdgeIdMapAsSVG(img, edgeProcessor.getEdgeIdMap(), true, outputDirectory + "/edgeIdMap.svg"); }},
+			{"saveEdgesAsBinaryImage", trace,
+				[outputDirectory](EdgeProcessor &edgeProcessor, cv::Mat &img) { Visualizer::saveEdgesAsBinaryImage(img, edgeProcessor.getEdges(), outputDirectory + "/binary_edges.png"); }},
+		};
+
+		// One pass over all points of all edges with each edge storage
+		for (const auto& storage : {std::make_pair("Points", Edges::Storage::Points), std::make_pair("ChainCode", Edges::Storage::ChainCode),
+									std::make_pair("Pool", Edges::Storage::Pool)})
+		{
+			Edges::Storage edgeStorage = storage.second;
+
+			kernels.push_back({std::string("readEdges") + storage.first,
+				[edgeStorage](EdgeProcessor &edgeProcessor, cv::Mat &img) { edgeProcessor.setEdgeStorage(edgeStorage); edgeProcessor.traceEdges(img); },
+				[](EdgeProcessor &edgeProcessor, cv::Mat &) { edgePointSum = sumEdgePoints(edgeProcessor.getEdges()); }});
+		}
+
+		return kernels;
+	}
+
+	/** Runs setup and stage once, returns the time of the stage in seconds.
+	 */
+	double runKernel(const Kernel &kernel, Input &input)
+	{
+		CoutSilencer silencer;
+		EdgeProcessor edgeProcessor;
+		edgeProcessor.setNumberOfThreads(1);
+
+		kernel.setup(edgeProcessor, input.img);
+
+		auto start = std::chrono::steady_clock::now();
+		kernel.run(edgeProcessor, input.img);
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	/** Comma-separated list of scale factors, e.g. "1,2,4".
+	 */
+	std::vector<int> parseScales(const std::string &list)
+	{
+		std::vector<int> scales;
+		std::stringstream stream(list);
+		std::string item;
+
+		while (std::getline(stream, item, ','))
+		{
+			if (!item.empty() && std::stoi(item) > 0)
+			{
+				scales.push_back(std::stoi(item));
+			}
+		}
+
+		return scales;
+	}
+
+	/** All test images tiled with each scale factor (up to MAX_MEGAPIXELS), with their number of traced edges.
+	 */
+	std::vector<Input> createInputs(const std::string &directory, const std::vector<int> &scales)
+	{
+		std::vector<Input> inputs;
+
+		for (const auto& image : loadTestImages(directory))
+		{
+			for (int scale : scales)
+			{
+				if ((double)image.second.total() * scale * scale > MAX_MEGAPIXELS * 1e6)
+				{
+					continue;
+				}
+
+				Input input{image.first + " x" + std::to_string(scale), tileImage(image.second, scale), 0};
+
+				CoutSilencer silencer;
+				EdgeProcessor edgeProcessor;
+				edgeProcessor.traceEdges(input.img);
+				input.numberOfEdges = countNonEmptyEdges(edgeProcessor);
+
+				inputs.push_back(std::move(input));
+			}
+		}
+
+		return inputs;
+	}
+}
+
+#ifdef TRACING_BENCH_GOOGLE_BENCHMARK
+
+int main(int argc, char *argv[])
+{
+	benchmark::Initialize(&argc, argv);
+
+	std::string directory = (argc > 1) ? argv[1] : "testimages";
+	std::vector<int> scales = parseScales((argc > 2) ? argv[2] : "1,2,4");
+
+	static std::vector<Input> inputs = createInputs(directory, scales);
+	static std::vector<Kernel> kernels = createKernels();
+
+	for (const auto& kernel : kernels)
+	{
+		for (auto& input : inputs)
+		{
+			benchmark::RegisterBenchmark((kernel.name + "/" + input.name).c_str(), [&kernel, &input](benchmark::State &state)
+			{
+				double totalTime = 0.0;
+
+				for (auto _ : state)
+				{
+					double time = runKernel(kernel, input);
+					state.SetIterationTime(time);
+					totalTime += time;
+				}
+
+				double time = totalTime / std::max<benchmark::IterationCount>(1, state.iterations());
+				state.counters["ns/pixel"] = time * 1e9 / input.img.total();
+				state.counters["ns/edge"] = time * 1e9 / std::max<size_t>(1, input.numberOfEdges);
+			})->UseManualTime()->Unit(benchmark::kMillisecond);
+		}
+	}
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	return 0;
+}
+
+#else
+
+int main(int argc, const char *argv[])
+{
+	std::string directory = (argc > 1) ? argv[1] : "testimages";
+	std::vector<int> scales = parseScales((argc > 2) ? argv[2] : "1,2,4");
+	int repetitions = (argc > 3) ? std::stoi(argv[3]) : 5;
+
+	std::vector<Input> inputs = createInputs(directory, scales);
+	std::vector<Kernel> kernels = createKernels();
+
+	std::printf("%-24s %-28s %10s %8s %12s %10s %10s\n", "stage", "image", "pixels", "edges", "time [ms]", "ns/pixel", "ns/edge");
+
+	for (const auto& kernel : kernels)
+	{
+		for (auto& input : inputs)
+		{
+			double bestTime = 0.0;
+
+			for (int i = 0; i < repetitions; i++)
+			{
+				double time = runKernel(kernel, input);
+				bestTime = (i == 0) ? time : std::min(bestTime, time);
+			}
+
+			std::printf("%-24s %-28s %10zu %8zu %12.3f %10.2f %10.1f\n", kernel.name.c_str(), input.name.c_str(), (size_t)input.img.total(),
+				input.numberOfEdges, bestTime * 1e3, bestTime * 1e9 / input.img.total(), bestTime * 1e9 / std::max<size_t>(1, input.numberOfEdges));
+			std::fflush(stdout);
+		}
+	}
+
+	return 0;
+}
+
+#endif
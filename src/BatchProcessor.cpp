@@ -0,0 +1,319 @@
+#include "BatchProcessor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include <opencv2/imgcodecs/imgcodecs.hpp>
+
+#include "Parallel.h"
+#include "Visualizer.h"
+
+namespace
+{
+	constexpr int JOBS_PER_WORKER = 2; // Capacity of the queues between the stages per tracing worker
+
+	/** Image traced by the pipeline, the EdgeProcessor is taken from the pool by the tracing stage.
+	 */
+	struct BatchJob
+	{
+		std::string path;
+		cv::Mat img;
+		EdgeProcessor *edgeProcessor = nullptr;
+	};
+
+	/** True if the file extension belongs to an image format read by cv::imread.
+	 */
+	bool isImageFile(const std::filesystem::path &path)
+	{
+		std::string extension = path.extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+		for (const char *imageExtension : {".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".pgm", ".pbm", ".webp"})
+		{
+			if (extension == imageExtension)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/** Matches a file name against a pattern with the wildcards * (any sequence) and ? (any character).
+	 */
+	bool matchesPattern(const std::string &name, const std::string &pattern)
+	{
+		size_t n = 0, p = 0;
+		size_t starPattern = std::string::npos, starName = 0;
+
+		while (n < name.size())
+		{
+			if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+			{
+				n++;
+				p++;
+			}
+			else if (p < pattern.size() && pattern[p] == '*')
+			{
+				starPattern = p++;
+				starName = n;
+			}
+			else if (starPattern != std::string::npos)
+			{
+				// Let the last * match one more character
+				p = starPattern + 1;
+				n = ++starName;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		while (p < pattern.size() && pattern[p] == '*')
+		{
+			p++;
+		}
+
+		return p == pattern.size();
+	}
+
+} // end namespace
+
+BatchProcessor::BatchProcessor()
+{
+	numberOfThreads = 0;
+	numberOfWriters = 1;
+	outputDirectory = "./output";
+}
+
+void BatchProcessor::setNumberOfThreads(int numberOfThreads)
+{
+	BatchProcessor::numberOfThreads = numberOfThreads;
+}
+
+void BatchProcessor::setNumberOfWriters(int numberOfWriters)
+{
+	BatchProcessor::numberOfWriters = std::max(1, numberOfWriters);
+}
+
+void BatchProcessor::setOutputDirectory(const std::string &outputDirectory)
+{
+	BatchProcessor::outputDirectory = outputDirectory;
+}
+
+void BatchProcessor::setPostprocessing(std::function<void(EdgeProcessor &)> postprocessing)
+{
+	BatchProcessor::postprocessing = std::move(postprocessing);
+}
+
+std::vector<std::string> BatchProcessor::collectInputs(const std::string &input, std::string &baseDirectory)
+{
+	namespace fs = std::filesystem;
+
+	std::vector<std::string> paths;
+	fs::path inputPath(input);
+	std::error_code error;
+
+	if (fs::is_directory(inputPath, error))
+	{
+		baseDirectory = inputPath.string();
+
+		for (const auto& entry : fs::recursive_directory_iterator(inputPath, error))
+		{
+			if (entry.is_regular_file() && isImageFile(entry.path()))
+			{
+				paths.push_back(entry.path().string());
+			}
+		}
+
+		std::sort(paths.begin(), paths.end());
+	}
+	else if (input.find_first_of("*?") != std::string::npos)
+	{
+		fs::path directory = inputPath.has_parent_path() ? inputPath.parent_path() : fs::path(".");
+		std::string pattern = inputPath.filename().string();
+		baseDirectory = directory.string();
+
+		for (const auto& entry : fs::directory_iterator(directory, error))
+		{
+			if (entry.is_regular_file() && matchesPattern(entry.path().filename().string(), pattern))
+			{
+				paths.push_back(entry.path().string());
+			}
+		}
+
+		std::sort(paths.begin(), paths.end());
+	}
+	else if (inputPath.extension() == ".txt")
+	{
+		// Manifest: one path per line, empty lines and lines starting with # are skipped
+		std::ifstream manifest(input);
+		std::string line;
+		baseDirectory = ".";
+
+		while (std::getline(manifest, line))
+		{
+			line.erase(0, line.find_first_not_of(" \t\r"));
+			line.erase(line.find_last_not_of(" \t\r") + 1);
+
+			if (!line.empty() && line[0] != '#')
+			{
+				paths.push_back(line);
+			}
+		}
+	}
+	else
+	{
+		baseDirectory = inputPath.has_parent_path() ? inputPath.parent_path().string() : ".";
+		paths.push_back(input);
+	}
+
+	return paths;
+}
+
+std::string BatchProcessor::getOutputPath(const std::string &path, const std::string &baseDirectory) const
+{
+	namespace fs = std::filesystem;
+
+	std::error_code error;
+	fs::path relativePath = fs::relative(path, baseDirectory, error);
+
+	if (error || relativePath.empty() || *relativePath.begin() == "..")
+	{
+		relativePath = fs::path(path).filename();
+	}
+
+	return (fs::path(outputDirectory) / relativePath).replace_extension(".svg").string();
+}
+
+BatchStatistics BatchProcessor::process(const std::vector<std::string> &paths, const std::string &baseDirectory)
+{
+	int tracers = resolveNumberOfThreads(numberOfThreads);
+	size_t capacity = JOBS_PER_WORKER * tracers;
+
+	// Stages: decode -> trace -> write
+	BoundedQueue<BatchJob> decodedJobs(capacity);
+	BoundedQueue<BatchJob> tracedJobs(capacity);
+
+	// Each EdgeProcessor is either idle, in use by a tracer or waiting for a writer (plus one per writer)
+	std::vector<EdgeProcessor> edgeProcessors(tracers + capacity + numberOfWriters);
+	BoundedQueue<EdgeProcessor *> idleEdgeProcessors(edgeProcessors.size());
+
+	for (auto& edgeProcessor : edgeProcessors)
+	{
+		idleEdgeProcessors.push(&edgeProcessor);
+	}
+
+	std::atomic<size_t> numberOfImages(0);
+	std::atomic<size_t> numberOfFailures(0);
+	std::atomic<uint64_t> numberOfPixels(0);
+	std::atomic<int> activeTracers(tracers);
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+
+	threads.emplace_back([&]
+	{
+		for (const auto& path : paths)
+		{
+			cv::Mat img = cv::imread(path, cv::IMREAD_GRAYSCALE);
+
+			if (!img.data)
+			{
+				std::cerr << "Could not find or open image " << path << "." << std::endl;
+				numberOfFailures++;
+				continue;
+			}
+
+			decodedJobs.push({path, img, nullptr});
+		}
+
+		decodedJobs.close();
+	});
+
+	for (int i = 0; i < tracers; i++)
+	{
+		threads.emplace_back([&]
+		{
+			BatchJob job;
+
+			while (decodedJobs.pop(job))
+			{
+				idleEdgeProcessors.pop(job.edgeProcessor);
+				job.edgeProcessor->traceEdges(job.img);
+
+				if (postprocessing)
+				{
+					postprocessing(*job.edgeProcessor);
+				}
+
+				job.edgeProcessor->cleanUpEdges();
+				tracedJobs.push(std::move(job));
+			}
+
+			// The last tracer ends the write stage
+			if (--activeTracers == 0)
+			{
+				tracedJobs.close();
+			}
+		});
+	}
+
+	for (int i = 0; i < numberOfWriters; i++)
+	{
+		threads.emplace_back([&]
+		{
+			BatchJob job;
+
+			while (tracedJobs.pop(job))
+			{
+				std::string outputPath = getOutputPath(job.path, baseDirectory);
+				std::error_code error;
+				std::filesystem::create_directories(std::filesystem::path(outputPath).parent_path(), error);
+
+				if (Visualizer::saveResultAsCompactSVG(job.img, job.edgeProcessor->getEdges(), job.edgeProcessor->getEdgeIdMap(), true, outputPath, false))
+				{
+					numberOfImages++;
+					numberOfPixels += job.img.total();
+				}
+				else
+				{
+					numberOfFailures++;
+				}
+
+				idleEdgeProcessors.push(job.edgeProcessor);
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	BatchStatistics statistics;
+	statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	statistics.numberOfImages = numberOfImages;
+	statistics.numberOfFailures = numberOfFailures;
+	statistics.numberOfPixels = numberOfPixels;
+
+	return statistics;
+}
+
+void BatchProcessor::printStatistics(const BatchStatistics &statistics)
+{
+	double seconds = std::max(statistics.seconds, 1e-9);
+
+	std::cout << "Processed " << statistics.numberOfImages << " images (" << statistics.numberOfFailures << " failed, "
+			  << statistics.numberOfPixels / 1e6 << " MP) in " << statistics.seconds << " s." << std::endl;
+	std::cout << "Throughput: " << statistics.numberOfImages / seconds << " images/s, "
+			  << statistics.numberOfPixels / 1e6 / seconds << " MP/s." << std::endl;
+}
@@ -0,0 +1,82 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "EdgeProcessor.h"
+
+/** Result of a batch run.
+ */
+struct BatchStatistics
+{
+	size_t numberOfImages = 0;		//!< Number of traced and written images.
+	size_t numberOfFailures = 0;	//!< Number of images which could not be read or written.
+	uint64_t numberOfPixels = 0;	//!< Total number of pixels of all traced images.
+	double seconds = 0.0;			//!< Wall time of the whole run.
+};
+
+/** Traces many images in one process. The images pass a pipeline of three stages connected by bounded queues:
+ *  one thread decodes the images, a pool of EdgeProcessors traces them and writer threads save the results.
+ *  Each image gets its own output path, so results of different images do not overwrite each other.
+ */
+class BatchProcessor
+{
+public:
+	BatchProcessor();
+
+	/** Number of tracing workers, each with its own EdgeProcessor (default: 0 = number of hardware threads).
+	 */
+	void setNumberOfThreads(int numberOfThreads);
+
+	/** Number of threads writing the results (default: 1).
+	 */
+	void setNumberOfWriters(int numberOfWriters);
+
+	/** Directory of the results (default: ./output). The result of an image is written to the same relative path
+	 *  as the image below the input directory, with the extension .svg.
+	 */
+	void setOutputDirectory(const std::string &outputDirectory);
+
+	/** Postprocessing applied to each traced image before cleanUpEdges (default: none).
+	 */
+	void setPostprocessing(std::function<void(EdgeProcessor &)> postprocessing);
+
+	/** Collects the input images of a batch.
+	 *  @input			A directory (all images in it and its subdirectories), a pattern with * and ? in the file name
+	 *  				(e.g. images/tile_*.png) or a manifest file (.txt, one path per line).
+	 *  @baseDirectory	Output: directory to which the output paths are relative.
+	 *  @returns		Paths of the images (sorted for directories and patterns, in file order for manifests).
+	 */
+	static std::vector<std::string> collectInputs(const std::string &input, std::string &baseDirectory);
+
+	/** Traces all images and writes the results. No message is printed per written file (the writers would
+	 *  interleave them), failures are reported on std::cerr.
+	 *  @paths			Paths of the images.
+	 *  @baseDirectory	Directory to which the output paths are relative (see collectInputs).
+	 *  @returns		Number of images, pixels and failures and the wall time.
+	 */
+	BatchStatistics process(const std::vector<std::string> &paths, const std::string &baseDirectory);
+
+	/** Prints the number of processed images and the throughput in images/s and pixels/s.
+	 */
+	static void printStatistics(const BatchStatistics &statistics);
+
+private:
+	int numberOfThreads;		//!< Number of tracing workers (0 = number of hardware threads).
+
+	int numberOfWriters;		//!< Number of threads writing results.
+
+	std::string outputDirectory;	//!< Directory of the results.
+
+	std::function<void(EdgeProcessor &)> postprocessing;	//!< Applied to each image after tracing.
+
+	/** Output path of an image: relative path below the base directory (only the file name for images outside of it)
+	 *  in the output directory, with the extension .svg.
+	 */
+	std::string getOutputPath(const std::string &path, const std::string &baseDirectory) const;
+};
+
+#endif // BATCHPROCESSOR_H
@@ -0,0 +1,345 @@
+#include "ComponentLabeling.h"
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+#include "Neighborhood.h"
+#include "Parallel.h"
+
+namespace
+{
+	constexpr uchar GROUPED_CLUSTER_POINT = 254;	// ambiguityMask value of cluster points while they are grouped
+	constexpr int SEEDS_PER_TASK = 64;				// Number of clusters grown by one thread at a time
+
+	/** Labels the connected components of the pixels for which isComponentPixel(x, y) is true (connected by direct
+	 *  neighbors, the relation is symmetric) and returns the first pixel (in raster order) of each component.
+	 */
+	template <typename IsComponentPixel>
+	std::vector<int> findSeeds(const cv::Mat &binaryCodes, IsComponentPixel isComponentPixel, int tileSize, int numberOfThreads)
+	{
+		// Labels of the components within one tile
+		struct TileComponents
+		{
+			std::vector<int> firstPixels;					//!< First pixel (in raster order) of each component.
+			std::vector<std::pair<int, int>> borderPixels;	//!< Pixel index and component of all component pixels at the tile border (sorted).
+			std::vector<std::pair<int, int>> seamLinks;		//!< Component and index of a direct neighbor in another tile.
+		};
+
+		int rows = binaryCodes.rows;
+		int cols = binaryCodes.cols;
+		tileSize = std::max(1, tileSize);
+		int tilesX = (cols + tileSize - 1) / tileSize;
+		int tilesY = (rows + tileSize - 1) / tileSize;
+		int threads = resolveNumberOfThreads(numberOfThreads);
+
+		std::vector<TileComponents> tiles(tilesX * tilesY);
+		std::vector<std::vector<int>> labels(threads); // Scratch data per thread
+
+		parallelFor(tilesX * tilesY, threads, [&](int tile, int thread)
+		{
+			int x0 = (tile % tilesX) * tileSize;
+			int y0 = (tile / tilesX) * tileSize;
+			int width = std::min(tileSize, cols - x0);
+			int height = std::min(tileSize, rows - y0);
+
+			TileComponents &components = tiles[tile];
+			std::vector<int> &label = labels[thread];
+			label.assign(width * height, -1);
+
+			std::vector<cv::Point> stack;
+
+			for (int y = y0; y < y0 + height; y++)
+			{
+				for (int x = x0; x < x0 + width; x++)
+				{
+					if (label[(x - x0) + (y - y0) * width] >= 0 || !isComponentPixel(x, y))
+					{
+						continue;
+					}
+
+					// New component, the scan reaches its first pixel first
+					int component = components.firstPixels.size();
+					components.firstPixels.push_back(x + y * cols);
+					label[(x - x0) + (y - y0) * width] = component;
+					stack.push_back(cv::Point(x, y));
+
+					while (!stack.empty())
+					{
+						cv::Point p = stack.back();
+						stack.pop_back();
+
+						const NeighborhoodInfo &neighborhood = NEIGHBORHOOD_TABLE[binaryCodes.at<uchar>(p)];
+
+						for (int i = 0; i < neighborhood.numberOfNeighbors; i++)
+						{
+							cv::Point n(p.x + neighborhood.dx[i], p.y + neighborhood.dy[i]);
+
+							if (!isComponentPixel(n.x, n.y))
+							{
+								continue;
+							}
+
+							if (n.x < x0 || n.y < y0 || n.x >= x0 + width || n.y >= y0 + height)
+							{
+								components.seamLinks.push_back({component, n.x + n.y * cols});
+							}
+							else if (label[(n.x - x0) + (n.y - y0) * width] < 0)
+							{
+								label[(n.x - x0) + (n.y - y0) * width] = component;
+								stack.push_back(n);
+							}
+						}
+					}
+				}
+			}
+
+			// Components at the tile border, seam links of other tiles refer to these pixels
+			auto addBorderPixel = [&](int x, int y)
+			{
+				if (label[(x - x0) + (y - y0) * width] >= 0)
+				{
+					components.borderPixels.push_back({x + y * cols, label[(x - x0) + (y - y0) * width]});
+				}
+			};
+
+			for (int x = x0; x < x0 + width; x++)
+			{
+				addBorderPixel(x, y0);
+				addBorderPixel(x, y0 + height - 1);
+			}
+
+			for (int y = y0; y < y0 + height; y++)
+			{
+				addBorderPixel(x0, y);
+				addBorderPixel(x0 + width - 1, y);
+			}
+
+			std::sort(components.borderPixels.begin(), components.borderPixels.end());
+			components.borderPixels.erase(std::unique(components.borderPixels.begin(), components.borderPixels.end()), components.borderPixels.end());
+		});
+
+		// Stitching: components of all tiles are numbered consecutively and merged along the seam links
+		std::vector<int> offsets(tiles.size() + 1, 0);
+
+		for (size_t t = 0; t < tiles.size(); t++)
+		{
+			offsets[t + 1] = offsets[t] + tiles[t].firstPixels.size();
+		}
+
+		ConcurrentUnionFind unionFind(offsets.back());
+
+		parallelFor(tiles.size(), threads, [&](int t, int)
+		{
+			for (const auto& link : tiles[t].seamLinks)
+			{
+				int x = link.second % cols;
+				int y = link.second / cols;
+				int other = (x / tileSize) + (y / tileSize) * tilesX;
+
+				const auto& borderPixels = tiles[other].borderPixels;
+				auto it = std::lower_bound(borderPixels.begin(), borderPixels.end(), std::make_pair(link.second, -1));
+
+				unionFind.unite(offsets[t] + link.first, offsets[other] + it->second);
+			}
+		});
+
+		// Seed of each component = smallest first pixel of all its parts
+		std::vector<int> seeds(offsets.back(), INT_MAX);
+
+		for (size_t t = 0; t < tiles.size(); t++)
+		{
+			for (size_t c = 0; c < tiles[t].firstPixels.size(); c++)
+			{
+				int &seed = seeds[unionFind.find(offsets[t] + c)];
+				seed = std::min(seed, tiles[t].firstPixels[c]);
+			}
+		}
+
+		seeds.erase(std::remove(seeds.begin(), seeds.end(), INT_MAX), seeds.end());
+		std::sort(seeds.begin(), seeds.end());
+
+		return seeds;
+	}
+
+	/** Collects the cluster points connected to the seed (breadth-first) and marks them as grouped.
+	 */
+	void growCluster(const cv::Mat &binaryCodes, cv::Mat &ambiguityMask, cv::Point seed, std::vector<cv::Point> &points)
+	{
+		points.push_back(seed);
+		ambiguityMask.at<uchar>(seed) = GROUPED_CLUSTER_POINT;
+
+		for (size_t c = 0; c < points.size(); c++)
+		{
+			cv::Point p = points[c];
+			const NeighborhoodInfo &neighborhood = NEIGHBORHOOD_TABLE[binaryCodes.at<uchar>(p)];
+
+			for (int i = 0; i < neighborhood.numberOfNeighbors; i++)
+			{
+				cv::Point n(p.x + neighborhood.dx[i], p.y + neighborhood.dy[i]);
+
+				// True if neighbor n is a cluster point and not (already) part of a cluster
+				if (ambiguityMask.at<uchar>(n) == CLUSTER_POINT)
+				{
+					ambiguityMask.at<uchar>(n) = GROUPED_CLUSTER_POINT;
+					points.push_back(n);
+				}
+			}
+		}
+	}
+
+	/** Marks the points of a grouped cluster as cluster points again.
+	 */
+	void restoreClusterPoints(cv::Mat &ambiguityMask, const std::vector<cv::Point> &points)
+	{
+		for (const auto& point : points)
+		{
+			ambiguityMask.at<uchar>(point) = CLUSTER_POINT;
+		}
+	}
+
+} // end namespace
+
+ConcurrentUnionFind::ConcurrentUnionFind(int size) : parents(size)
+{
+	for (int i = 0; i < size; i++)
+	{
+		parents[i].store(i, std::memory_order_relaxed);
+	}
+}
+
+int ConcurrentUnionFind::find(int i)
+{
+	while (true)
+	{
+		int parent = parents[i].load(std::memory_order_relaxed);
+
+		if (parent == i)
+		{
+			return i;
+		}
+
+		// Path halving, a failed update only means that another thread changed the parent in the meantime
+		int grandparent = parents[parent].load(std::memory_order_relaxed);
+
+		if (grandparent != parent)
+		{
+			parents[i].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+		}
+
+		i = grandparent;
+	}
+}
+
+void ConcurrentUnionFind::unite(int a, int b)
+{
+	while (true)
+	{
+		a = find(a);
+		b = find(b);
+
+		if (a == b)
+		{
+			return;
+		}
+
+		if (a < b)
+		{
+			std::swap(a, b);
+		}
+
+		// Link the larger root a to b, retry if a is no root anymore
+		if (parents[a].compare_exchange_strong(a, b, std::memory_order_relaxed))
+		{
+			return;
+		}
+	}
+}
+
+std::vector<int> findEdgeComponentSeeds(const cv::Mat &img, const cv::Mat &binaryCodes, const cv::Mat &ambiguityMask, int tileSize, int numberOfThreads)
+{
+	// Non-cluster edge pixels are connected by the direct neighbor relation (as in EdgeProcessor::traceEdge)
+	auto isComponentPixel = [&](int x, int y) { return img.at<uchar>(y, x) > 0 && ambiguityMask.at<uchar>(y, x) == 0; };
+
+	return findSeeds(binaryCodes, isComponentPixel, tileSize, numberOfThreads);
+}
+
+std::vector<std::vector<cv::Point>> groupClusters(const cv::Mat &binaryCodes, cv::Mat &ambiguityMask, int tileSize, int numberOfThreads)
+{
+	std::vector<std::vector<cv::Point>> clusters;
+	int threads = resolveNumberOfThreads(numberOfThreads);
+
+	if (threads == 1)
+	{
+		// Only start at cluster points which are not yet part of a cluster
+		for (int y = 0; y < ambiguityMask.rows; y++)
+		{
+			for (int x = 0; x < ambiguityMask.cols; x++)
+			{
+				if (ambiguityMask.at<uchar>(y, x) == CLUSTER_POINT)
+				{
+					clusters.emplace_back();
+					growCluster(binaryCodes, ambiguityMask, cv::Point(x, y), clusters.back());
+				}
+			}
+		}
+
+		for (const auto& points : clusters)
+		{
+			restoreClusterPoints(ambiguityMask, points);
+		}
+	}
+	else
+	{
+		// The first point of a cluster is the first point the serial scan reaches. Clusters do not share points, so
+		// they can be grown (and marked) concurrently.
+		auto isClusterPoint = [&](int x, int y) { return ambiguityMask.at<uchar>(y, x) == CLUSTER_POINT; };
+		std::vector<int> seeds = findSeeds(binaryCodes, isClusterPoint, tileSize, threads);
+
+		clusters.resize(seeds.size());
+		int numberOfTasks = (seeds.size() + SEEDS_PER_TASK - 1) / SEEDS_PER_TASK;
+
+		parallelFor(numberOfTasks, threads, [&](int task, int)
+		{
+			for (size_t i = task * SEEDS_PER_TASK; i < std::min(seeds.size(), (size_t)(task + 1) * SEEDS_PER_TASK); i++)
+			{
+				growCluster(binaryCodes, ambiguityMask, cv::Point(seeds[i] % ambiguityMask.cols, seeds[i] / ambiguityMask.cols), clusters[i]);
+				restoreClusterPoints(ambiguityMask, clusters[i]);
+			}
+		});
+	}
+
+	return clusters;
+}
+
+std::vector<std::vector<cv::Point>> groupClustersFromSeeds(const cv::Mat &binaryCodes, cv::Mat &ambiguityMask, const std::vector<int> &seeds)
+{
+	std::vector<std::vector<cv::Point>> clusters;
+
+	for (int seed : seeds)
+	{
+		cv::Point point(seed % ambiguityMask.cols, seed / ambiguityMask.cols);
+
+		if (ambiguityMask.at<uchar>(point) == CLUSTER_POINT)
+		{
+			clusters.emplace_back();
+			growCluster(binaryCodes, ambiguityMask, point, clusters.back());
+		}
+	}
+
+	for (const auto& points : clusters)
+	{
+		restoreClusterPoints(ambiguityMask, points);
+	}
+
+	return clusters;
+}
+
+std::vector<std::vector<cv::Point>> findClusters(const cv::Mat &img, int numberOfThreads, int tileSize)
+{
+	cv::Mat binaryCodes;
+	cv::Mat ambiguityMask;
+	classifyNeighborhoods(img, binaryCodes, ambiguityMask, numberOfThreads);
+
+	return groupClusters(binaryCodes, ambiguityMask, tileSize, numberOfThreads);
+}
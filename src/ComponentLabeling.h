@@ -0,0 +1,73 @@
+#ifndef COMPONENTLABELING_H
+#define COMPONENTLABELING_H
+
+#include <atomic>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/** Union-find which can be used by several threads at the same time without locks. Roots are linked with
+ *  compare-and-swap, always from the larger to the smaller element, so the root of a set is its smallest element.
+ */
+class ConcurrentUnionFind
+{
+public:
+	explicit ConcurrentUnionFind(int size);
+
+	/** Returns the root of the set of element i (halves the path on the way).
+	 */
+	int find(int i);
+
+	/** Merges the sets of the elements a and b.
+	 */
+	void unite(int a, int b);
+
+private:
+	std::vector<std::atomic<int>> parents;
+};
+
+/** Finds the seed of each edge component, i.e. the first pixel (in raster order) of each set of non-cluster edge pixels
+ *  which are connected by direct neighbors. Components are labeled per tile in parallel and merged at the tile borders
+ *  with a concurrent union-find.
+ *  @img				Input image.
+ *  @binaryCodes		Binary code of each pixel (see classifyNeighborhoods).
+ *  @ambiguityMask		Cluster points of the image (see classifyNeighborhoods).
+ *  @tileSize			Side length of the tiles.
+ *  @numberOfThreads	Number of threads (0 = number of hardware threads).
+ *  @returns			Pixel indices (x + y * cols) of the seeds in ascending order.
+ */
+std::vector<int> findEdgeComponentSeeds(const cv::Mat &img, const cv::Mat &binaryCodes, const cv::Mat &ambiguityMask, int tileSize, int numberOfThreads=1);
+
+/** Groups the cluster points into clusters (cluster points connected by direct neighbors). Clusters are ordered by their
+ *  first point in raster order, the points of a cluster are in breadth-first order from it. With more than one thread,
+ *  the first points are found by labeling the tiles in parallel (as in findEdgeComponentSeeds) and the clusters are
+ *  grown concurrently.
+ *  @binaryCodes		Binary code of each pixel (see classifyNeighborhoods).
+ *  @ambiguityMask		Cluster points of the image (see classifyNeighborhoods), only modified temporarily.
+ *  @tileSize			Side length of the tiles.
+ *  @numberOfThreads	Number of threads (0 = number of hardware threads).
+ *  @returns			Points of each cluster.
+ */
+std::vector<std::vector<cv::Point>> groupClusters(const cv::Mat &binaryCodes, cv::Mat &ambiguityMask, int tileSize, int numberOfThreads=1);
+
+/** Groups the cluster points connected to the seeds into clusters, in the same way as groupClusters does for the whole
+ *  image. Used to regroup the cluster points of a part of the image (see EdgeProcessor::traceNextFrame).
+ *  @binaryCodes		Binary code of each pixel (see classifyNeighborhoods).
+ *  @ambiguityMask		Cluster points of the image (see classifyNeighborhoods), only modified temporarily.
+ *  @seeds				Pixel indices (x + y * cols) in ascending order. Each seed which is a cluster point starts a new
+ *  					cluster, unless it was reached from an earlier seed. All points of these clusters must be seeds, so
+ *  					that the clusters start at their first point in raster order.
+ *  @returns			Points of each cluster (see groupClusters).
+ */
+std::vector<std::vector<cv::Point>> groupClustersFromSeeds(const cv::Mat &binaryCodes, cv::Mat &ambiguityMask, const std::vector<int> &seeds);
+
+/** Standalone cluster detection for a binary edge image (same clusters as EdgeProcessor::traceEdges), e.g. to
+ *  preprocess images without tracing them.
+ *  @img				Binary input image (CV_8UC1).
+ *  @numberOfThreads	Number of threads (0 = number of hardware threads).
+ *  @tileSize			Side length of the tiles used with more than one thread.
+ *  @returns			Points of each cluster (see groupClusters).
+ */
+std::vector<std::vector<cv::Point>> findClusters(const cv::Mat &img, int numberOfThreads=1, int tileSize=256);
+
+#endif // COMPONENTLABELING_H
@@ -1,37 +1,206 @@
 #include "EdgeMap.h"
 
+#include <algorithm>
 #include <set>
+#include <utility>
 
 namespace { constexpr bool WRITE_EDGE_IDS_AT_ALL_CLUSTER_POINTS = false; }
 
-EdgeMap::EdgeMap() : rows (0), cols(0)
+EdgeMap::EdgeMap() : backend(Backend::Dense), rows (0), cols(0)
 {
 }
 
-void EdgeMap::init(int rows, int cols)
+void EdgeMap::init(int rows, int cols, Backend backend)
 {
 	// Reset
-	dataEdgeIds.clear();
-	dataClusters.clear();
+	dataEdgeIds = std::vector<std::vector<int>>();
+	clusterIds = std::vector<int32_t>();
+	clusters.clear();
+	freeClusters.clear();
+	labels = std::vector<int32_t>();
+	overflowEdgeIds.clear();
+	freeOverflowEntries.clear();
+	pixelTable.clear();
+	edgeIdTargets.clear();
+	edgeIdRedirectionOrder.clear();
+	edgeIdParents.clear();
+	numberOfRedirections = 0;
 
 	// Save number of image rows and cols
 	EdgeMap::rows = rows;
 	EdgeMap::cols = cols;
+	EdgeMap::backend = (backend == Backend::Automatic) ? Backend::Dense : backend;
 
-	// Initialize data structure
-	dataEdgeIds.resize(rows * cols);
-	dataClusters.resize(rows * cols);
+	// Initialize data structure (nothing to do for the sparse backend)
+	if (EdgeMap::backend == Backend::Vector)
+	{
+		dataEdgeIds.resize(rows * cols);
+		clusterIds.assign(rows * cols, NO_CLUSTER);
+	}
+	else if (EdgeMap::backend == Backend::Dense)
+	{
+		labels.assign(rows * cols, NO_EDGE);
+		clusterIds.assign(rows * cols, NO_CLUSTER);
+	}
+}
+
+EdgeMap::Backend EdgeMap::getBackend() const
+{
+	return backend;
 }
 
-const std::vector<int> &EdgeMap::getEdgeIds(int x, int y) const
+size_t EdgeMap::getNumberOfSparseEntries() const
 {
-	return dataEdgeIds[x + y * cols];
+	return pixelTable.size();
+}
+
+int32_t &EdgeMap::getLabelReference(int index)
+{
+	if (backend == Backend::Sparse)
+	{
+		return pixelTable.findOrInsert(index).label;
+	}
+
+	return labels[index];
+}
+
+void EdgeMap::setClusterId(int index, int32_t id)
+{
+	if (backend == Backend::Sparse)
+	{
+		if (id != NO_CLUSTER)
+		{
+			pixelTable.findOrInsert(index).clusterId = id;
+		}
+		else if (pixelTable.find(index))
+		{
+			pixelTable.findOrInsert(index).clusterId = NO_CLUSTER; // No insertion, entry exists
+		}
+
+		return;
+	}
+
+	clusterIds[index] = id;
+}
+
+EdgeIdSpan EdgeMap::getEdgeIds(int x, int y) const
+{
+	if (!edgeIdTargets.empty())
+	{
+		resolveEdgeIds(x + y * cols);
+	}
+
+	if (backend == Backend::Vector)
+	{
+		const std::vector<int> &edgeIds = dataEdgeIds[x + y * cols];
+		return EdgeIdSpan(edgeIds.data(), edgeIds.size());
+	}
+
+	const int32_t *label = findLabel(x + y * cols);
+
+	if (label == nullptr || *label == NO_EDGE)
+	{
+		return EdgeIdSpan();
+	}
+	else if (*label >= 0)
+	{
+		return EdgeIdSpan(label, 1); // The label itself is the only edgeId
+	}
+
+	const std::vector<int> &edgeIds = overflowEdgeIds[-(*label + 2)];
+	return EdgeIdSpan(edgeIds.data(), edgeIds.size());
+}
+
+bool EdgeMap::containsEdgeId(int x, int y, int edgeId) const
+{
+	EdgeIdSpan edgeIds = getEdgeIds(x, y);
+	return std::find(edgeIds.begin(), edgeIds.end(), edgeId) != edgeIds.end();
+}
+
+void EdgeMap::appendEdgeId(int x, int y, int edgeId)
+{
+	invalidateClusterEdgeIds(x, y);
+
+	// Appended after the edgeIds which replace redirected ones
+	if (!edgeIdTargets.empty())
+	{
+		resolveEdgeIds(x + y * cols);
+	}
+
+	if (backend == Backend::Vector)
+	{
+		dataEdgeIds[x + y * cols].push_back(edgeId);
+		return;
+	}
+
+	int32_t &label = getLabelReference(x + y * cols);
+
+	if (label == NO_EDGE)
+	{
+		label = edgeId;
+	}
+	else if (label >= 0)
+	{
+		// Second edgeId at this position, move both edgeIds to the overflow table
+		int32_t entry;
+
+		if (!freeOverflowEntries.empty())
+		{
+			entry = freeOverflowEntries.back();
+			freeOverflowEntries.pop_back();
+		}
+		else
+		{
+			entry = overflowEdgeIds.size();
+			overflowEdgeIds.emplace_back();
+		}
+
+		overflowEdgeIds[entry] = {label, edgeId};
+		label = -(entry + 2);
+	}
+	else
+	{
+		overflowEdgeIds[-(label + 2)].push_back(edgeId);
+	}
 }
 
 const std::vector<cv::Point> &EdgeMap::getClusterPoints(int x, int y) const
 {
+	static const std::vector<cv::Point> noClusterPoints;
+
 	// Cluster points at given position
-	return dataClusters[x + y * cols];
+	int32_t id = findCluster(x, y);
+	return (id == NO_CLUSTER) ? noClusterPoints : clusters[id].points;
+}
+
+std::vector<const std::vector<cv::Point> *> EdgeMap::getAllClusterPoints() const
+{
+	std::vector<const std::vector<cv::Point> *> allClusterPoints;
+
+	for (size_t id = 0; id < clusters.size(); id++)
+	{
+		// Only roots hold points, cleared clusters have none
+		if (clusters[id].parent == static_cast<int32_t>(id) && !clusters[id].points.empty())
+		{
+			allClusterPoints.push_back(&clusters[id].points);
+		}
+	}
+
+	return allClusterPoints;
+}
+
+std::vector<cv::Point> EdgeMap::getClusterPositions() const
+{
+	auto rasterOrder = [](const cv::Point &a, const cv::Point &b) { return (a.y < b.y) || (a.y == b.y && a.x < b.x); };
+	std::vector<cv::Point> positions;
+
+	for (const auto *points : getAllClusterPoints())
+	{
+		positions.push_back(*std::min_element(points->begin(), points->end(), rasterOrder));
+	}
+
+	std::sort(positions.begin(), positions.end(), rasterOrder);
+	return positions;
 }
 
 int EdgeMap::getCols() const
@@ -44,19 +213,82 @@ int EdgeMap::getRows() const
 	return rows;
 }
 
+std::vector<int> EdgeMap::getEdgePixelIndices() const
+{
+	std::vector<int> indices;
+
+	if (backend == Backend::Sparse)
+	{
+		// Entries of pixels which lost their edgeIds are kept, so the label is checked as well
+		for (const auto& entry : pixelTable.getSlots())
+		{
+			if (entry.index != SparsePixelTable::EMPTY && entry.label != NO_EDGE)
+			{
+				indices.push_back(entry.index);
+			}
+		}
+
+		std::sort(indices.begin(), indices.end());
+		return indices;
+	}
+
+	for (int index = 0; index < rows * cols; index++)
+	{
+		if ((backend == Backend::Vector) ? !dataEdgeIds[index].empty() : labels[index] != NO_EDGE)
+		{
+			indices.push_back(index);
+		}
+	}
+
+	return indices;
+}
+
 int EdgeMap::getMaxEdgeId() const
 {
 	int maxId = 0;
 
+	// The labels are only read directly if no edgeIds have to be resolved
+	if (backend != Backend::Vector && edgeIdTargets.empty())
+	{
+		// Single edgeIds are stored in the labels, all others in the overflow table
+		if (backend == Backend::Dense)
+		{
+			for (int32_t label : labels)
+			{
+				maxId = std::max(maxId, label);
+			}
+		}
+		else
+		{
+			for (const auto& entry : pixelTable.getSlots())
+			{
+				if (entry.index != SparsePixelTable::EMPTY)
+				{
+					maxId = std::max(maxId, entry.label);
+				}
+			}
+		}
+
+		for (const auto& edgeIds : overflowEdgeIds)
+		{
+			for (int edgeId : edgeIds)
+			{
+				maxId = std::max(maxId, edgeId);
+			}
+		}
+
+		return maxId;
+	}
+
 	for (int y = 0; y < rows; y++)
 	{
 		for (int x = 0; x < cols; x++)
 		{
-			for (int i = 0; i < EdgeMap::getNumberOfEdgeIds(x, y); i++)
+			for (int edgeId : getEdgeIds(x, y))
 			{
-				if (dataEdgeIds[x + y * cols][i] > maxId)
+				if (edgeId > maxId)
 				{
-					maxId = dataEdgeIds[x + y * cols][i];
+					maxId = edgeId;
 				}
 			}
 		}
@@ -69,19 +301,19 @@ void EdgeMap::pushBackEdgeId(int x, int y, int edgeId)
 {
 	if constexpr (WRITE_EDGE_IDS_AT_ALL_CLUSTER_POINTS)
 	{
-		if (dataClusters[x + y * cols].size() == 0)
+		if (!isCluster(x, y))
 		{
 			// Push back edgeId at given position
-			dataEdgeIds[x + y * cols].push_back(edgeId);
+			appendEdgeId(x, y, edgeId);
 		}
 		else
 		{
 			// Only push back edgeId if not already in cluster
-			if (std::find(dataEdgeIds[x + y * cols].begin(), dataEdgeIds[x + y * cols].end(), edgeId) == dataEdgeIds[x + y * cols].end())
+			if (!containsEdgeId(x, y, edgeId))
 			{
-				for (const auto& p : dataClusters[x + y * cols])
+				for (const auto& p : getClusterPoints(x, y))
 				{
-					dataEdgeIds[p.x + p.y * cols].push_back(edgeId);
+					appendEdgeId(p.x, p.y, edgeId);
 				}
 			}
 		}
@@ -89,105 +321,441 @@ void EdgeMap::pushBackEdgeId(int x, int y, int edgeId)
 	else
 	{
 		// Only push back edgeId if not already in cluster
-		if (std::find(dataEdgeIds[x + y * cols].begin(), dataEdgeIds[x + y * cols].end(), edgeId) == dataEdgeIds[x + y * cols].end())
+		if (!containsEdgeId(x, y, edgeId))
 		{
-			dataEdgeIds[x + y * cols].push_back(edgeId);
+			appendEdgeId(x, y, edgeId);
 		}
 	}
 }
 
-void EdgeMap::pushBackClusterPoints(int x, int y, std::vector<cv::Point> clusterPoints)
+void EdgeMap::addCluster(std::vector<cv::Point> clusterPoints)
 {
-	// Save clusterPoints at given position
-	dataClusters[x + y * cols] = clusterPoints;
+	int32_t id = clusters.size();
+
+	// Reuse the record of a cleared cluster (no pixel refers to it anymore)
+	if (!freeClusters.empty())
+	{
+		id = freeClusters.back();
+		freeClusters.pop_back();
+	}
+
+	Cluster cluster;
+	cluster.parent = id;
+	cluster.boundingBox = clusterPoints.empty() ? cv::Rect() : cv::Rect(clusterPoints.front(), cv::Size(1, 1));
+	cluster.edgeIdsValid = false;
+
+	for (const auto& p : clusterPoints)
+	{
+		setClusterId(p.x + p.y * cols, id);
+		cluster.boundingBox |= cv::Rect(p, cv::Size(1, 1));
+	}
+
+	cluster.points = std::move(clusterPoints);
+
+	if (id == static_cast<int32_t>(clusters.size()))
+	{
+		clusters.push_back(std::move(cluster));
+	}
+	else
+	{
+		clusters[id] = std::move(cluster);
+	}
 }
 
 void EdgeMap::addPointToCluster(int x, int y, cv::Point point)
 {
-	// Here, cluster points are only stored at the given position
-	dataClusters[x + y * cols].push_back(point);
+	int32_t id = findCluster(x, y);
+
+	if (id == NO_CLUSTER || findCluster(point.x, point.y) == id)
+	{
+		return;
+	}
+
+	// A point can only be part of one cluster
+	clearClusterPoint(point.x, point.y);
+
+	Cluster &cluster = clusters[id];
+	cluster.points.push_back(point);
+	cluster.boundingBox |= cv::Rect(point, cv::Size(1, 1));
+	cluster.edgeIdsValid = false;
+
+	setClusterId(point.x + point.y * cols, id);
+}
+
+void EdgeMap::mergeClusters(int x1, int y1, int x2, int y2)
+{
+	int32_t first = findCluster(x1, y1);
+	int32_t second = findCluster(x2, y2);
 
-	// Then, store all cluster points at every position, including the new point
-	for (const auto& p : dataClusters[x + y * cols])
+	if (first == NO_CLUSTER || second == NO_CLUSTER || first == second)
 	{
-		dataClusters[p.x + p.y * cols] = dataClusters[x + y * cols];
+		return;
 	}
+
+	// Union by size, the points of the first cluster stay in front
+	int32_t root = first;
+	int32_t child = second;
+
+	if (clusters[first].points.size() < clusters[second].points.size())
+	{
+		std::swap(root, child);
+		clusters[root].points.swap(clusters[child].points);
+	}
+
+	Cluster &rootCluster = clusters[root];
+	Cluster &childCluster = clusters[child];
+
+	rootCluster.points.insert(rootCluster.points.end(), childCluster.points.begin(), childCluster.points.end());
+	rootCluster.boundingBox |= childCluster.boundingBox;
+	rootCluster.edgeIdsValid = false;
+
+	childCluster.parent = root;
+	childCluster.points = std::vector<cv::Point>();
+	childCluster.edgeIds = std::vector<int>();
 }
 
 void EdgeMap::eraseEdgeId(int x, int y, int edgeId)
 {
-	// Get position of edgeId in dataEdgeIds[x + y * cols]
-	auto iterator = std::find(dataEdgeIds[x + y * cols].begin(), dataEdgeIds[x + y * cols].end(), edgeId);
+	if (!edgeIdTargets.empty())
+	{
+		resolveEdgeIds(x + y * cols);
+	}
+
+	if (backend == Backend::Vector)
+	{
+		invalidateClusterEdgeIds(x, y);
 
-	// Erase if edgeId found
-	if (iterator != dataEdgeIds[x + y * cols].end())
+		// Get position of edgeId in dataEdgeIds[x + y * cols]
+		auto iterator = std::find(dataEdgeIds[x + y * cols].begin(), dataEdgeIds[x + y * cols].end(), edgeId);
+
+		// Erase if edgeId found
+		if (iterator != dataEdgeIds[x + y * cols].end())
+		{
+			dataEdgeIds[x + y * cols].erase(iterator);
+		}
+
+		return;
+	}
+
+	if (findLabel(x + y * cols) == nullptr)
+	{
+		return; // No entry in sparse backend
+	}
+
+	int32_t &label = getLabelReference(x + y * cols);
+
+	invalidateClusterEdgeIds(x, y);
+
+	if (label >= 0)
 	{
-		dataEdgeIds[x + y * cols].erase(iterator);
+		if (label == edgeId)
+		{
+			label = NO_EDGE;
+		}
+	}
+	else if (label != NO_EDGE)
+	{
+		int32_t entry = -(label + 2);
+		std::vector<int> &edgeIds = overflowEdgeIds[entry];
+
+		auto iterator = std::find(edgeIds.begin(), edgeIds.end(), edgeId);
+
+		if (iterator != edgeIds.end())
+		{
+			edgeIds.erase(iterator);
+		}
+
+		// Back to a single edgeId, release the overflow entry
+		if (edgeIds.size() == 1)
+		{
+			label = edgeIds.front();
+			edgeIds.clear();
+			freeOverflowEntries.push_back(entry);
+		}
 	}
 }
 
 void EdgeMap::clearClusterPoint(int x, int y)
 {
-	dataClusters[x + y * cols].clear();
+	int32_t id = findCluster(x, y);
+
+	if (id == NO_CLUSTER)
+	{
+		return;
+	}
+
+	Cluster &cluster = clusters[id];
+	cluster.points.erase(std::find(cluster.points.begin(), cluster.points.end(), cv::Point(x, y)));
+	cluster.edgeIdsValid = false;
+
+	// Shrink bounding box
+	cluster.boundingBox = cluster.points.empty() ? cv::Rect() : cv::Rect(cluster.points.front(), cv::Size(1, 1));
+
+	for (const auto& p : cluster.points)
+	{
+		cluster.boundingBox |= cv::Rect(p, cv::Size(1, 1));
+	}
+
+	setClusterId(x + y * cols, NO_CLUSTER);
 }
 
 void EdgeMap::clearCluster(int x, int y)
 {
-	for (const auto& p : dataClusters[x + y * cols])
+	int32_t id = findCluster(x, y);
+
+	if (id == NO_CLUSTER)
+	{
+		return;
+	}
+
+	Cluster &cluster = clusters[id];
+
+	for (const auto& p : cluster.points)
 	{
-		dataClusters[p.x + p.y * cols].clear();
+		setClusterId(p.x + p.y * cols, NO_CLUSTER);
 	}
+
+	cluster.points = std::vector<cv::Point>();
+	cluster.boundingBox = cv::Rect();
+	cluster.edgeIds = std::vector<int>();
+
+	// Merged clusters below this root are not referenced by pixels either, but stay unused
+	freeClusters.push_back(id);
 }
 
 std::vector<int> EdgeMap::getClusterEdgeIds(int x, int y) const
 {
-	std::set<int> edgeIdsInCluster; // Set automatically avoids duplicate entries, results are ordered
+	int32_t id = findCluster(x, y);
+
+	if (id == NO_CLUSTER)
+	{
+		return std::vector<int>();
+	}
+
+	const Cluster &cluster = clusters[id];
+
+	if (!cluster.edgeIdsValid)
+	{
+		std::set<int> edgeIdsInCluster; // Set automatically avoids duplicate entries, results are ordered
 
-	for (const auto& point : dataClusters[x + y * cols])
+		for (const auto& point : cluster.points)
+		{
+			for (const auto& edgeId : getEdgeIds(point.x, point.y))
+			{
+				edgeIdsInCluster.insert(edgeId);
+			}
+		}
+
+		cluster.edgeIds.assign(edgeIdsInCluster.begin(), edgeIdsInCluster.end());
+		cluster.edgeIdsValid = true;
+	}
+	else if (!edgeIdTargets.empty())
 	{
-		for (const auto& edgeId : dataEdgeIds[point.x + point.y * cols])
+		// EdgeIds cached before a redirection
+		for (auto& edgeId : cluster.edgeIds)
 		{
-			edgeIdsInCluster.insert(edgeId);
+			edgeId = findEdgeId(edgeId);
 		}
+
+		std::sort(cluster.edgeIds.begin(), cluster.edgeIds.end());
+		cluster.edgeIds.erase(std::unique(cluster.edgeIds.begin(), cluster.edgeIds.end()), cluster.edgeIds.end());
 	}
 
-	// Convert set to vector and return
-    return std::vector<int>(edgeIdsInCluster.begin(), edgeIdsInCluster.end());
+	return cluster.edgeIds;
+}
+
+cv::Rect EdgeMap::getClusterBoundingBox(int x, int y) const
+{
+	int32_t id = findCluster(x, y);
+	return (id == NO_CLUSTER) ? cv::Rect() : clusters[id].boundingBox;
 }
 
 bool EdgeMap::isCluster(int x, int y)
 {
-	if (dataClusters[x + y * cols].size() >= 1)
+	return getClusterId(x + y * cols) != NO_CLUSTER;
+}
+
+void EdgeMap::invalidateClusterEdgeIds(int x, int y)
+{
+	int32_t id = findCluster(x, y);
+
+	if (id != NO_CLUSTER)
 	{
-		return true;
+		clusters[id].edgeIdsValid = false;
 	}
-
-	return false;
 }
 
 void EdgeMap::resetEdgeIdMap()
 {
-	dataEdgeIds.clear();
-	dataEdgeIds.resize(rows * cols);
+	if (backend == Backend::Vector)
+	{
+		dataEdgeIds.clear();
+		dataEdgeIds.resize(rows * cols);
+	}
+	else
+	{
+		std::fill(labels.begin(), labels.end(), NO_EDGE);
+		overflowEdgeIds.clear();
+		freeOverflowEntries.clear();
+
+		if (clusters.empty())
+		{
+			pixelTable.removeAllEntries(); // Entries without label and cluster are not needed
+		}
+		else
+		{
+			for (auto& entry : pixelTable.getSlots())
+			{
+				entry.label = NO_EDGE;
+			}
+		}
+	}
+
+	for (auto& cluster : clusters)
+	{
+		cluster.edgeIdsValid = false;
+	}
+
+	edgeIdTargets.clear();
+	edgeIdRedirectionOrder.clear();
+	edgeIdParents.clear();
+	numberOfRedirections = 0;
+}
+
+void EdgeMap::redirectEdgeId(int edgeId, int targetEdgeId)
+{
+	if (edgeId == targetEdgeId || isRedirected(edgeId))
+	{
+		return;
+	}
+
+	size_t size = std::max(edgeId, targetEdgeId) + 1;
+
+	if (edgeIdTargets.size() < size)
+	{
+		size_t previousSize = edgeIdTargets.size();
+		edgeIdTargets.resize(size);
+		edgeIdParents.resize(size);
+		edgeIdRedirectionOrder.resize(size, 0);
+
+		for (size_t id = previousSize; id < size; id++)
+		{
+			edgeIdTargets[id] = id;
+			edgeIdParents[id] = id;
+		}
+	}
+
+	edgeIdTargets[edgeId] = targetEdgeId;
+	edgeIdParents[edgeId] = targetEdgeId;
+	edgeIdRedirectionOrder[edgeId] = numberOfRedirections++;
 }
 
-void EdgeMap::resetClusterMap()
+int EdgeMap::findEdgeId(int edgeId) const
 {
-	dataClusters.clear();
-	dataClusters.resize(rows * cols);
+	if (edgeId < 0 || edgeId >= static_cast<int>(edgeIdParents.size()))
+	{
+		return edgeId;
+	}
+
+	// Path halving
+	while (edgeIdParents[edgeId] != edgeId)
+	{
+		edgeIdParents[edgeId] = edgeIdParents[edgeIdParents[edgeId]];
+		edgeId = edgeIdParents[edgeId];
+	}
+
+	return edgeId;
 }
 
-bool EdgeMap::isPointInCluster(int x, int y, cv::Point point)
+void EdgeMap::resolveEdgeIds(int index) const
+{
+	if (backend == Backend::Vector)
+	{
+		resolveEdgeIdList(dataEdgeIds[index]);
+		return;
+	}
+
+	SparsePixelTable::Entry *entry = (backend == Backend::Sparse) ? pixelTable.find(index) : nullptr;
+	int32_t *label = (backend == Backend::Sparse) ? (entry ? &entry->label : nullptr) : &labels[index];
+
+	if (label == nullptr || *label == NO_EDGE)
+	{
+		return;
+	}
+	else if (*label >= 0)
+	{
+		// A single edgeId is replaced by the end of its redirections
+		*label = findEdgeId(*label);
+		return;
+	}
+
+	int32_t overflowEntry = -(*label + 2);
+	std::vector<int> &edgeIds = overflowEdgeIds[overflowEntry];
+
+	// Back to a single edgeId, release the overflow entry (as eraseEdgeId)
+	if (resolveEdgeIdList(edgeIds) && edgeIds.size() == 1)
+	{
+		*label = edgeIds.front();
+		edgeIds.clear();
+		freeOverflowEntries.push_back(overflowEntry);
+	}
+}
+
+bool EdgeMap::resolveEdgeIdList(std::vector<int> &edgeIds) const
 {
-	for (const cv::Point& p : dataClusters[x + y * cols])
+	bool changes = false;
+
+	while (true)
 	{
-		if (p == point)
+		// Earliest redirection of the edgeIds in the list
+		auto redirected = edgeIds.end();
+
+		for (auto it = edgeIds.begin(); it != edgeIds.end(); ++it)
+		{
+			if (isRedirected(*it) && (redirected == edgeIds.end() || edgeIdRedirectionOrder[*it] < edgeIdRedirectionOrder[*redirected]))
+			{
+				redirected = it;
+			}
+		}
+
+		if (redirected == edgeIds.end())
+		{
+			return changes;
+		}
+
+		int target = edgeIdTargets[*redirected];
+		edgeIds.erase(redirected);
+
+		if (std::find(edgeIds.begin(), edgeIds.end(), target) == edgeIds.end())
 		{
-			return true;
+			edgeIds.push_back(target);
 		}
+
+		changes = true;
+	}
+}
+
+void EdgeMap::resetClusterMap()
+{
+	std::fill(clusterIds.begin(), clusterIds.end(), NO_CLUSTER);
+	clusters.clear();
+	freeClusters.clear();
+
+	for (auto& entry : pixelTable.getSlots())
+	{
+		entry.clusterId = NO_CLUSTER;
+	}
+}
+
+bool EdgeMap::isPointInCluster(int x, int y, cv::Point point)
+{
+	if (point.x < 0 || point.y < 0 || point.x >= cols || point.y >= rows)
+	{
+		return false;
 	}
 
-	return false;
+	int32_t id = findCluster(x, y);
+	return id != NO_CLUSTER && findCluster(point.x, point.y) == id;
 }
 
 
@@ -210,3 +778,115 @@ bool EdgeMap::isPointInCluster(int x, int y, cv::Point point)
 
 
 
+
+void EdgeMap::SparsePixelTable::clear()
+{
+	slots = std::vector<Entry>();
+	numberOfEntries = 0;
+	shift = 64;
+}
+
+void EdgeMap::SparsePixelTable::removeAllEntries()
+{
+	std::fill(slots.begin(), slots.end(), Entry{EMPTY, EdgeMap::NO_EDGE, EdgeMap::NO_CLUSTER});
+	numberOfEntries = 0;
+}
+
+size_t EdgeMap::SparsePixelTable::getStartSlot(int32_t index) const
+{
+	// Fibonacci hashing, neighboring pixels are spread over the table
+	return (static_cast<uint64_t>(index) * 0x9E3779B97F4A7C15ull) >> shift;
+}
+
+const EdgeMap::SparsePixelTable::Entry *EdgeMap::SparsePixelTable::find(int32_t index) const
+{
+	if (slots.empty())
+	{
+		return nullptr;
+	}
+
+	size_t mask = slots.size() - 1;
+
+	for (size_t slot = getStartSlot(index); ; slot = (slot + 1) & mask)
+	{
+		if (slots[slot].index == index)
+		{
+			return &slots[slot];
+		}
+		else if (slots[slot].index == EMPTY)
+		{
+			return nullptr;
+		}
+	}
+}
+
+EdgeMap::SparsePixelTable::Entry *EdgeMap::SparsePixelTable::find(int32_t index)
+{
+	return const_cast<Entry *>(static_cast<const SparsePixelTable *>(this)->find(index));
+}
+
+EdgeMap::SparsePixelTable::Entry &EdgeMap::SparsePixelTable::findOrInsert(int32_t index)
+{
+	// Load factor of at most 0.5
+	if (2 * (numberOfEntries + 1) > slots.size())
+	{
+		grow();
+	}
+
+	size_t mask = slots.size() - 1;
+	size_t slot = getStartSlot(index);
+
+	while (slots[slot].index != index && slots[slot].index != EMPTY)
+	{
+		slot = (slot + 1) & mask;
+	}
+
+	if (slots[slot].index == EMPTY)
+	{
+		slots[slot] = {index, EdgeMap::NO_EDGE, EdgeMap::NO_CLUSTER};
+		numberOfEntries++;
+	}
+
+	return slots[slot];
+}
+
+void EdgeMap::SparsePixelTable::grow()
+{
+	std::vector<Entry> oldSlots = std::move(slots);
+
+	size_t numberOfSlots = oldSlots.empty() ? 1024 : 2 * oldSlots.size();
+	slots.assign(numberOfSlots, {EMPTY, EdgeMap::NO_EDGE, EdgeMap::NO_CLUSTER});
+	shift = 64 - __builtin_ctzll(numberOfSlots);
+
+	size_t mask = numberOfSlots - 1;
+
+	for (const auto& entry : oldSlots)
+	{
+		if (entry.index != EMPTY)
+		{
+			size_t slot = getStartSlot(entry.index);
+
+			while (slots[slot].index != EMPTY)
+			{
+				slot = (slot + 1) & mask;
+			}
+
+			slots[slot] = entry;
+		}
+	}
+}
+
+std::vector<EdgeMap::SparsePixelTable::Entry> &EdgeMap::SparsePixelTable::getSlots()
+{
+	return slots;
+}
+
+const std::vector<EdgeMap::SparsePixelTable::Entry> &EdgeMap::SparsePixelTable::getSlots() const
+{
+	return slots;
+}
+
+size_t EdgeMap::SparsePixelTable::size() const
+{
+	return numberOfEntries;
+}
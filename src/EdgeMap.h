@@ -1,39 +1,95 @@
 #ifndef EDGEIDMAP_H
 #define EDGEIDMAP_H
 
+#include <cstdint>
 #include <vector>
 
 #include <opencv2/core.hpp>
 
+/** Read-only view of the edgeIds at one position, valid until the edgeIdMap is modified.
+ */
+class EdgeIdSpan
+{
+public:
+	EdgeIdSpan() : data(nullptr), count(0) {}
+	EdgeIdSpan(const int *data, size_t count) : data(data), count(count) {}
+
+	const int *begin() const { return data; }
+	const int *end() const { return data + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	int operator[](size_t i) const { return data[i]; }
+	int front() const { return data[0]; }
+	int back() const { return data[count - 1]; }
+
+private:
+	const int *data;
+	size_t count;
+};
+
 // Note: int x, int y could be replaced by cv::Point
 class EdgeMap
 {
 public:
+	/** Data structures used for the edgeIdMap.
+	 */
+	enum class Backend
+	{
+		Vector,		//!< One std::vector of edgeIds per pixel.
+		Dense,		//!< One label per pixel (edgeId or reference to an overflow table for pixels with several edgeIds).
+		Sparse,		//!< Labels and cluster ids of edge pixels only, stored in a hash table (for images with few edge pixels).
+		Automatic	//!< Dense or Sparse, chosen by EdgeProcessor::traceEdges based on the edge density of the image (Dense in init).
+	};
+
 	/** Constructor.
 	 */
 	EdgeMap();
 
 	/** Initialize the data structures maintained by this class.
 	 */
-	void init(int rows, int cols);
+	void init(int rows, int cols, Backend backend=Backend::Dense);
+
+	/** Number of pixels stored in the data structures of the sparse backend (0 for other backends).
+	 */
+	size_t getNumberOfSparseEntries() const;
+
+	/** Data structure used for the edgeIdMap.
+	 */
+	Backend getBackend() const;
 
 	/**	Push back edgeId at given position.
 	 */
 	void pushBackEdgeId(int x, int y, int edgeId);
 
-	/**	Push back cluster point at given position.
+	/**	Create a new cluster consisting of the given points (points must not be part of another cluster).
 	 */
-	void pushBackClusterPoints(int x, int y, std::vector<cv::Point> cluster);
+	void addCluster(std::vector<cv::Point> clusterPoints);
 
-	/** Adds one point to a cluster.
+	/** Adds one point to the cluster located at position (x, y). If the point is part of another cluster, it is moved.
 	 */
 	void addPointToCluster(int x, int y, cv::Point point);
 
+	/** Merge the cluster located at position (x2, y2) into the cluster located at position (x1, y1).
+	 *  The points of the second cluster are appended to the points of the first cluster.
+	 */
+	void mergeClusters(int x1, int y1, int x2, int y2);
+
 	/** Erase edgeId at given position.
 	 */
 	void eraseEdgeId(int x, int y, int edgeId);
 
-	/** Clear EdgeId at given position.
+	/** Replace edgeId by targetEdgeId at every position (the edge was merged into targetEdgeId) in near-constant time.
+	 *  The pixels are not rewritten, their edgeIds are resolved when they are accessed, with the same result as
+	 *  erasing edgeId and pushing back targetEdgeId at every position of edgeId. Const access to pixels with redirected
+	 *  edgeIds modifies them, so it must not run concurrently. resetEdgeIdMap removes all redirections.
+	 */
+	void redirectEdgeId(int edgeId, int targetEdgeId);
+
+	/** EdgeId which replaces edgeId after all redirections (edgeId itself if it was not redirected).
+	 */
+	int findEdgeId(int edgeId) const;
+
+	/** Remove the point at given position from its cluster.
 	 */
 	void clearClusterPoint(int x, int y);
 
@@ -57,22 +113,41 @@ public:
 	 */
 	int getRows() const;
 
-	/** Get read-only reference to edge identifiers (edgeIds).
+	/** Get read-only view of the edge identifiers (edgeIds) at given position.
 	 */
-	const std::vector<int> &getEdgeIds(int x, int y) const;
+	EdgeIdSpan getEdgeIds(int x, int y) const;
 
 	/** Get read-only reference to cluster points.
 	 */
 	const std::vector<cv::Point> &getClusterPoints(int x, int y) const;
 
+	/** Points of all clusters, one entry per cluster in the order of their records (the order of creation, except that
+	 *  new clusters reuse the records of cleared clusters; merged clusters are part of the cluster they were merged
+	 *  into). Valid until the clusters are modified.
+	 */
+	std::vector<const std::vector<cv::Point> *> getAllClusterPoints() const;
+
+	/** First point (smallest y, then smallest x) of every cluster, sorted in this raster order. Each cluster is listed
+	 *  once, in the order in which a scan over all pixels would reach it.
+	 */
+	std::vector<cv::Point> getClusterPositions() const;
+
 	/** Number of different edges in edgeIdMap.
 	 */
 	int getMaxEdgeId() const;
 
-	/** Get all edgeIds belonging to the cluster.
+	/** Indices (x + y * cols) of all pixels with at least one edgeId, in ascending order.
+	 */
+	std::vector<int> getEdgePixelIndices() const;
+
+	/** Get all edgeIds belonging to the cluster (ordered).
 	 */
 	std::vector<int> getClusterEdgeIds(int x, int y) const;
 
+	/** Bounding box of the cluster located at position (x, y), empty if there is no cluster.
+	 */
+	cv::Rect getClusterBoundingBox(int x, int y) const;
+
 	/** Checks if the point belongs to a cluster.
 	 */
 	bool isCluster(int x, int y);
@@ -81,7 +156,7 @@ public:
 	 */
 	void resetEdgeIdMap();
 
-	/** Clears dataClusters, which represents the eambiguityMap.
+	/** Clears clusterIds and clusters, which represent the ambiguityMap.
 	 */
 	void resetClusterMap();
 
@@ -91,23 +166,226 @@ public:
 	bool isPointInCluster(int x, int y, cv::Point point);
 
 private:
-	std::vector<std::vector<int>> dataEdgeIds;			//!< 1D data structure representing the 2D edgeIdMap.
-	std::vector<std::vector<cv::Point>> dataClusters;	//!< 1D data structure representing the 2D ambiguityMap.
+	static constexpr int32_t NO_EDGE = -1; //!< Label of pixels without edgeId (dense backend).
+
+	Backend backend; //!< Data structure used for the edgeIdMap.
+
+	static constexpr int32_t NO_CLUSTER = -1; //!< Cluster id of pixels which are not part of a cluster.
+
+	/** Open-addressing hash table (linear probing) from pixel index to label and cluster id (sparse backend).
+	 *  Entries are never removed, pixels which lose their edgeIds and cluster keep an entry with NO_EDGE and NO_CLUSTER.
+	 */
+	class SparsePixelTable
+	{
+	public:
+		struct Entry
+		{
+			int32_t index;		//!< Pixel index x + y * cols, EMPTY for unused slots.
+			int32_t label;		//!< Label as in the dense backend.
+			int32_t clusterId;	//!< Cluster id as in clusterIds.
+		};
+
+		static constexpr int32_t EMPTY = -1; //!< Index of unused slots.
+
+		/** Remove all entries and free the slots.
+		 */
+		void clear();
+
+		/** Remove all entries, the slots are kept for reuse.
+		 */
+		void removeAllEntries();
+
+		/** Entry of the pixel, nullptr if the pixel has no entry.
+		 */
+		const Entry *find(int32_t index) const;
+		Entry *find(int32_t index);
+
+		/** Entry of the pixel, a new entry (NO_EDGE, NO_CLUSTER) is inserted if the pixel has no entry.
+		 *  References to entries are invalidated by insertions.
+		 */
+		Entry &findOrInsert(int32_t index);
+
+		/** All slots including unused ones (index == EMPTY).
+		 */
+		std::vector<Entry> &getSlots();
+		const std::vector<Entry> &getSlots() const;
+
+		/** Number of entries.
+		 */
+		size_t size() const;
+
+	private:
+		std::vector<Entry> slots;	//!< Number of slots is a power of two.
+		size_t numberOfEntries = 0;
+		int shift = 64;				//!< 64 - log2(number of slots), used for Fibonacci hashing.
+
+		/** Slot where the search for a pixel index starts.
+		 */
+		size_t getStartSlot(int32_t index) const;
+
+		/** Doubles the number of slots and reinserts all entries.
+		 */
+		void grow();
+	};
+
+	/** Record of one cluster. Merged clusters form a tree (union-find), only the root holds points, bounding box and edgeIds.
+	 */
+	struct Cluster
+	{
+		mutable int32_t parent;				//!< Index of the parent cluster, the cluster itself for roots.
+		std::vector<cv::Point> points;		//!< Cluster points in the order they were added.
+		cv::Rect boundingBox;				//!< Bounding box of the cluster points.
+		mutable std::vector<int> edgeIds;	//!< Cached ordered edgeIds of the cluster points.
+		mutable bool edgeIdsValid;			//!< False if edgeIds has to be recomputed.
+	};
+
+	mutable std::vector<std::vector<int>> dataEdgeIds;	//!< 1D data structure representing the 2D edgeIdMap (vector backend).
+
+	std::vector<int32_t> clusterIds;	//!< 1D data structure representing the 2D ambiguityMap (cluster record of each pixel or NO_CLUSTER).
+	std::vector<Cluster> clusters;		//!< Cluster records referenced by clusterIds.
+	std::vector<int32_t> freeClusters;	//!< Records of cleared clusters, reused by addCluster.
+
+	/*  1D data structure representing the 2D edgeIdMap (dense backend). Each label is either NO_EDGE, the only edgeId at
+	 *  that position (>= 0) or refers to the entry -(label + 2) in overflowEdgeIds (pixels with several edgeIds).
+	 */
+	mutable std::vector<int32_t> labels;
+	mutable std::vector<std::vector<int>> overflowEdgeIds;	//!< EdgeIds of pixels with several edgeIds (dense backend).
+	mutable std::vector<int32_t> freeOverflowEntries;		//!< Unused entries in overflowEdgeIds (dense and sparse backend).
+
+	mutable SparsePixelTable pixelTable;	//!< Labels and cluster ids of edge pixels (sparse backend, replaces labels and clusterIds).
+
+	/*  Redirected edgeIds (see redirectEdgeId), all empty if there are none. The pixel storage above is mutable, since
+	 *  pixels with redirected edgeIds are rewritten on first access.
+	 */
+	std::vector<int32_t> edgeIdTargets;				//!< EdgeId each edgeId was redirected to (itself if not redirected).
+	std::vector<uint32_t> edgeIdRedirectionOrder;	//!< Number of the redirection of each redirected edgeId.
+	mutable std::vector<int32_t> edgeIdParents;		//!< Union-find parents of the edgeIds (path halving).
+	uint32_t numberOfRedirections = 0;
 
 	int rows; //!< Number of input image rows.
 	int cols; //!< Number of input image columns.
+
+	/** Checks if edgeId is stored at given position.
+	 */
+	bool containsEdgeId(int x, int y, int edgeId) const;
+
+	/** Append edgeId at given position (without checking for duplicates).
+	 */
+	void appendEdgeId(int x, int y, int edgeId);
+
+	/** Pointer to the label of the pixel with given index (dense and sparse backend), nullptr if there is none.
+	 */
+	const int32_t *findLabel(int index) const;
+
+	/** Reference to the label of the pixel with given index (dense and sparse backend), creates an entry if necessary.
+	 */
+	int32_t &getLabelReference(int index);
+
+	/** Cluster id of the pixel with given index.
+	 */
+	int32_t getClusterId(int index) const;
+
+	/** Set cluster id of the pixel with given index.
+	 */
+	void setClusterId(int index, int32_t id);
+
+	/** Root cluster of the pixel at given position, NO_CLUSTER if the pixel is not part of a cluster.
+	 */
+	int32_t findCluster(int x, int y) const;
+
+	/** Invalidate the cached edgeIds of the cluster at given position (called whenever edgeIds at that position change).
+	 */
+	void invalidateClusterEdgeIds(int x, int y);
+
+	/** Checks if edgeId has been redirected.
+	 */
+	bool isRedirected(int edgeId) const;
+
+	/** Apply all redirections to the edgeIds of the pixel with given index (no-op if there are none).
+	 */
+	void resolveEdgeIds(int index) const;
+
+	/** Apply all redirections to a list of edgeIds in the order in which they were made: the redirected edgeId is
+	 *  erased and its target appended if not present (as an eager rewrite of the pixel would have done).
+	 *  @returns		True if the list changed.
+	 */
+	bool resolveEdgeIdList(std::vector<int> &edgeIds) const;
 };
 
+inline const int32_t *EdgeMap::findLabel(int index) const
+{
+	if (backend == Backend::Sparse)
+	{
+		const SparsePixelTable::Entry *entry = pixelTable.find(index);
+		return entry ? &entry->label : nullptr;
+	}
+
+	return &labels[index];
+}
+
+inline int32_t EdgeMap::getClusterId(int index) const
+{
+	if (backend == Backend::Sparse)
+	{
+		const SparsePixelTable::Entry *entry = pixelTable.find(index);
+		return entry ? entry->clusterId : NO_CLUSTER;
+	}
+
+	return clusterIds[index];
+}
+
+inline int32_t EdgeMap::findCluster(int x, int y) const
+{
+	if (clusters.empty())
+	{
+		return NO_CLUSTER;
+	}
+
+	int32_t id = getClusterId(x + y * cols);
+
+	if (id == NO_CLUSTER)
+	{
+		return NO_CLUSTER;
+	}
+
+	// Path halving
+	while (clusters[id].parent != id)
+	{
+		clusters[id].parent = clusters[clusters[id].parent].parent;
+		id = clusters[id].parent;
+	}
+
+	return id;
+}
+
+inline bool EdgeMap::isRedirected(int edgeId) const
+{
+	return edgeId < static_cast<int>(edgeIdTargets.size()) && edgeIdTargets[edgeId] != edgeId;
+}
+
 inline int EdgeMap::getNumberOfEdgeIds(int x, int y) const
 {
+	if (!edgeIdTargets.empty())
+	{
+		resolveEdgeIds(x + y * cols);
+	}
+
 	// Number of edgeIds at given position
-	return dataEdgeIds[x + y * cols].size();
+	if (backend == Backend::Vector)
+	{
+		return dataEdgeIds[x + y * cols].size();
+	}
+
+	const int32_t *labelPointer = findLabel(x + y * cols);
+	int32_t label = labelPointer ? *labelPointer : NO_EDGE;
+	return (label >= 0) ? 1 : ((label == NO_EDGE) ? 0 : overflowEdgeIds[-(label + 2)].size());
 }
 
 inline int EdgeMap::getNumberOfClusterPoints(int x, int y) const
 {
-	// Number of edgeIds at given position
-	return dataClusters[x + y * cols].size();
+	// Number of cluster points at given position
+	int32_t id = findCluster(x, y);
+	return (id == NO_CLUSTER) ? 0 : clusters[id].points.size();
 }
 
 #endif // EDGEIDMAP_H
@@ -3,217 +3,712 @@
 #include <algorithm>
 #include <iostream>
 #include <cmath>
+#include <queue>
+#include <tuple>
 
-constexpr uint8_t UPPER_LEFT	= 0b11000001; // 193
-constexpr uint8_t UPPER_RIGHT	= 0b01110000; // 112
-constexpr uint8_t LOWER_RIGHT	= 0b00011100; // 28
-constexpr uint8_t LOWER_LEFT	= 0b00000111; // 7
+#include "ComponentLabeling.h"
+#include "Neighborhood.h"
+#include "Parallel.h"
+#include "TracingStatistics.h"
+
+namespace
+{
+	constexpr double SPARSE_DENSITY_THRESHOLD = 0.03;	// Images with a lower edge density use the sparse edgeIdMap backend
+	constexpr int DENSITY_SAMPLE_ROWS = 256;			// Number of evenly spaced rows used to estimate the edge density
+	constexpr int SEEDS_PER_TRACE_TASK = 64;			// Number of edge components traced by one thread at a time
+	constexpr size_t CLUSTERS_PER_CONNECT_BATCH = 1024;	// Maximum number of clusters evaluated concurrently by connectEdgesInClusters
+	constexpr uchar TRACED_PIXEL = 1;					// ambiguityMask value of traced non-cluster edge pixels
+	constexpr bool LOG_MERGES = false;					// Print each merge (dominates the runtime on images with many junctions)
+	constexpr double MAX_CHANGED_TILE_FRACTION = 0.5;	// traceNextFrame traces frames with more changed tiles from scratch
+
+	/** Number of edge pixels (> 0) in the image.
+	 */
+	uint64_t countEdgePixels(const cv::Mat &img)
+	{
+		uint64_t count = 0;
+
+		for (int y = 0; y < img.rows; y++)
+		{
+			const uchar *row = img.ptr<uchar>(y);
+
+			for (int x = 0; x < img.cols; x++)
+			{
+				count += (row[x] > 0);
+			}
+		}
+
+		return count;
+	}
+
+	/** Tiles in which the edge pixels (> 0) of the two images differ.
+	 */
+	std::vector<cv::Rect> findChangedTiles(const cv::Mat &previousImg, const cv::Mat &img, int tileSize, int numberOfThreads)
+	{
+		int tileCols = (img.cols + tileSize - 1) / tileSize;
+		int tileRows = (img.rows + tileSize - 1) / tileSize;
+		std::vector<char> changed(tileCols * tileRows, false);
+
+		parallelFor(tileCols * tileRows, resolveNumberOfThreads(numberOfThreads), [&](int tile, int)
+		{
+			cv::Rect rect(cv::Point((tile % tileCols) * tileSize, (tile / tileCols) * tileSize), cv::Size(tileSize, tileSize));
+			rect &= cv::Rect(0, 0, img.cols, img.rows);
+
+			for (int y = rect.y; y < rect.y + rect.height && !changed[tile]; y++)
+			{
+				const uchar *previousRow = previousImg.ptr<uchar>(y) + rect.x;
+				const uchar *row = img.ptr<uchar>(y) + rect.x;
+
+				// Identical bytes are the common case, only rows which differ are compared pixel by pixel
+				if (std::equal(row, row + rect.width, previousRow))
+				{
+					continue;
+				}
+
+				for (int x = 0; x < rect.width; x++)
+				{
+					if ((row[x] > 0) != (previousRow[x] > 0))
+					{
+						changed[tile] = true;
+						break;
+					}
+				}
+			}
+		});
+
+		std::vector<cv::Rect> changedTiles;
+
+		for (int tile = 0; tile < tileCols * tileRows; tile++)
+		{
+			if (changed[tile])
+			{
+				cv::Rect rect(cv::Point((tile % tileCols) * tileSize, (tile / tileCols) * tileSize), cv::Size(tileSize, tileSize));
+				changedTiles.push_back(rect & cv::Rect(0, 0, img.cols, img.rows));
+			}
+		}
+
+		return changedTiles;
+	}
+
+	/** Rectangle enlarged by the given number of pixels on each side and clipped to the image.
+	 */
+	cv::Rect enlargeRect(const cv::Rect &rect, int pixels, int cols, int rows)
+	{
+		return cv::Rect(rect.x - pixels, rect.y - pixels, rect.width + 2 * pixels, rect.height + 2 * pixels) & cv::Rect(0, 0, cols, rows);
+	}
+}
 
 // Constructor
 EdgeProcessor::EdgeProcessor()
 {
 	//std::cout << "Object created: EdgeProcessor\n";
 	edgeIdCounter = 0;
+	edgeMapBackend = EdgeMap::Backend::Automatic;
+	edgeStorage = Edges::Storage::Points;
+	numberOfThreads = 1;
+	tileSize = 256;
+	statistics = nullptr;
+	useEdgeMoments = false;
+	useGlobalGapBridging = false;
+}
+
+void EdgeProcessor::setEdgeMapBackend(EdgeMap::Backend backend)
+{
+	edgeMapBackend = backend;
+}
+
+void EdgeProcessor::setEdgeStorage(Edges::Storage storage)
+{
+	edgeStorage = storage;
+}
+
+void EdgeProcessor::setNumberOfThreads(int numberOfThreads)
+{
+	EdgeProcessor::numberOfThreads = numberOfThreads;
+}
+
+void EdgeProcessor::setTileSize(int tileSize)
+{
+	EdgeProcessor::tileSize = std::max(1, tileSize);
+}
+
+void EdgeProcessor::setStatistics(TracingStatistics *statistics)
+{
+	EdgeProcessor::statistics = statistics;
+}
+
+void EdgeProcessor::setEdgeMoments(bool useEdgeMoments)
+{
+	EdgeProcessor::useEdgeMoments = useEdgeMoments;
+	clearEdgeCaches();
+}
+
+void EdgeProcessor::setGlobalGapBridging(bool useGlobalGapBridging)
+{
+	EdgeProcessor::useGlobalGapBridging = useGlobalGapBridging;
 }
 
 void EdgeProcessor::traceEdges(cv::Mat &img)
 {
+	if (statistics)
+	{
+		statistics->clear();
+		statistics->rows = img.rows;
+		statistics->cols = img.cols;
+		statistics->edgePixels = countEdgePixels(img);
+	}
+
 	// Reset / Initialization
-	edgeIdCounter = 0;
-	edges.clear();
-	edgeMap.init(img.rows, img.cols);
+	{
+		PhaseTimer timer(statistics, "initialization", edges);
+		resetTracing(img);
+	}
 
 	// Preprocessing: Identify cluster points
 	preprocessClusters(img);
 
-	// Check each edge pixel
-	for (int y = 0; y < img.rows; y++)
 	{
-		for (int x = 0; x < img.cols; x++)
+		PhaseTimer timer(statistics, "traceEdges", edges);
+
+		if (resolveNumberOfThreads(numberOfThreads) > 1)
 		{
-			// Trace only non-cluster pixels without an edgeId (= skip tracing for pixels with edgeId or in a cluster)
-			if (img.at<uchar>(y, x) > 0 && edgeMap.getNumberOfEdgeIds(x, y) == 0 && edgeMap.getClusterPoints(x, y).size() == 0)
-			{
-				// Main tracing function
-				std::vector<cv::Point> edge;
-				traceEdge(img, cv::Point(x, y), edge);
-			}
+			traceEdgesParallel(img);
+		}
+		else
+		{
+			traceEdgesSerial(img);
 		}
 	}
+
+	if (statistics)
+	{
+		statistics->tracedEdges = statistics->edges;
+	}
 }
 
-void EdgeProcessor::preprocessClusters(cv::Mat &img)
+void EdgeProcessor::resetTracing(const cv::Mat &img)
 {
-	for (int y = 0; y < img.rows; y++)
+	previousFrame.release();
+	edgeIdCounter = 0;
+	edges.clear();
+	edges.setStorage(edgeStorage);
+	clearEdgeCaches();
+	edgeMap.init(img.rows, img.cols, (edgeMapBackend == EdgeMap::Backend::Automatic) ? selectEdgeMapBackend(img) : edgeMapBackend);
+}
+
+void EdgeProcessor::traceNextFrame(cv::Mat &img)
+{
+	if (previousFrame.empty() || previousFrame.size() != img.size())
 	{
-		for (int x = 0; x < img.cols; x++)
+		traceEdges(img);
+		previousFrame = img.clone();
+		return;
+	}
+
+	int tileCols = (img.cols + tileSize - 1) / tileSize;
+	int tileRows = (img.rows + tileSize - 1) / tileSize;
+	std::vector<cv::Rect> changedTiles = findChangedTiles(previousFrame, img, tileSize, numberOfThreads);
+
+	if (changedTiles.size() > MAX_CHANGED_TILE_FRACTION * tileCols * tileRows)
+	{
+		traceEdges(img);
+		img.copyTo(previousFrame);
+	}
+	else
+	{
+		if (statistics)
 		{
-			if (img.at<uchar>(y, x) > 0 && edgeMap.getClusterPoints(x, y).size() == 0) // Only check edge and unclustered pixels
-			{
-				cv::Point point = cv::Point(x, y);
-				uint8_t binaryCode = getBinaryCode(img, point);
-				std::vector<cv::Point> neighbors = getDirectNeighbors(img, point);
+			statistics->clear();
+			statistics->rows = img.rows;
+			statistics->cols = img.cols;
+			statistics->edgePixels = countEdgePixels(img);
+		}
 
-				// True if point is a cluster point
-				if (containsFourCluster(binaryCode) || neighbors.size() > 2)
-				{
-					std::vector<cv::Point> clusterPoints;
-					clusterPoints.push_back(point); // Current point is cluster point
-					int c = 0;
+		{
+			PhaseTimer timer(statistics, "retraceChangedTiles", edges);
+			retraceChangedTiles(img, changedTiles);
+		}
 
-					// Expand clusterPoints by recursively checking neighboring points for cluster status
-					while (c < (int)clusterPoints.size())
-					{
-						// Also called in first run, which is not necessary, but avoids additional check for first run
-						std::vector<cv::Point> neighbors = getDirectNeighbors(img, clusterPoints[c]);
+		if (statistics)
+		{
+			statistics->tracedEdges = statistics->edges;
+		}
 
-						for (const auto& n : neighbors)
-						{
-							// True if neighbor n is not (already) in clusterPoints
-							if (std::find(clusterPoints.begin(), clusterPoints.end(), n) == clusterPoints.end())
-							{
-								uint8_t binaryCode = getBinaryCode(img, n);
-								std::vector<cv::Point> neighbors = getDirectNeighbors(img, n);
+		// Only the changed tiles differ from the previous frame
+		for (const cv::Rect &tile : changedTiles)
+		{
+			img(tile).copyTo(previousFrame(tile));
+		}
+	}
 
-								if (containsFourCluster(binaryCode) || neighbors.size() > 2)
-								{
-									clusterPoints.push_back(n);
-								}
-							}
-						}
+	if (statistics)
+	{
+		statistics->changedTiles = changedTiles.size();
+	}
+}
 
-						c++;
+void EdgeProcessor::retraceChangedTiles(const cv::Mat &img, const std::vector<cv::Rect> &changedTiles)
+{
+	// Pixels whose clusters and edges are computed again (indices x + y * cols, with duplicates until sorted)
+	std::vector<int> pixels;
+	std::vector<int> removedEdgeIds;
+	std::vector<char> isRemoved(edges.size(), false);
+
+	// Edges and clusters within two pixels of the changed tiles: the binary codes change within one pixel, which
+	// changes the direct neighbors of the pixels next to them
+	for (const cv::Rect &tile : changedTiles)
+	{
+		cv::Rect area = enlargeRect(tile, 2, img.cols, img.rows);
+
+		for (int y = area.y; y < area.y + area.height; y++)
+		{
+			for (int x = area.x; x < area.x + area.width; x++)
+			{
+				for (int edgeId : edgeMap.getEdgeIds(x, y))
+				{
+					if (!isRemoved[edgeId])
+					{
+						isRemoved[edgeId] = true;
+						removedEdgeIds.push_back(edgeId);
 					}
+				}
 
-					// Save all points (coordinates) of a cluster at each point of the cluster in ambiguityMap
-					for (const auto& i : clusterPoints)
+				if (edgeMap.getNumberOfClusterPoints(x, y) > 0)
+				{
+					for (const cv::Point &point : edgeMap.getClusterPoints(x, y))
 					{
-						edgeMap.pushBackClusterPoints(i.x, i.y, clusterPoints);
+						pixels.push_back(point.x + point.y * img.cols);
 					}
+
+					edgeMap.clearCluster(x, y);
 				}
 			}
 		}
 	}
-}
 
-// This function is called recursively
-void EdgeProcessor::traceEdge(cv::Mat &img, cv::Point startPoint, std::vector<cv::Point> &edge)
-{
-	// Add startPoint to new edge
-	edge.push_back(startPoint);
-	edgeMap.pushBackEdgeId(startPoint.x, startPoint.y, edgeIdCounter);
+	for (int edgeId : removedEdgeIds)
+	{
+		for (const cv::Point &point : edges.getEdge(edgeId))
+		{
+			edgeMap.eraseEdgeId(point.x, point.y, edgeId);
+			pixels.push_back(point.x + point.y * img.cols);
 
-	// Get direct neighbors of startPoint clockwise from top left
-	std::vector<cv::Point> neighbors = getDirectNeighbors(img, startPoint);
-	std::vector<cv::Point> unvisitedNeighbors;
+			uchar &status = ambiguityMask.at<uchar>(point);
+			status = (status == TRACED_PIXEL) ? 0 : status;
+		}
 
-	if (!edgeMap.isCluster(startPoint.x, startPoint.y))
+		edges.clearEdge(edgeId);
+		invalidateEdgeCaches(edgeId);
+	}
+
+	// Classify the pixels within one pixel of the changed tiles again (with one more pixel for their neighborhoods)
+	cv::Mat tileCodes;
+	cv::Mat tileMask;
+
+	for (const cv::Rect &tile : changedTiles)
 	{
-		for (const auto& point : neighbors)
+		cv::Rect area = enlargeRect(tile, 1, img.cols, img.rows);
+		cv::Rect neighborhood = enlargeRect(area, 1, img.cols, img.rows);
+		cv::Rect areaInNeighborhood(area.tl() - neighborhood.tl(), area.size());
+
+		classifyNeighborhoods(img(neighborhood), tileCodes, tileMask);
+		tileCodes(areaInNeighborhood).copyTo(binaryCodes(area));
+		tileMask(areaInNeighborhood).copyTo(ambiguityMask(area));
+
+		for (int y = area.y; y < area.y + area.height; y++)
 		{
-			if ((edgeMap.getNumberOfEdgeIds(point.x, point.y) == 0 || edgeMap.isCluster(point.x, point.y)))
+			const uchar *row = img.ptr<uchar>(y);
+
+			for (int x = area.x; x < area.x + area.width; x++)
 			{
-				unvisitedNeighbors.push_back(point);
+				if (row[x] > 0)
+				{
+					pixels.push_back(x + y * img.cols);
+				}
 			}
 		}
 	}
 
-	if (unvisitedNeighbors.size() == 2)
-	{
-		// Start tracing in the direction of the first unvisited neighbor
-		std::vector<cv::Point> edgePartOne{startPoint};
-		traceEdge(img, unvisitedNeighbors[0], edgePartOne);
+	std::sort(pixels.begin(), pixels.end());
+	pixels.erase(std::unique(pixels.begin(), pixels.end()), pixels.end());
 
-		// Start new edge to other neighbor if the other neighbor is unvisited, then merge
-		// The other neighbor is visited in case of closed contours or if is approached from a cluster
-		std::vector<cv::Point> edgePartTwo{startPoint};
-		traceEdge(img, unvisitedNeighbors[1], edgePartTwo);
+	// Cluster points of clusters which were not removed can be endpoints of removed edges, they keep their cluster
+	std::vector<int> clusterSeeds;
 
-		mergeEdges(edgeIdCounter-2, edgeIdCounter-1);
+	for (int pixel : pixels)
+	{
+		if (edgeMap.getNumberOfClusterPoints(pixel % img.cols, pixel / img.cols) == 0)
+		{
+			clusterSeeds.push_back(pixel);
+		}
 	}
-	else if (unvisitedNeighbors.size() == 1) // Follow edge
+
+	for (auto& clusterPoints : groupClustersFromSeeds(binaryCodes, ambiguityMask, clusterSeeds))
 	{
-		traceEdge(img, unvisitedNeighbors[0], edge);
+		edgeMap.addCluster(std::move(clusterPoints));
 	}
-	else if (unvisitedNeighbors.size() == 0) // End edge
+
+	// Trace the edges in raster order (as traceEdgesSerial), removed edgeIds are reused in ascending order
+	std::sort(removedEdgeIds.begin(), removedEdgeIds.end());
+	size_t nextRemovedEdgeId = 0;
+	std::vector<std::vector<cv::Point>> componentEdges;
+
+	for (int pixel : pixels)
 	{
-		edges.pushBack(edge);
-		edgeIdCounter++;
+		cv::Point point(pixel % img.cols, pixel / img.cols);
+
+		if (img.at<uchar>(point) == 0 || ambiguityMask.at<uchar>(point) != 0)
+		{
+			continue;
+		}
+
+		traceEdge(point, componentEdges);
+		int firstEdgeId = -1;
+
+		for (auto& edge : componentEdges)
+		{
+			// The second edge of a component traced in two directions is empty (it was merged into the first one)
+			if (edge.empty())
+			{
+				continue;
+			}
+
+			int edgeId = (nextRemovedEdgeId < removedEdgeIds.size()) ? removedEdgeIds[nextRemovedEdgeId++] : edges.size();
+			firstEdgeId = (firstEdgeId == -1) ? edgeId : firstEdgeId;
+
+			for (const auto& edgePoint : edge)
+			{
+				edgeMap.pushBackEdgeId(edgePoint.x, edgePoint.y, edgeId);
+			}
+
+			if (edgeId == static_cast<int>(edges.size()))
+			{
+				edges.pushBack(std::move(edge));
+			}
+			else
+			{
+				edges.overwrite(edgeId, std::move(edge));
+			}
+
+			if (statistics)
+			{
+				statistics->retracedEdges++;
+			}
+		}
+
+		recordComponentMerge(firstEdgeId, componentEdges.size());
+	}
+
+	edgeIdCounter = edges.size();
+
+	// Cluster counters of the whole frame (as after preprocessClusters)
+	if (statistics)
+	{
+		for (const auto *clusterPoints : edgeMap.getAllClusterPoints())
+		{
+			statistics->clusters++;
+			statistics->clusterPoints += clusterPoints->size();
+			statistics->clusterSizeHistogram[clusterPoints->size()]++;
+		}
 	}
 }
 
-std::vector<cv::Point> EdgeProcessor::getDirectNeighbors(cv::Mat &img, cv::Point p)
+void EdgeProcessor::traceEdgesSerial(const cv::Mat &img)
 {
-	// All direct neighbors (as in our sense) are saved in v
-	std::vector<cv::Point> v;
+	std::vector<std::vector<cv::Point>> componentEdges;
 
-	// Only access neighbors inside the image
-	if (p.x - 1 >= 0 && p.y - 1 >= 0) // top left
+	// Check each edge pixel
+	for (int y = 0; y < img.rows; y++)
 	{
-		if (img.at<uchar>(p.y - 1, p.x - 1) > 0 && !(img.at<uchar>(p.y - 1, p.x) > 0 || img.at<uchar>(p.y, p.x - 1) > 0))
+		const uchar *row = img.ptr<uchar>(y);
+		const uchar *mask = ambiguityMask.ptr<uchar>(y);
+
+		for (int x = 0; x < img.cols; x++)
 		{
-			v.push_back(cv::Point(p.x - 1, p.y - 1));
+			// Trace only non-cluster pixels which are not yet traced (= skip tracing for pixels with edgeId or in a cluster)
+			if (row[x] > 0 && mask[x] == 0)
+			{
+				// Main tracing function
+				traceEdge(cv::Point(x, y), componentEdges);
+				recordComponentMerge(edges.size(), componentEdges.size());
+
+				for (auto& edge : componentEdges)
+				{
+					for (const auto& point : edge)
+					{
+						edgeMap.pushBackEdgeId(point.x, point.y, edges.size());
+					}
+
+					edges.pushBack(std::move(edge));
+				}
+			}
 		}
 	}
-	if (p.y - 1 >= 0) // top center
+
+	edgeIdCounter = edges.size();
+}
+
+EdgeMap::Backend EdgeProcessor::selectEdgeMapBackend(const cv::Mat &img) const
+{
+	int sampleRows = std::min(img.rows, DENSITY_SAMPLE_ROWS);
+	size_t edgePixels = 0;
+
+	for (int i = 0; i < sampleRows; i++)
 	{
-		if (img.at<uchar>(p.y - 1, p.x) > 0)
+		const uchar *row = img.ptr<uchar>(static_cast<int>(static_cast<int64_t>(i) * img.rows / sampleRows));
+
+		for (int x = 0; x < img.cols; x++)
 		{
-			v.push_back(cv::Point(p.x, p.y - 1));
+			edgePixels += (row[x] > 0);
 		}
 	}
-	if (p.x + 1 < img.cols && p.y - 1 >= 0) // top right
+
+	double density = (sampleRows > 0 && img.cols > 0) ? static_cast<double>(edgePixels) / (static_cast<double>(sampleRows) * img.cols) : 0.0;
+
+	return (density < SPARSE_DENSITY_THRESHOLD) ? EdgeMap::Backend::Sparse : EdgeMap::Backend::Dense;
+}
+
+void EdgeProcessor::preprocessClusters(const cv::Mat &img)
+{
+	PhaseTimer timer(statistics, "preprocessClusters", edges);
+
+	// Binary code and cluster status of all pixels
+	classifyNeighborhoods(img, binaryCodes, ambiguityMask, numberOfThreads);
+
+	if (statistics)
+	{
+		statistics->clusters = 0;
+		statistics->clusterPoints = 0;
+		statistics->clusterSizeHistogram.clear();
+	}
+
+	// Connected cluster points form a cluster (labeled in parallel with more than one thread)
+	for (auto& clusterPoints : groupClusters(binaryCodes, ambiguityMask, tileSize, numberOfThreads))
 	{
-		if (img.at<uchar>(p.y - 1, p.x + 1) > 0 && !(img.at<uchar>(p.y - 1, p.x) > 0 || img.at<uchar>(p.y, p.x + 1) > 0))
+		if (statistics)
 		{
-			v.push_back(cv::Point(p.x + 1, p.y - 1));
+			statistics->clusters++;
+			statistics->clusterPoints += clusterPoints.size();
+			statistics->clusterSizeHistogram[clusterPoints.size()]++;
 		}
+
+		edgeMap.addCluster(std::move(clusterPoints));
 	}
-	if (p.x + 1 < img.cols) // middle right
+}
+
+void EdgeProcessor::traceEdgesParallel(const cv::Mat &img)
+{
+	int threads = resolveNumberOfThreads(numberOfThreads);
+	std::vector<int> seeds = findEdgeComponentSeeds(img, binaryCodes, ambiguityMask, tileSize, threads);
+
+	// Edges of each component. Components do not share non-cluster pixels, so threads can trace (and mark pixels in
+	// the ambiguityMask) concurrently.
+	std::vector<std::vector<std::vector<cv::Point>>> componentEdges(seeds.size());
+	int numberOfTasks = (seeds.size() + SEEDS_PER_TRACE_TASK - 1) / SEEDS_PER_TRACE_TASK;
+
+	parallelFor(numberOfTasks, threads, [&](int task, int)
 	{
-		if (img.at<uchar>(p.y, p.x + 1) > 0)
+		for (size_t i = task * SEEDS_PER_TRACE_TASK; i < std::min(seeds.size(), (size_t)(task + 1) * SEEDS_PER_TRACE_TASK); i++)
 		{
-			v.push_back(cv::Point(p.x + 1, p.y));
+			traceEdge(cv::Point(seeds[i] % img.cols, seeds[i] / img.cols), componentEdges[i]);
 		}
+	});
+
+	// Commit in seed order (= order of the serial raster scan), the edgeIds are shifted by the number of preceding edges.
+	// Each non-cluster pixel belongs to exactly one non-empty edge, cluster points get the edgeIds of all adjacent
+	// components in component order (as with serial tracing).
+	std::vector<int> edgeIdOffsets(seeds.size() + 1, 0);
+
+	for (size_t i = 0; i < seeds.size(); i++)
+	{
+		edgeIdOffsets[i + 1] = edgeIdOffsets[i] + componentEdges[i].size();
+	}
+
+	for (int edgeId = 0; edgeId < edgeIdOffsets.back(); edgeId++)
+	{
+		edges.pushBack(std::vector<cv::Point>());
 	}
-	if (p.x + 1 < img.cols && p.y + 1 < img.rows) // bottom right
+
+	// Cluster points are shared by components, their edgeIds are written in component order. Tracing stops at cluster
+	// points, so they can only be the first or last point of an edge.
+	for (size_t i = 0; i < seeds.size(); i++)
 	{
-		if (img.at<uchar>(p.y + 1, p.x + 1) > 0 && !(img.at<uchar>(p.y, p.x + 1) > 0 || img.at<uchar>(p.y + 1, p.x) > 0))
+		for (size_t j = 0; j < componentEdges[i].size(); j++)
 		{
-			v.push_back(cv::Point(p.x + 1, p.y + 1));
+			const std::vector<cv::Point> &edge = componentEdges[i][j];
+
+			if (edge.empty())
+			{
+				continue;
+			}
+
+			for (const cv::Point &point : {edge.front(), edge.back()})
+			{
+				if (ambiguityMask.at<uchar>(point) == CLUSTER_POINT)
+				{
+					edgeMap.pushBackEdgeId(point.x, point.y, edgeIdOffsets[i] + j);
+				}
+			}
 		}
+
+		recordComponentMerge(edgeIdOffsets[i], componentEdges[i].size());
 	}
-	if (p.y + 1 < img.rows) // bottom center
+
+	// Edges and non-cluster pixels belong to exactly one component, the vector and dense backend can write them concurrently
+	// (edges in the chain code storage share one buffer, they are written afterwards)
+	int commitThreads = (edgeMap.getBackend() == EdgeMap::Backend::Sparse) ? 1 : threads;
+	bool concurrentOverwrite = (edges.getStorage() == Edges::Storage::Points);
+
+	parallelFor(numberOfTasks, commitThreads, [&](int task, int)
 	{
-		if (img.at<uchar>(p.y + 1, p.x) > 0)
+		for (size_t i = task * SEEDS_PER_TRACE_TASK; i < std::min(seeds.size(), (size_t)(task + 1) * SEEDS_PER_TRACE_TASK); i++)
 		{
-			v.push_back(cv::Point(p.x, p.y + 1));
+			for (size_t j = 0; j < componentEdges[i].size(); j++)
+			{
+				for (const auto& point : componentEdges[i][j])
+				{
+					if (ambiguityMask.at<uchar>(point) == TRACED_PIXEL)
+					{
+						edgeMap.pushBackEdgeId(point.x, point.y, edgeIdOffsets[i] + j);
+					}
+				}
+
+				if (concurrentOverwrite)
+				{
+					edges.overwrite(edgeIdOffsets[i] + j, std::move(componentEdges[i][j]));
+				}
+			}
 		}
-	}
-	if (p.x - 1 >= 0 && p.y + 1 < img.rows) // bottom left
+	});
+
+	if (!concurrentOverwrite)
 	{
-		if (img.at<uchar>(p.y + 1, p.x - 1) > 0 && !(img.at<uchar>(p.y + 1, p.x) > 0 || img.at<uchar>(p.y, p.x - 1) > 0))
+		for (size_t i = 0; i < seeds.size(); i++)
 		{
-			v.push_back(cv::Point(p.x - 1, p.y + 1));
+			for (size_t j = 0; j < componentEdges[i].size(); j++)
+			{
+				edges.overwrite(edgeIdOffsets[i] + j, std::move(componentEdges[i][j]));
+			}
 		}
 	}
-	if (p.x - 1 >= 0) // middle left
+
+	edgeIdCounter = edges.size();
+}
+
+void EdgeProcessor::traceEdge(cv::Point startPoint, std::vector<std::vector<cv::Point>> &componentEdges)
+{
+	// Pending work, processed last in first out: either continue an edge at a point (edge holds the points traced
+	// so far) or merge the two most recently finished edges. This replaces recursion, so the stack depth does not
+	// grow with the length of an edge.
+	struct TraceTask
 	{
-		if (img.at<uchar>(p.y, p.x - 1) > 0)
+		bool merge;
+		cv::Point point;
+		std::vector<cv::Point> edge;
+	};
+
+	componentEdges.clear();
+
+	std::vector<TraceTask> tasks;
+	tasks.push_back({false, startPoint, {}});
+
+	cv::Point unvisitedNeighbors[8];
+
+	while (!tasks.empty())
+	{
+		TraceTask task = std::move(tasks.back());
+		tasks.pop_back();
+
+		if (task.merge)
 		{
-			v.push_back(cv::Point(p.x - 1, p.y));
+			// Both edges start at the split point (case I of mergeEdges): reverse the second edge and prepend it to
+			// the first one without the shared point. The second edge stays empty, so that the edgeIds of the following
+			// edges are the same as with mergeEdges.
+			std::vector<cv::Point> &firstEdge = componentEdges[componentEdges.size() - 2];
+			std::vector<cv::Point> &secondEdge = componentEdges.back();
+
+			secondEdge.erase(secondEdge.begin());
+
+			if (firstEdge.back() == secondEdge.back())
+			{
+				secondEdge.pop_back();
+			}
+
+			firstEdge.insert(firstEdge.begin(), secondEdge.rbegin(), secondEdge.rend());
+			secondEdge.clear();
+			continue;
 		}
-	}
 
-	return v;
+		std::vector<cv::Point> edge = std::move(task.edge);
+		cv::Point point = task.point;
+
+		// Follow the edge pixel by pixel until it ends or splits
+		while (true)
+		{
+			// Add point to current edge
+			edge.push_back(point);
+
+			// Get direct neighbors of point clockwise from top left
+			const NeighborhoodInfo &neighborhood = NEIGHBORHOOD_TABLE[getBinaryCode(point)];
+			int numberUnvisitedNeighbors = 0;
+
+			// Cluster points end the edge, all other points are marked as traced
+			uchar &status = ambiguityMask.at<uchar>(point);
+
+			if (status != CLUSTER_POINT)
+			{
+				status = TRACED_PIXEL;
+
+				for (int i = 0; i < neighborhood.numberOfNeighbors; i++)
+				{
+					cv::Point neighbor(point.x + neighborhood.dx[i], point.y + neighborhood.dy[i]);
+
+					if (ambiguityMask.at<uchar>(neighbor) != TRACED_PIXEL)
+					{
+						unvisitedNeighbors[numberUnvisitedNeighbors++] = neighbor;
+					}
+				}
+			}
+
+			if (numberUnvisitedNeighbors == 1) // Follow edge
+			{
+				point = unvisitedNeighbors[0];
+				continue;
+			}
+
+			if (numberUnvisitedNeighbors == 2)
+			{
+				// Trace in the direction of the first unvisited neighbor, then start a new edge to the other neighbor
+				// and merge both. The other neighbor is visited in case of closed contours or if it is approached from
+				// a cluster. Tasks are pushed in reverse order of execution.
+				tasks.push_back({true, point, {}});
+				tasks.push_back({false, unvisitedNeighbors[1], {point}});
+				tasks.push_back({false, unvisitedNeighbors[0], {point}});
+			}
+			else if (numberUnvisitedNeighbors == 0) // End edge
+			{
+				componentEdges.push_back(std::move(edge));
+			}
+
+			break;
+		}
+	}
 }
 
-const bool EdgeProcessor::containsFourCluster(uint8_t binaryCode)
+void EdgeProcessor::recordComponentMerge(int firstEdgeId, int numberOfEdges) const
 {
-	return ((binaryCode & UPPER_LEFT) == UPPER_LEFT ||
-		    (binaryCode & UPPER_RIGHT) == UPPER_RIGHT ||
-		    (binaryCode & LOWER_RIGHT) == LOWER_RIGHT ||
-		    (binaryCode & LOWER_LEFT) == LOWER_LEFT);
+	// A component traced in two directions consists of the merged edge and an empty edge
+	if (numberOfEdges == 2)
+	{
+		if (statistics)
+		{
+			statistics->merges++;
+		}
+
+		if (LOG_MERGES)
+		{
+			std::cout << "Merging edge " << firstEdgeId << " and " << firstEdgeId + 1 << std::endl;
+		}
+	}
 }
 
 void EdgeProcessor::mergeEdges(int firstId, int secondId)
@@ -234,213 +729,196 @@ void EdgeProcessor::mergeEdges(int firstId, int secondId)
 		return;
 	}
 
-	std::cout << "Merging edge " << firstId << " and " << secondId << std::endl;
+	if (statistics)
+	{
+		statistics->merges++;
+	}
+
+	if (LOG_MERGES)
+	{
+		std::cout << "Merging edge " << firstId << " and " << secondId << std::endl;
+	}
+
+	invalidateEdgeCaches(firstId);
+	invalidateEdgeCaches(secondId);
 
-	std::vector<cv::Point> firstEdge = edges.getEdge(firstId);
-	std::vector<cv::Point> secondEdge = edges.getEdge(secondId);
+	// In the edgeIdMap, replace the secondId with the firstId (resolved when the pixels are accessed)
+	edgeMap.redirectEdgeId(secondId, firstId);
 
-	edges.clearEdge(firstId);
-	edges.clearEdge(secondId);
+	size_t secondSize = edges.getEdgeSize(secondId);
 
-	// Assign the same edgeId to both edges
-	for (const auto& point : secondEdge)
+	if (edges.getEdgeSize(firstId) == 0 || secondSize == 0)
 	{
-		// In the edgeIdMap, replace the secondId with the firstId
-		// The merging includes both Ids, but pushBackEdgeId makes sure that edgeId is not already in point
-		edgeMap.eraseEdgeId(point.x, point.y, secondId);
-		edgeMap.pushBackEdgeId(point.x, point.y, firstId);
+		edges.join(firstId, secondId, false, false, 0, 0);
+		return;
 	}
 
+	cv::Point firstStart = edges.getStartPoint(firstId);
+	cv::Point firstEnd = edges.getEndPoint(firstId);
+	cv::Point secondStart = edges.getStartPoint(secondId);
+	cv::Point secondEnd = edges.getEndPoint(secondId);
+
 	// Check if the connection point is start point of both edges
 	// For the regular tracing, this is the only branch which can be entered (when going into two directions).
 	// The remaining checks are only required for post-processing.
-	if (firstEdge.front() == secondEdge.front())
+	if (firstStart == secondStart)
 	{
-		secondEdge.erase(secondEdge.begin());
-
 		// Delete shared pixel if present at both ends. This occurs when connecting the same edge with a line or merging
 		// two edges that share a pixel in a cluster. When connected outside the cluster, they form a single closed edge,
 		// requiring the removal of the shared pixel to avoid duplication.
-		if (firstEdge.back() == secondEdge.back())
-		{
-			secondEdge.pop_back(); // Remove last element
-		}
+		bool sharedEndPoint = (secondSize > 1 && firstEnd == secondEnd);
 
-		// Reverse second edge and prepend to first edge
-		firstEdge.insert(firstEdge.begin(), secondEdge.rbegin(), secondEdge.rend());
+		// Reverse second edge (without the connection point) and prepend to first edge
+		edges.join(firstId, secondId, true, true, 1, sharedEndPoint ? 1 : 0);
 
 		//std::cout << "EdgeProcessor::mergeEdges - Case I" << std::endl;
 	}
 
 	// Merge edges where the start point of the first edge equals the end point of the second edge
-	else if (firstEdge.front() == secondEdge.back())
+	else if (firstStart == secondEnd)
 	{
-		secondEdge.pop_back();
-
 		// Same principle as above
-		if (firstEdge.back() == secondEdge.front())
-		{
-			secondEdge.erase(secondEdge.begin());
-		}
+		bool sharedEndPoint = (secondSize > 1 && firstEnd == secondStart);
 
 		// Prepend second edge to first edge
-		firstEdge.insert(firstEdge.begin(), secondEdge.begin(), secondEdge.end());
+		edges.join(firstId, secondId, true, false, sharedEndPoint ? 1 : 0, 1);
 
 		//std::cout << "EdgeProcessor::mergeEdges - Case II" << std::endl;
 	}
 
 	// Merge edges where the end point of the first edge equals the start point of the second edge
-	else if (firstEdge.back() == secondEdge.front())
+	else if (firstEnd == secondStart)
 	{
-		secondEdge.erase(secondEdge.begin());
-		firstEdge.insert(firstEdge.end(), secondEdge.begin(), secondEdge.end());
+		edges.join(firstId, secondId, false, false, 1, 0);
 
 		//std::cout << "EdgeProcessor::mergeEdges - Case III" << std::endl;
 	}
 
 	// Merge edges with same end point
-	else if (firstEdge.back() == secondEdge.back())
+	else if (firstEnd == secondEnd)
 	{
-		secondEdge.pop_back();
-		firstEdge.insert(firstEdge.end(), secondEdge.rbegin(), secondEdge.rend());
+		edges.join(firstId, secondId, false, true, 0, 1);
 
 		//std::cout << "EdgeProcessor::mergeEdges - Case IV" << std::endl;
 	}
 
-	edges.overwrite(firstId, firstEdge);
+	// Edges without shared end point: the first edge is kept
+	else
+	{
+		edges.clearEdge(secondId);
+	}
 }
 
-const EdgeMap &EdgeProcessor::getEdgeIdMap() const // Return value is read-only
+int EdgeProcessor::addConnectingEdge(const std::vector<cv::Point> &points)
 {
-	return edgeMap;
-}
+	int edgeId = edges.size();
+	edges.pushBack(points);
 
-const Edges &EdgeProcessor::getEdges() const // Return value is read-only
-{
-	return edges;
+	// Like traced edges, so merging only has to redirect the edgeId
+	for (const auto& point : points)
+	{
+		edgeMap.pushBackEdgeId(point.x, point.y, edgeId);
+	}
+
+	return edgeId;
 }
 
-void EdgeProcessor::printEdgeInfos(cv::Mat &img)
+void EdgeProcessor::forEachCluster(const std::function<void(const ClusterView &)> &visitor)
 {
-	std::cout << "Input image: " << img.rows << " rows x " << img.cols << " cols = " << img.total() << " px\n";
+	ClusterView cluster;
 
-	// Count number of edge pixels
-	int cnt = 0;
-	for (int y = 0; y < img.rows; y++)
+	for (const cv::Point &position : edgeMap.getClusterPositions())
 	{
-		for (int x = 0; x < img.cols; x++)
+		// Cleared by the visit of a previous cluster
+		if (!edgeMap.isCluster(position.x, position.y))
+		{
+			continue;
+		}
+
+		cluster.position = position;
+		cluster.points = &edgeMap.getClusterPoints(position.x, position.y);
+		cluster.edgeIds = edgeMap.getClusterEdgeIds(position.x, position.y);
+		cluster.endPoints.clear();
+
+		for (int edgeId : cluster.edgeIds)
 		{
-			if (img.at<uchar>(y, x) > 0)
+			if (edges.getEdgeSize(edgeId) == 0)
+			{
+				continue;
+			}
+
+			for (const cv::Point &point : {edges.getStartPoint(edgeId), edges.getEndPoint(edgeId)})
 			{
-				cnt++;
+				if (edgeMap.isPointInCluster(position.x, position.y, point))
+				{
+					cluster.endPoints.push_back({edgeId, point});
+				}
 			}
 		}
-	}
 
-	// Print information
-	std::cout << "Edge pixels in input image: " << cnt << " px\n";
-	std::cout << "Number of traced edges: " << edges.size() << "\n";
+		visitor(cluster);
+	}
 }
 
-uint8_t EdgeProcessor::getBinaryCode(cv::Mat &img, cv::Point p)
+const EdgeMap &EdgeProcessor::getEdgeIdMap() const // Return value is read-only
 {
+	return edgeMap;
+}
 
-	/*
-	Returns occupancy of all neighbors of p as binary code, 7 = most significant bit
-	7 6 5
-	0 p 4
-	1 2 3
-	*/
+const Edges &EdgeProcessor::getEdges() const // Return value is read-only
+{
+	return edges;
+}
 
-	uint8_t bin = 0;
+void EdgeProcessor::printEdgeInfos(cv::Mat &img)
+{
+	std::cout << "Input image: " << img.rows << " rows x " << img.cols << " cols = " << img.total() << " px\n";
 
-	// Only access neighbors inside the image
-	if (p.x - 1 >= 0 && p.y - 1 >= 0) // top left
-	{
-		if (img.at<uchar>(p.y - 1, p.x - 1) > 0)
-		{
-			bin = bin + 128;
-		}
-	}
-	if (p.y - 1 >= 0) // top center
-	{
-		if (img.at<uchar>(p.y - 1, p.x) > 0)
-		{
-			bin = bin + 64;
-		}
-	}
-	if (p.x + 1 < img.cols && p.y - 1 >= 0) // top right
-	{
-		if (img.at<uchar>(p.y - 1, p.x + 1) > 0)
-		{
-			bin = bin + 32;
-		}
-	}
-	if (p.x + 1 < img.cols) // middle right
-	{
-		if (img.at<uchar>(p.y, p.x + 1) > 0)
-		{
-			bin = bin + 16;
-		}
-	}
-	if (p.x + 1 < img.cols && p.y + 1 < img.rows) // bottom right
-	{
-		if (img.at<uchar>(p.y + 1, p.x + 1) > 0)
-		{
-			bin = bin + 8;
-		}
-	}
-	if (p.y + 1 < img.rows) // bottom center
-	{
-		if (img.at<uchar>(p.y + 1, p.x) > 0)
-		{
-			bin = bin + 4;
-		}
-	}
-	if (p.x - 1 >= 0 && p.y + 1 < img.rows) // bottom left
-	{
-		if (img.at<uchar>(p.y + 1, p.x - 1) > 0)
-		{
-			bin = bin + 2;
-		}
-	}
-	if (p.x - 1 >= 0) // middle left
-	{
-		if (img.at<uchar>(p.y, p.x - 1) > 0)
-		{
-			bin = bin + 1;
-		}
-	}
+	// Print information
+	std::cout << "Edge pixels in input image: " << countEdgePixels(img) << " px\n";
+	std::cout << "Number of traced edges: " << edges.size() << "\n";
+}
 
-	return bin;
+uint8_t EdgeProcessor::getBinaryCode(cv::Point p) const
+{
+	// Computed for all pixels in preprocessClusters
+	return binaryCodes.at<uchar>(p.y, p.x);
 }
 
 void EdgeProcessor::cleanUpEdges()
 {
-	edges.eraseEmptyEdges(); // Erase all empty positions in edges
+	PhaseTimer timer(statistics, "cleanUpEdges", edges);
+	previousFrame.release();
+
+	std::vector<int> newEdgeIds = edges.eraseEmptyEdges(); // Erase all empty positions in edges
+	remapEdgeCaches(newEdgeIds); // Edges have new edgeIds
 	edgeMap.resetEdgeIdMap(); // Recreate edgeIdMap from scratch
 
-	for (const auto& edge : edges.getEdges())
-	{
-		int edgeId = edges.getEdgeId(edge);
+	// New edgeId of each edge (identical edges share the first edgeId)
+	std::vector<int> edgeIds = edges.getEdgeIds();
 
+	for (size_t i = 0; i < edges.size(); i++)
+	{
 		// Write edgeId at all points of current edge
-		for (const auto& point : edge)
+		for (const auto& point : edges.getPoints(i))
 		{
-			edgeMap.pushBackEdgeId(point.x, point.y, edgeId);
+			edgeMap.pushBackEdgeId(point.x, point.y, edgeIds[i]);
 		}
 	}
 }
 
 void EdgeProcessor::resetClusters(cv::Mat img)
 {
+	PhaseTimer timer(statistics, "resetClusters", edges);
+	previousFrame.release();
+
 	edgeMap.resetClusterMap();
 	cv::Mat imgCopy = img.clone();
 
 	// Draw all points of all edges in the image
-	for (const auto& edge : edges.getEdges())
+	for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
 	{
-		for (const auto& point : edge)
+		for (const auto& point : edges.getPoints(edgeId))
 		{
 			imgCopy.at<uchar>(point) = 255;
 		}
@@ -451,17 +929,21 @@ void EdgeProcessor::resetClusters(cv::Mat img)
 
 void EdgeProcessor::threePointEdgesToClusters()
 {
+	PhaseTimer timer(statistics, "threePointEdgesToClusters", edges);
+	previousFrame.release();
+
 	// Essentially, there are two scenarios:
 	// 1: Start and end point are in the same cluster - action: remove the edge and the middle pixel.
 	// 2: Start and end point are in different clusters - action: remove the edge, incorporate the middle pixel into the cluster, and then merge the clusters.
 	// Note: Only the middle pixel is considered for removal or addition.
 
 	// Iterate through all found edges and find edges with a size of 3 (candidate edges)
-	for (const auto& edge : edges.getEdges())
+	for (size_t i = 0; i < edges.size(); i++)
 	{
-		if (edge.size() == 3)
+		if (edges.getEdgeSize(i) == 3)
 		{
-			int edgeId = edges.getEdgeId(edge);
+			std::vector<cv::Point> edge = edges.getEdge(i);
+			int edgeId = edges.getEdgeId(i);
 
 			cv::Point startPoint = edge.front();
 			cv::Point endPoint = edge.back();
@@ -479,10 +961,7 @@ void EdgeProcessor::threePointEdgesToClusters()
 				// Check if start and end point are NOT in the same MPA. If so, add all points from the second cluster (endPoint is connection point) to the first other
 				if (!(edgeMap.getClusterEdgeIds(startPoint.x, startPoint.y) == edgeMap.getClusterEdgeIds(endPoint.x, endPoint.y)))
 				{
-					for (const auto& point : edgeMap.getClusterPoints(endPoint.x, endPoint.y))
-					{
-						edgeMap.addPointToCluster(startPoint.x, startPoint.y, point);
-					}
+					edgeMap.mergeClusters(startPoint.x, startPoint.y, endPoint.x, endPoint.y);
 				}
 
 				// Delete the short edge from edgeMap and edges
@@ -492,6 +971,7 @@ void EdgeProcessor::threePointEdgesToClusters()
 				}
 
 				edges.clearEdge(edgeId);
+				invalidateEdgeCaches(edgeId);
 			}
 		}
 	}
@@ -499,6 +979,9 @@ void EdgeProcessor::threePointEdgesToClusters()
 
 bool EdgeProcessor::removeEdgesShorterThan(size_t numberofPixels, bool free, bool dangling, bool bridged)
 {
+	PhaseTimer timer(statistics, "removeEdgesShorterThan", edges);
+	previousFrame.release();
+
 	bool changes = false;
 	for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
 	{
@@ -523,6 +1006,7 @@ bool EdgeProcessor::removeEdgesShorterThan(size_t numberofPixels, bool free, boo
 					}
 
 					edges.clearEdge(edgeId); // Remove edge from edges
+					invalidateEdgeCaches(edgeId);
 					changes = true;
 				}
 			}
@@ -539,6 +1023,7 @@ bool EdgeProcessor::removeEdgesShorterThan(size_t numberofPixels, bool free, boo
 					}
 
 					edges.clearEdge(edgeId); // Remove edge from edges
+					invalidateEdgeCaches(edgeId);
 					changes = true;
 				}
 			}
@@ -555,6 +1040,7 @@ bool EdgeProcessor::removeEdgesShorterThan(size_t numberofPixels, bool free, boo
 					}
 
 					edges.clearEdge(edgeId); // Remove edge from edges
+					invalidateEdgeCaches(edgeId);
 					changes = true;
 				}
 			}
@@ -574,6 +1060,9 @@ bool EdgeProcessor::removeEdgesShorterThan(size_t numberofPixels, bool free, boo
 
 bool EdgeProcessor::removeEdgesLongerThan(size_t numberofPixels, bool free, bool dangling, bool bridged)
 {
+	PhaseTimer timer(statistics, "removeEdgesLongerThan", edges);
+	previousFrame.release();
+
 	bool changes = false;
 	for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
 	{
@@ -598,6 +1087,7 @@ bool EdgeProcessor::removeEdgesLongerThan(size_t numberofPixels, bool free, bool
 					}
 
 					edges.clearEdge(edgeId); // Remove edge from edges
+					invalidateEdgeCaches(edgeId);
 					changes = true;
 				}
 			}
@@ -614,6 +1104,7 @@ bool EdgeProcessor::removeEdgesLongerThan(size_t numberofPixels, bool free, bool
 					}
 
 					edges.clearEdge(edgeId); // Remove edge from edges
+					invalidateEdgeCaches(edgeId);
 					changes = true;
 				}
 			}
@@ -630,6 +1121,7 @@ bool EdgeProcessor::removeEdgesLongerThan(size_t numberofPixels, bool free, bool
 					}
 
 					edges.clearEdge(edgeId); // Remove edge from edges
+					invalidateEdgeCaches(edgeId);
 					changes = true;
 				}
 			}
@@ -649,8 +1141,11 @@ bool EdgeProcessor::removeEdgesLongerThan(size_t numberofPixels, bool free, bool
 
 void EdgeProcessor::connectEdgesInClusters(size_t numberPixels, double thresholdAngle, double alpha, double beta, bool connectSameEdge)
 {
+	PhaseTimer timer(statistics, "connectEdgesInClusters", edges);
+	previousFrame.release();
+
 	// Function summary:
-	// 1. Search for an ambiguity point.
+	// 1. Visit each ambiguity (cluster) once.
 	// 2. Collect all edgeIds in that ambiguity (clusterEdgeIds).
 	// 3. For the first edgeId, search for start or end points in the ambiguity.
 	// 4. If found, iterate through that edgeId and the remaining edgeIds to search for start or end points in the ambiguity.
@@ -661,176 +1156,285 @@ void EdgeProcessor::connectEdgesInClusters(size_t numberPixels, double threshold
 	// as the edgeIds are retrieved after each merge. Instead, collect connection options
 	// (points and edgeIds) in a list (e.g., a vector of std::pairs) and remove edgeIds that have been merged.
 
-	// Find all cluster (ambiguity) points and check which edgeIds are in that cluster
-	for (int y = 0; y < edgeMap.getRows(); y++)
+	if (resolveNumberOfThreads(numberOfThreads) > 1)
+	{
+		connectEdgesInClustersParallel(numberPixels, thresholdAngle, alpha, beta, connectSameEdge);
+	}
+	else
+	{
+		// Visit each cluster (ambiguity) once
+		forEachCluster([&](const ClusterView &cluster)
+		{
+			connectEdgesInCluster(cluster.position, numberPixels, thresholdAngle, alpha, beta, connectSameEdge, nullptr);
+		});
+	}
+
+	// Merged edges are joined lazily, store them as one edge each
+	edges.flattenJoinedEdges();
+}
+
+void EdgeProcessor::connectEdgesInClustersParallel(size_t numberPixels, double thresholdAngle, double alpha, double beta, bool connectSameEdge)
+{
+	int threads = resolveNumberOfThreads(numberOfThreads);
+	std::vector<cv::Point> positions = edgeMap.getClusterPositions();
+
+	// Clusters of the current batch with the edgeIds and connection points at the time the batch was formed
+	std::vector<cv::Point> batchPositions;
+	std::vector<std::vector<int>> batchEdgeIds;
+	std::vector<std::vector<std::vector<cv::Point>>> batchConnectionPoints;
+	std::vector<cv::Rect> batchBoundingBoxes;
+	std::vector<ClusterConnection> batchConnections;
+	std::vector<bool> edgeInBatch;
+
+	size_t next = 0;
+
+	while (next < positions.size())
 	{
-		for (int x = 0; x < edgeMap.getCols(); x++)
+		batchPositions.clear();
+		batchEdgeIds.clear();
+		batchConnectionPoints.clear();
+		batchBoundingBoxes.clear();
+		edgeInBatch.assign(edges.size(), false);
+
+		// A batch is a run of consecutive clusters (in raster order) which share no edges and whose bounding boxes do not
+		// overlap (connection lines stay within the bounding box of their cluster). A cluster only changes its own edges,
+		// so the first evaluation of every cluster in the batch gives the same result as in the serial order.
+		for (; next < positions.size() && batchPositions.size() < CLUSTERS_PER_CONNECT_BATCH; next++)
 		{
-			// Check if point (x, y) is in cluster
-			if (edgeMap.isCluster(x, y))
+			cv::Point position = positions[next];
+			std::vector<int> clusterEdgeIds = edgeMap.getClusterEdgeIds(position.x, position.y);
+			cv::Rect boundingBox = edgeMap.getClusterBoundingBox(position.x, position.y);
+
+			bool conflict = std::any_of(clusterEdgeIds.begin(), clusterEdgeIds.end(), [&](int edgeId) { return edgeInBatch[edgeId]; }) ||
+							std::any_of(batchBoundingBoxes.begin(), batchBoundingBoxes.end(), [&](const cv::Rect &box) { return (box & boundingBox).area() > 0; });
+
+			if (conflict)
 			{
-				bool changes = true;
-				while (changes)
-				{
-					changes = false;
+				break;
+			}
 
-					std::vector<int> clusterEdgeIds = edgeMap.getClusterEdgeIds(x, y); // Retrieve cluster edgeIds (ordered)
-					double smallestCosts = std::numeric_limits<double>::max();
+			std::vector<std::vector<cv::Point>> connectionPoints;
+
+			for (int edgeId : clusterEdgeIds)
+			{
+				edgeInBatch[edgeId] = true;
+				connectionPoints.push_back(findConnectionPointsInCluster(position.x, position.y, edgeId));
+			}
 
-					// Initialize variables to store the optimal match between two edges
-					int firstEdgeIdForMerge = -1;
-					int secondEdgeIdForMerge = -1;
+			batchPositions.push_back(position);
+			batchEdgeIds.push_back(std::move(clusterEdgeIds));
+			batchConnectionPoints.push_back(std::move(connectionPoints));
+			batchBoundingBoxes.push_back(boundingBox);
+		}
 
-					cv::Point connectionPointFirstEdgeForMerge;
-					cv::Point connectionPointSecondEdgeForMerge;
+		// Evaluate concurrently (only reads the edges and the angles of different edges), then merge in the serial order
+		batchConnections.assign(batchPositions.size(), ClusterConnection());
+		reserveEdgeCaches();
 
-					// Cluster is not modified within the for-loop, therefore clusterEdgeIds.size() = constant
-					for (size_t i = 0; i < clusterEdgeIds.size(); i++)
-					{
-						int firstEdgeId = clusterEdgeIds[i];
-						//std::cout << "firstEdgeId  = " << firstEdgeId << std::endl;
+		parallelFor(batchPositions.size(), threads, [&](int i, int)
+		{
+			batchConnections[i] = findClusterConnection(batchEdgeIds[i], batchConnectionPoints[i], numberPixels, thresholdAngle, alpha, beta, connectSameEdge);
+		});
+
+		for (size_t i = 0; i < batchPositions.size(); i++)
+		{
+			connectEdgesInCluster(batchPositions[i], numberPixels, thresholdAngle, alpha, beta, connectSameEdge, &batchConnections[i]);
+		}
+	}
+}
+
+void EdgeProcessor::connectEdgesInCluster(cv::Point position, size_t numberPixels, double thresholdAngle, double alpha, double beta, bool connectSameEdge,
+										  const ClusterConnection *firstConnection)
+{
+	int x = position.x;
+	int y = position.y;
+
+	bool changes = true;
+	while (changes)
+	{
+		ClusterConnection connection;
+
+		if (firstConnection)
+		{
+			connection = *firstConnection;
+			firstConnection = nullptr;
+		}
+		else
+		{
+			std::vector<int> clusterEdgeIds = edgeMap.getClusterEdgeIds(x, y); // Retrieve cluster edgeIds (ordered)
+			std::vector<std::vector<cv::Point>> connectionPoints;
+
+			for (int edgeId : clusterEdgeIds)
+			{
+				connectionPoints.push_back(findConnectionPointsInCluster(x, y, edgeId));
+			}
+
+			connection = findClusterConnection(clusterEdgeIds, connectionPoints, numberPixels, thresholdAngle, alpha, beta, connectSameEdge);
+		}
+
+		if (statistics)
+		{
+			statistics->connectCandidates.evaluated += connection.evaluatedCandidates;
+		}
+
+		// Merge edges if their angle difference is below thresholdAngle
+		changes = (connection.firstEdgeId >= 0);
+
+		if (changes)
+		{
+			if (statistics)
+			{
+				statistics->connectCandidates.accepted++;
+			}
+
+			// Compute the line segment connecting the two points within the cluster
+			std::vector<cv::Point> tmpEdge = getLinePoints(connection.firstPoint, connection.secondPoint);
+			//std::cout << tmpEdge << std::endl;
+			int tmpEdgeId = addConnectingEdge(tmpEdge);
+
+			// Merge the line segment with existing edge
+			mergeEdges(connection.firstEdgeId, tmpEdgeId);
+
+			// If it is the same edge, the connection line is already part of that edge after the first merge
+			if (connection.firstEdgeId != connection.secondEdgeId)
+			{
+				mergeEdges(connection.firstEdgeId, connection.secondEdgeId);
+			}
+		}
+	}
+}
+
+EdgeProcessor::ClusterConnection EdgeProcessor::findClusterConnection(const std::vector<int> &clusterEdgeIds, const std::vector<std::vector<cv::Point>> &connectionPoints,
+																	  size_t numberPixels, double thresholdAngle, double alpha, double beta, bool connectSameEdge)
+{
+	ClusterConnection connection;
+	double smallestCosts = std::numeric_limits<double>::max();
+
+	// Cluster is not modified within the for-loop, therefore clusterEdgeIds.size() = constant
+	for (size_t i = 0; i < clusterEdgeIds.size(); i++)
+	{
+		int firstEdgeId = clusterEdgeIds[i];
+		//std::cout << "firstEdgeId  = " << firstEdgeId << std::endl;
+
+		// There is no meaningful connection point to a closed edge
+		if (edges.isClosed(firstEdgeId))
+		{
+			continue; // Skip the remaining part of the loop
+		}
+
+		// An edge can connect to a cluster at zero points (passes through), one point (start or end), or two points (start and end),
+		// and the loop goes through the connection points
+		const std::vector<cv::Point> &connectionPointsFirstEdge = connectionPoints[i];
+		for (const cv::Point& connectionPointFirstEdge : connectionPointsFirstEdge)
+		{
+			// Calculate the angle of the first edge
+			double firstAngle = getEdgeEndAngle(firstEdgeId, connectionPointFirstEdge, numberPixels);
+			//std::cout << "firstAngle = " << firstAngle << std::endl;
+
+			// Go through all edgeIds in the cluster which are candidates for merging
+			for (size_t j = i; j < clusterEdgeIds.size(); j++)
+			{
+				int secondEdgeId = clusterEdgeIds[j];
+
+				// There is no meaningful connection point to a closed edge
+				if (edges.isClosed(secondEdgeId))
+				{
+					continue; // Skip the remaining part of the loop
+				}
+
+				// Connecting 3px L-edges with themselves is not meaningful
+				if ((firstEdgeId == secondEdgeId) && edges.isThreePixelL(firstEdgeId))
+				{
+					continue;
+				}
 
-						// There is no meaningful connection point to a closed edge
-						if (edges.isClosed(firstEdgeId))
+				// Connect edges if they are different, or if they are the same and connectSameEdge is true
+				if ((firstEdgeId != secondEdgeId) || connectSameEdge)
+				{
+					// Same as for-loop above (connectionPointFirstEdge)
+					const std::vector<cv::Point> &connectionPointsSecondEdge = connectionPoints[j];
+					for (const cv::Point& connectionPointSecondEdge : connectionPointsSecondEdge)
+					{
+						// Do not connect the same point of the same edge (required due to iterating through all connection points)
+						if ((connectionPointFirstEdge == connectionPointSecondEdge) && (firstEdgeId == secondEdgeId))
 						{
-							continue; // Skip the remaining part of the loop
+							continue;
 						}
 
-						// An edge can connect to a cluster at zero points (passes through), one point (start or end), or two points (start and end),
-						// and the loop goes through the connection points
-						std::vector<cv::Point> connectionPointsFirstEdge = findConnectionPointsInCluster(x, y, firstEdgeId);
-						for (const cv::Point& connectionPointFirstEdge : connectionPointsFirstEdge)
-						{
-							// Calculate the angle of the first edge
-							double firstAngle = getEdgeAngleWithLSM(edges.getPointsAlongEdgeFromPoint(firstEdgeId, connectionPointFirstEdge, numberPixels));
-							//std::cout << "firstAngle = " << firstAngle << std::endl;
+						// Calculate the angle of the second edge
+						double secondAngle = getEdgeEndAngle(secondEdgeId, connectionPointSecondEdge, numberPixels);
 
-							// Go through all edgeIds in the cluster which are candidates for merging
-							for (size_t j = i; j < clusterEdgeIds.size(); j++)
-							{
-								int secondEdgeId = clusterEdgeIds[j];
-
-								// There is no meaningful connection point to a closed edge
-								if (edges.isClosed(secondEdgeId))
-								{
-									continue; // Skip the remaining part of the loop
-								}
-
-								// Connecting 3px L-edges with themselves is not meaningful
-								if ((firstEdgeId == secondEdgeId) && edges.isThreePixelL(firstEdgeId))
-								{
-									continue;
-								}
-
-								// Connect edges if they are different, or if they are the same and connectSameEdge is true
-								if ((firstEdgeId != secondEdgeId) || connectSameEdge)
-								{
-									// Same as for-loop above (connectionPointFirstEdge)
-									std::vector<cv::Point> connectionPointsSecondEdge = findConnectionPointsInCluster(x, y, secondEdgeId);
-									for (const cv::Point& connectionPointSecondEdge : connectionPointsSecondEdge)
-									{
-										// Do not connect the same point of the same edge (required due to iterating through all connection points)
-										if ((connectionPointFirstEdge == connectionPointSecondEdge) && (firstEdgeId == secondEdgeId))
-										{
-											continue;
-										}
-
-										// Calculate the angle of the second edge
-										double secondAngle = getEdgeAngleWithLSM(edges.getPointsAlongEdgeFromPoint(secondEdgeId, connectionPointSecondEdge, numberPixels));
-
-										// Calculate the difference between the two edge angles
-										double currentAngleDiff = std::abs(firstAngle - secondAngle);
-										//std::cout << "secondAngle = " << secondAngle << std::endl;
-
-										currentAngleDiff = std::abs(currentAngleDiff - 180.0); // Best match is at 180 (edges point towards each other)
-										//std::cout << "currentAngleDiff " << currentAngleDiff << " id1 = " << firstEdgeId << " id2 = " << secondEdgeId << std::endl;
-
-										double distance = std::sqrt(std::pow((connectionPointFirstEdge.x-connectionPointSecondEdge.x), 2) + std::pow((connectionPointFirstEdge.y-connectionPointSecondEdge.y), 2));
-										double currentCosts = alpha*currentAngleDiff + beta*distance;
-
-										if ((currentAngleDiff < thresholdAngle) && (currentCosts < smallestCosts))
-										{
-											smallestCosts = currentCosts;
-
-											firstEdgeIdForMerge = firstEdgeId;
-											secondEdgeIdForMerge = secondEdgeId;
-
-											connectionPointFirstEdgeForMerge = connectionPointFirstEdge;
-											connectionPointSecondEdgeForMerge = connectionPointSecondEdge;
-
-											changes = true;
-										}
-									}
-								}
-							}
-						}
-					}
+						// Calculate the difference between the two edge angles
+						double currentAngleDiff = std::abs(firstAngle - secondAngle);
+						//std::cout << "secondAngle = " << secondAngle << std::endl;
 
-					// Merge edges if their angle difference is below thresholdAngle (determined by the preceding if-check)
-					if (changes)
-					{
-						// Compute the line segment connecting the two points within the cluster
-						std::vector<cv::Point> tmpEdge = getLinePoints(connectionPointFirstEdgeForMerge, connectionPointSecondEdgeForMerge);
-						//std::cout << tmpEdge << std::endl;
-						edges.pushBack(tmpEdge);
-						int tmpEdgeId = edges.size()-1; // Id of tmpEdge, which has just been pushed back
+						currentAngleDiff = std::abs(currentAngleDiff - 180.0); // Best match is at 180 (edges point towards each other)
+						//std::cout << "currentAngleDiff " << currentAngleDiff << " id1 = " << firstEdgeId << " id2 = " << secondEdgeId << std::endl;
 
-						// Merge the line segment with existing edge
-						mergeEdges(firstEdgeIdForMerge, tmpEdgeId);
+						double distance = std::sqrt(std::pow((connectionPointFirstEdge.x-connectionPointSecondEdge.x), 2) + std::pow((connectionPointFirstEdge.y-connectionPointSecondEdge.y), 2));
+						double currentCosts = alpha*currentAngleDiff + beta*distance;
 
-						// If it is the same edge, the connection line is already part of that edge after the first merge
-						if (firstEdgeIdForMerge != secondEdgeIdForMerge)
+						connection.evaluatedCandidates++;
+
+						if ((currentAngleDiff < thresholdAngle) && (currentCosts < smallestCosts))
 						{
-							mergeEdges(firstEdgeIdForMerge, secondEdgeIdForMerge);
+							smallestCosts = currentCosts;
+
+							connection.firstEdgeId = firstEdgeId;
+							connection.secondEdgeId = secondEdgeId;
+
+							connection.firstPoint = connectionPointFirstEdge;
+							connection.secondPoint = connectionPointSecondEdge;
 						}
 					}
 				}
 			}
 		}
 	}
+
+	return connection;
 }
 
 void EdgeProcessor::closeEdgesInClusters()
 {
-	// This function iterates through all cluster points.
-	// Alternative implementation: iterate through all edges and check if their start and end point are in the same cluster
-	// (probably more efficient).
+	PhaseTimer timer(statistics, "closeEdgesInClusters", edges);
+	previousFrame.release();
 
-	// Find all cluster points and check which edgeIds are in that cluster
-	for (int y = 0; y < edgeMap.getRows(); y++)
+	// Visit each cluster once and check which of its edges have their start and end point in the cluster
+	forEachCluster([&](const ClusterView &cluster)
 	{
-		for (int x = 0; x < edgeMap.getCols(); x++)
+		// Edges with start and end point in the cluster are listed twice (one after the other) in endPoints
+		for (size_t i = 0; i + 1 < cluster.endPoints.size(); i++)
 		{
-			// Check if point (x, y) is in cluster
-			if (edgeMap.isCluster(x, y))
+			int edgeId = cluster.endPoints[i].first;
+
+			// Skip edges which are too short (< 5) to have a start and end point in cluster
+			if (cluster.endPoints[i + 1].first != edgeId || edges.getEdgeSize(edgeId) < 5)
 			{
-				std::vector<int> clusterEdgeIds = edgeMap.getClusterEdgeIds(x, y);
+				continue;
+			}
 
-				// Check for each edge in cluster if start and end point are in the cluster
-				for (const auto& edgeId : clusterEdgeIds)
-				{
-					// Skip empty edges in edgeVector and edges which are too short (< 5) to have a start and end point in cluster
-					if (edges.getEdgeSize(edgeId) >= 5)
-					{
-						cv::Point startPoint = edges.getStartPoint(edgeId);
-						cv::Point endPoint = edges.getEndPoint(edgeId);
+			cv::Point startPoint = cluster.endPoints[i].second;
+			cv::Point endPoint = cluster.endPoints[i + 1].second;
 
-						// Add connecting edge if the points are not 8-neighbors (otherwise it is already closed)
-						bool startAndEndPointInCluster = (edgeMap.isPointInCluster(x, y, startPoint)) && (edgeMap.isPointInCluster(x, y, endPoint));
-						if (startAndEndPointInCluster && !edges.isClosed(edgeId))
-						{
-							std::vector<cv::Point> tmpEdge = getLinePoints(startPoint, endPoint);
-							std::cout << tmpEdge << std::endl;
+			// Add connecting edge if the points are not 8-neighbors (otherwise it is already closed)
+			if (!edges.isClosed(edgeId))
+			{
+				std::vector<cv::Point> tmpEdge = getLinePoints(startPoint, endPoint);
 
-							edges.pushBack(tmpEdge);
-							int tmpEdgeId = edges.size()-1; // Id of tmpEdge, which has just been pushed back
-							mergeEdges(edgeId, tmpEdgeId);
-						}
-					}
+				if (LOG_MERGES)
+				{
+					std::cout << tmpEdge << std::endl;
 				}
+
+				int tmpEdgeId = addConnectingEdge(tmpEdge);
+				mergeEdges(edgeId, tmpEdgeId);
 			}
 		}
-	}
+	});
+
+	// Merged edges are joined lazily, store them as one edge each
+	edges.flattenJoinedEdges();
 }
 
 bool EdgeProcessor::findStartOrEndPointInCluster(int x, int y, int edgeId, cv::Point& connectionPoint)
@@ -864,11 +1468,33 @@ std::vector<cv::Point> EdgeProcessor::findConnectionPointsInCluster(int x, int y
 		connectionPoints.push_back(edges.getEndPoint(edgeId));
 	}
 
-	return connectionPoints;
-}
+	return connectionPoints;
+}
+
+void EdgeProcessor::bridgeEdgeGaps(size_t numberPixels, double thresholdAngle, int blockDistance, double alpha, double beta)
+{
+	PhaseTimer timer(statistics, "bridgeEdgeGaps", edges);
+	previousFrame.release();
+
+	// Merging only joins edges at their endpoints, so the start and end points of the merged edges are always
+	// among the current ones. The index is therefore built once and only loses the points which are joined.
+	EndpointIndex endpoints(edgeMap.getCols(), edgeMap.getRows(), blockDistance);
+	for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+	{
+		if (edges.getEdgeSize(edgeId) > 0)
+		{
+			endpoints.insert(edges.getStartPoint(edgeId));
+			endpoints.insert(edges.getEndPoint(edgeId));
+		}
+	}
+
+	if (useGlobalGapBridging)
+	{
+		bridgeEdgeGapsGlobal(endpoints, numberPixels, thresholdAngle, blockDistance, alpha, beta);
+		edges.flattenJoinedEdges();
+		return;
+	}
 
-void EdgeProcessor::bridgeEdgeGaps(size_t numberPixels, double thresholdAngle, int blockDistance, double alpha, double beta)
-{
 	size_t numberEdgeIds = edges.size();
 	for (size_t edgeId = 0; edgeId < numberEdgeIds; edgeId++)
 	{
@@ -877,11 +1503,8 @@ void EdgeProcessor::bridgeEdgeGaps(size_t numberPixels, double thresholdAngle, i
 		{
 			changes = false;
 
-			// Get Edge with current edgeId
-			std::vector<cv::Point> edge = edges.getEdge(edgeId);
-
-			// Two reasons why edge.size() > 1: There can be empty edges after merging; Do not start from isolated pixels
-			if (edge.size() > 1)
+			// Two reasons why the size is > 1: There can be empty edges after merging; Do not start from isolated pixels
+			if (edges.getEdgeSize(edgeId) > 1)
 			{
 				// Iterate through the start and end point of current (reference) edge
 				for (int i = 0; i <= 1; ++i)
@@ -892,10 +1515,10 @@ void EdgeProcessor::bridgeEdgeGaps(size_t numberPixels, double thresholdAngle, i
 					}
 
 					cv::Point referencePoint = (i == 0) ? edges.getStartPoint(edgeId) : edges.getEndPoint(edgeId);
-					double referenceAngle = getEdgeAngleWithLSM(edges.getPointsAlongEdgeFromPoint(edgeId, referencePoint, numberPixels));
+					double referenceAngle = getEdgeEndAngle(edgeId, referencePoint, numberPixels);
 
 					// Get all candidate edgeIds and their connectionPoints
-					std::vector<std::pair<int, cv::Point>> edgesInSearchArea = getEdgesInSearchArea(referencePoint, blockDistance, thresholdAngle, referenceAngle);
+					std::vector<std::pair<int, cv::Point>> edgesInSearchArea = getEdgesInSearchArea(endpoints, referencePoint, blockDistance, thresholdAngle, referenceAngle);
 
 					double smallestCosts = std::numeric_limits<double>::max();
 					int indexForMerge = -1;
@@ -912,22 +1535,15 @@ void EdgeProcessor::bridgeEdgeGaps(size_t numberPixels, double thresholdAngle, i
 							continue;
 						}
 
-						cv::Point candidateConnectionPoint = edgeIdAndConnectionPoint.second;
+						double currentAngleDiff = 0.0;
+						double currentCosts = getBridgeCosts(referencePoint, referenceAngle, candidateEdgeId, edgeIdAndConnectionPoint.second,
+															 numberPixels, alpha, beta, currentAngleDiff);
 
-						// Calculate the difference between the angles of the two edges
-						double neighborAngle = getEdgeAngleWithLSM(edges.getPointsAlongEdgeFromPoint(candidateEdgeId, candidateConnectionPoint, numberPixels));
-						double currentAngleDiff = std::abs(referenceAngle - neighborAngle);
-						currentAngleDiff = std::abs(currentAngleDiff - 180.0); // Best match is at 180 (edges point towards each other)
-
-						if (edges.getEdge(candidateEdgeId).size() == 1)
+						if (statistics)
 						{
-							double neighborPointAngle = getAngleBetweenPoints(referencePoint, candidateConnectionPoint);
-							currentAngleDiff = std::abs(referenceAngle - neighborPointAngle);
+							statistics->bridgeCandidates.evaluated++;
 						}
 
-						double distance = std::sqrt((referencePoint.x-candidateConnectionPoint.x)*(referencePoint.x-candidateConnectionPoint.x) + (referencePoint.y-candidateConnectionPoint.y)*(referencePoint.y-candidateConnectionPoint.y));
-						double currentCosts = alpha*currentAngleDiff + beta*distance;
-
 						if ((currentAngleDiff < thresholdAngle) && (currentCosts < smallestCosts))
 						{
 							smallestCosts = currentCosts;
@@ -942,17 +1558,30 @@ void EdgeProcessor::bridgeEdgeGaps(size_t numberPixels, double thresholdAngle, i
 					// Merge edge with the best found candidate edge if one was found
 					if (changes)
 					{
+						if (statistics)
+						{
+							statistics->bridgeCandidates.accepted++;
+						}
+
 						std::pair<int, cv::Point> edgeIdAndConnectionPoint = edgesInSearchArea[indexForMerge];
 
 						// Create a temporal edge which bridges the two points
 						std::vector<cv::Point> tmpEdge = getLinePoints(referencePoint, edgeIdAndConnectionPoint.second);
-						edges.pushBack(tmpEdge);
-						int tmpEdgeId = edges.size()-1;
+						int tmpEdgeId = addConnectingEdge(tmpEdge);
 
 						// First merge one edge with the temporal edge and then with the other edge
 						mergeEdges(edgeId, tmpEdgeId);
 						mergeEdges(edgeId, edgeIdAndConnectionPoint.first);
 
+						// The two connected points are inside the merged edge now (unless they also end another edge)
+						for (cv::Point connectedPoint : {referencePoint, edgeIdAndConnectionPoint.second})
+						{
+							if (!isEdgeEndpoint(connectedPoint))
+							{
+								endpoints.remove(connectedPoint);
+							}
+						}
+
 						// Single pixel edges have been skipped before, as they do not provide a referenceAngle.
 						// Later, they can be merged, but can have a smaller edgeId than the current edgeId, so that the merging result gets the smaller edgeId.
 						// In that case, the merged edge can not be processed further, therefore set back the edgeId of the for-loop.
@@ -965,146 +1594,322 @@ void EdgeProcessor::bridgeEdgeGaps(size_t numberPixels, double thresholdAngle, i
 			}
 		}
 	}
+
+	// Merged edges are joined lazily, store them as one edge each
+	edges.flattenJoinedEdges();
 }
 
-void EdgeProcessor::connectEdgesInTwoEdgeClusters(bool onlyIf8Neighbors, bool deleteClustersAfterConnect)
+double EdgeProcessor::getBridgeCosts(cv::Point referencePoint, double referenceAngle, int candidateEdgeId, cv::Point candidatePoint,
+									 size_t numberPixels, double alpha, double beta, double &angleDiff)
+{
+	// Calculate the difference between the angles of the two edges
+	double neighborAngle = getEdgeEndAngle(candidateEdgeId, candidatePoint, numberPixels);
+	angleDiff = std::abs(referenceAngle - neighborAngle);
+	angleDiff = std::abs(angleDiff - 180.0); // Best match is at 180 (edges point towards each other)
+
+	if (edges.getEdgeSize(candidateEdgeId) == 1)
+	{
+		double neighborPointAngle = getAngleBetweenPoints(referencePoint, candidatePoint);
+		angleDiff = std::abs(referenceAngle - neighborPointAngle);
+	}
+
+	double distance = std::sqrt((referencePoint.x-candidatePoint.x)*(referencePoint.x-candidatePoint.x) + (referencePoint.y-candidatePoint.y)*(referencePoint.y-candidatePoint.y));
+	return alpha*angleDiff + beta*distance;
+}
+
+bool EdgeProcessor::BridgeCandidate::operator>(const BridgeCandidate &other) const
+{
+	return std::make_tuple(costs, referencePoint.y, referencePoint.x, candidatePoint.y, candidatePoint.x, referenceEdgeId, candidateEdgeId) >
+		   std::make_tuple(other.costs, other.referencePoint.y, other.referencePoint.x, other.candidatePoint.y, other.candidatePoint.x,
+						   other.referenceEdgeId, other.candidateEdgeId);
+}
+
+void EdgeProcessor::bridgeEdgeGapsGlobal(EndpointIndex &endpoints, size_t numberPixels, double thresholdAngle, int blockDistance, double alpha, double beta)
 {
-	// Find all cluster points and check which edgeIds are in that cluster
-	for (int y = 0; y < edgeMap.getRows(); y++)
+	std::priority_queue<BridgeCandidate, std::vector<BridgeCandidate>, std::greater<BridgeCandidate>> queue;
+
+	// Incremented with each merge of an edge, entries with an older version are stale
+	std::vector<uint32_t> versions(edges.size(), 0);
+
+	// Scores the candidates of one end of the reference edge (all, or only those of onlyCandidateEdgeId if it is not -1)
+	// and queues those below the threshold angle
+	auto queueCandidates = [&](int edgeId, cv::Point referencePoint, int onlyCandidateEdgeId)
+	{
+		// Do not start from isolated pixels (they do not provide a referenceAngle)
+		if (edges.getEdgeSize(edgeId) <= 1 || edges.isClosed(edgeId))
+		{
+			return;
+		}
+
+		double referenceAngle = getEdgeEndAngle(edgeId, referencePoint, numberPixels);
+
+		for (const auto& edgeIdAndConnectionPoint : getEdgesInSearchArea(endpoints, referencePoint, blockDistance, thresholdAngle, referenceAngle))
+		{
+			int candidateEdgeId = edgeIdAndConnectionPoint.first;
+
+			if ((onlyCandidateEdgeId != -1 && candidateEdgeId != onlyCandidateEdgeId) || edges.isClosed(candidateEdgeId))
+			{
+				continue;
+			}
+
+			double angleDiff = 0.0;
+			double costs = getBridgeCosts(referencePoint, referenceAngle, candidateEdgeId, edgeIdAndConnectionPoint.second,
+										  numberPixels, alpha, beta, angleDiff);
+
+			if (statistics)
+			{
+				statistics->bridgeCandidates.evaluated++;
+			}
+
+			if (angleDiff < thresholdAngle)
+			{
+				queue.push({costs, referencePoint, edgeIdAndConnectionPoint.second, edgeId, candidateEdgeId,
+							versions[edgeId], versions[candidateEdgeId]});
+			}
+		}
+	};
+
+	for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+	{
+		if (edges.getEdgeSize(edgeId) > 1)
+		{
+			queueCandidates(edgeId, edges.getStartPoint(edgeId), -1);
+			queueCandidates(edgeId, edges.getEndPoint(edgeId), -1);
+		}
+	}
+
+	std::vector<cv::Point> nearbyEndpoints;
+	std::vector<cv::Point> otherEndpoints;
+
+	while (!queue.empty())
 	{
-		for (int x = 0; x < edgeMap.getCols(); x++)
+		BridgeCandidate bridge = queue.top();
+		queue.pop();
+
+		// Lazy invalidation: skip pairs with an edge that was merged after they were scored
+		if (versions[bridge.referenceEdgeId] != bridge.referenceVersion || versions[bridge.candidateEdgeId] != bridge.candidateVersion)
+		{
+			continue;
+		}
+
+		// A bridge added after the pair was scored can cover the candidate point (getEdgesInSearchArea would no longer find it)
+		if (edgeMap.getNumberOfEdgeIds(bridge.candidatePoint.x, bridge.candidatePoint.y) != 1)
 		{
-			std::vector<int> clusterEdgeIds = edgeMap.getClusterEdgeIds(x, y);
+			continue;
+		}
+
+		if (statistics)
+		{
+			statistics->bridgeCandidates.accepted++;
+		}
+
+		// Create a temporal edge which bridges the two points
+		std::vector<cv::Point> tmpEdge = getLinePoints(bridge.referencePoint, bridge.candidatePoint);
+		int tmpEdgeId = addConnectingEdge(tmpEdge);
+		versions.resize(edges.size(), 0);
+
+		// First merge one edge with the temporal edge and then with the other edge
+		mergeEdges(bridge.referenceEdgeId, tmpEdgeId);
+
+		// If it is the same edge, the bridge closes it with the first merge
+		if (bridge.candidateEdgeId != bridge.referenceEdgeId)
+		{
+			mergeEdges(bridge.referenceEdgeId, bridge.candidateEdgeId);
+		}
+
+		versions[bridge.referenceEdgeId]++;
+		versions[bridge.candidateEdgeId]++;
 
-			// Restrict processing to clusters of at least two points.
-			// It can not be the same edge, as we have two different edgeIds.
-			// A single branch on a closed contour also leads to a cluster with two edgeIds.
-			// Since the contour is already closed, meaningful merging is not possible (therefore exclude closed contours).
-			if (clusterEdgeIds.size() == 2 && edgeMap.isCluster(x, y) && !edges.isClosed(clusterEdgeIds[0]) && !edges.isClosed(clusterEdgeIds[1]))
+		// The two connected points are inside the merged edge now (unless they also end another edge)
+		for (cv::Point connectedPoint : {bridge.referencePoint, bridge.candidatePoint})
+		{
+			if (!isEdgeEndpoint(connectedPoint))
 			{
-				cv::Point connectionPoint1;
-				cv::Point connectionPoint2;
+				endpoints.remove(connectedPoint);
+			}
+		}
+
+		// Score the ends of the merged edge and the ends of other edges which may have had it as candidate.
+		// mergeEdges keeps the smaller edgeId, which is the candidate edge if it has the smaller one.
+		int mergedEdgeId = std::min(bridge.referenceEdgeId, bridge.candidateEdgeId);
+
+		if (edges.getEdgeSize(mergedEdgeId) <= 1 || edges.isClosed(mergedEdgeId))
+		{
+			continue;
+		}
+
+		// Pairs of other edges are still queued with valid versions, only pairs with the merged edge are scored again
+		otherEndpoints.clear();
+
+		for (cv::Point mergedEndPoint : {edges.getStartPoint(mergedEdgeId), edges.getEndPoint(mergedEdgeId)})
+		{
+			queueCandidates(mergedEdgeId, mergedEndPoint, -1);
+			endpoints.query(mergedEndPoint, blockDistance, nearbyEndpoints);
+			otherEndpoints.insert(otherEndpoints.end(), nearbyEndpoints.begin(), nearbyEndpoints.end());
+		}
 
-				bool connectionPoint1Found = findStartOrEndPointInCluster(x, y, clusterEdgeIds[0], connectionPoint1);
-				bool connectionPoint2Found = findStartOrEndPointInCluster(x, y, clusterEdgeIds[1], connectionPoint2);
+		// Endpoints near both ends are scored once
+		auto rasterOrder = [](const cv::Point &a, const cv::Point &b) { return std::make_pair(a.y, a.x) < std::make_pair(b.y, b.x); };
+		std::sort(otherEndpoints.begin(), otherEndpoints.end(), rasterOrder);
+		otherEndpoints.erase(std::unique(otherEndpoints.begin(), otherEndpoints.end()), otherEndpoints.end());
 
-				if (connectionPoint1Found && connectionPoint2Found)
+		for (const cv::Point &nearbyEndpoint : otherEndpoints)
+		{
+			for (int edgeId : edgeMap.getEdgeIds(nearbyEndpoint.x, nearbyEndpoint.y))
+			{
+				if (edgeId != mergedEdgeId && edges.getEdgeSize(edgeId) > 0 &&
+					(nearbyEndpoint == edges.getStartPoint(edgeId) || nearbyEndpoint == edges.getEndPoint(edgeId)))
 				{
-					bool are8Neighbors = (cv::norm(connectionPoint1 - connectionPoint2) < 1.5); // 1.5 replaces sqrt(2), as next closest distance would be 2
-					if (onlyIf8Neighbors && are8Neighbors)
-					{
-						// Create a temporal edge which bridges the two points
-						std::vector<cv::Point> tmpEdge = {connectionPoint1, connectionPoint2};
-						edges.pushBack(tmpEdge);
-						int tmpEdgeId = edges.size()-1;
+					queueCandidates(edgeId, nearbyEndpoint, mergedEdgeId);
+				}
+			}
+		}
+	}
+}
 
-						// First merge one edge with the temporal edge and then with the other edge
-						mergeEdges(clusterEdgeIds[0], tmpEdgeId);
-						mergeEdges(clusterEdgeIds[0], clusterEdgeIds[1]);
+void EdgeProcessor::connectEdgesInTwoEdgeClusters(bool onlyIf8Neighbors, bool deleteClustersAfterConnect)
+{
+	PhaseTimer timer(statistics, "connectEdgesInTwoEdgeClusters", edges);
+	previousFrame.release();
 
-						if (deleteClustersAfterConnect)
-						{
-							edgeMap.clearCluster(x, y);
-						}
-					}
-					//
-					else if (!onlyIf8Neighbors)
-					{
-						// Create a temporal edge which bridges the two points
-						std::vector<cv::Point> tmpEdge = getLinePoints(connectionPoint1, connectionPoint2);
-						edges.pushBack(tmpEdge);
-						int tmpEdgeId = edges.size()-1;
+	// Visit each cluster once and check which edgeIds are in that cluster
+	forEachCluster([&](const ClusterView &cluster)
+	{
+		int x = cluster.position.x;
+		int y = cluster.position.y;
 
-						// First merge one edge with the temporal edge and then with the other edge
-						mergeEdges(clusterEdgeIds[0], tmpEdgeId);
-						mergeEdges(clusterEdgeIds[0], clusterEdgeIds[1]);
+		const std::vector<int> &clusterEdgeIds = cluster.edgeIds;
 
-						if (deleteClustersAfterConnect)
-						{
-							edgeMap.clearCluster(x, y);
-						}
+		// Restrict processing to clusters of at least two points.
+		// It can not be the same edge, as we have two different edgeIds.
+		// A single branch on a closed contour also leads to a cluster with two edgeIds.
+		// Since the contour is already closed, meaningful merging is not possible (therefore exclude closed contours).
+		if (clusterEdgeIds.size() == 2 && !edges.isClosed(clusterEdgeIds[0]) && !edges.isClosed(clusterEdgeIds[1]))
+		{
+			cv::Point connectionPoint1;
+			cv::Point connectionPoint2;
+
+			bool connectionPoint1Found = findStartOrEndPointInCluster(x, y, clusterEdgeIds[0], connectionPoint1);
+			bool connectionPoint2Found = findStartOrEndPointInCluster(x, y, clusterEdgeIds[1], connectionPoint2);
+
+			if (connectionPoint1Found && connectionPoint2Found)
+			{
+				bool are8Neighbors = (cv::norm(connectionPoint1 - connectionPoint2) < 1.5); // 1.5 replaces sqrt(2), as next closest distance would be 2
+				if (onlyIf8Neighbors && are8Neighbors)
+				{
+					// Create a temporal edge which bridges the two points
+					std::vector<cv::Point> tmpEdge = {connectionPoint1, connectionPoint2};
+					int tmpEdgeId = addConnectingEdge(tmpEdge);
+
+					// First merge one edge with the temporal edge and then with the other edge
+					mergeEdges(clusterEdgeIds[0], tmpEdgeId);
+					mergeEdges(clusterEdgeIds[0], clusterEdgeIds[1]);
+
+					if (deleteClustersAfterConnect)
+					{
+						edgeMap.clearCluster(x, y);
 					}
+				}
+				//
+				else if (!onlyIf8Neighbors)
+				{
+					// Create a temporal edge which bridges the two points
+					std::vector<cv::Point> tmpEdge = getLinePoints(connectionPoint1, connectionPoint2);
+					int tmpEdgeId = addConnectingEdge(tmpEdge);
 
-					// Removing one of two (remaining) branches from an edge can lead to a closed contour after merging,
-					// where the start or end point is not in the remaining cluster. This can be corrected.
-					int edgeIdMerged = std::min(clusterEdgeIds[0], clusterEdgeIds[0]); // edgeId if the two edges have been merged
-					if (edges.isClosed(edgeIdMerged))
+					// First merge one edge with the temporal edge and then with the other edge
+					mergeEdges(clusterEdgeIds[0], tmpEdgeId);
+					mergeEdges(clusterEdgeIds[0], clusterEdgeIds[1]);
+
+					if (deleteClustersAfterConnect)
 					{
-						cv::Point startPoint = edges.getStartPoint(edgeIdMerged);
-						cv::Point endPoint = edges.getEndPoint(edgeIdMerged);
+						edgeMap.clearCluster(x, y);
+					}
+				}
+
+				// Removing one of two (remaining) branches from an edge can lead to a closed contour after merging,
+				// where the start or end point is not in the remaining cluster. This can be corrected.
+				int edgeIdMerged = std::min(clusterEdgeIds[0], clusterEdgeIds[0]); // edgeId if the two edges have been merged
+				if (edges.isClosed(edgeIdMerged))
+				{
+					cv::Point startPoint = edges.getStartPoint(edgeIdMerged);
+					cv::Point endPoint = edges.getEndPoint(edgeIdMerged);
 
-						if (!edgeMap.isCluster(startPoint.x, startPoint.y) && !edgeMap.isCluster(endPoint.x, endPoint.y))
+					if (!edgeMap.isCluster(startPoint.x, startPoint.y) && !edgeMap.isCluster(endPoint.x, endPoint.y))
+					{
+						// Rearrange vector so that the start point is in the cluster
+						// (not necessarily required, but helpful for consistency and further processing)
+						std::vector<cv::Point> edge = edges.getEdge(edgeIdMerged);
+						for (auto it = edge.begin(); it != edge.end(); ++it)
 						{
-							// Rearrange vector so that the start point is in the cluster
-							// (not necessarily required, but helpful for consistency and further processing)
-							std::vector<cv::Point> edge = edges.getEdge(edgeIdMerged);
-							for (auto it = edge.begin(); it != edge.end(); ++it)
-							{
-							    if (edgeMap.isCluster(it->x, it->y))
-							    {
-							    	// Rotate the vector so that the current element comes to the beginning
-							    	std::rotate(edge.begin(), it, edge.end());
-							        edges.overwrite(edgeIdMerged, edge);
-							        break;
-							    }
-							}
+						    if (edgeMap.isCluster(it->x, it->y))
+						    {
+						    	// Rotate the vector so that the current element comes to the beginning
+						    	std::rotate(edge.begin(), it, edge.end());
+						        edges.overwrite(edgeIdMerged, edge);
+						        invalidateEdgeCaches(edgeIdMerged);
+						        break;
+						    }
 						}
 					}
 				}
 			}
 		}
-	}
+	});
+
+	// Merged edges are joined lazily, store them as one edge each
+	edges.flattenJoinedEdges();
 }
 
 void EdgeProcessor::removeZeroAndOneEdgeClusters()
 {
-	for (int y = 0; y < edgeMap.getRows(); y++)
+	PhaseTimer timer(statistics, "removeZeroAndOneEdgeClusters", edges);
+	previousFrame.release();
+
+	forEachCluster([&](const ClusterView &cluster)
 	{
-		for (int x = 0; x < edgeMap.getCols(); x++)
+		if (cluster.edgeIds.size() <= 1)
 		{
-			if (edgeMap.isCluster(x, y) && (edgeMap.getClusterEdgeIds(x, y).size() <= 1))
-			{
-				edgeMap.clearCluster(x, y);
-			}
+			edgeMap.clearCluster(cluster.position.x, cluster.position.y);
 		}
-	}
+	});
 }
 
 void EdgeProcessor::reverseAllEdges()
 {
+	PhaseTimer timer(statistics, "reverseAllEdges", edges);
+	previousFrame.release();
+
 	edges.reverseAll();
+	clearEdgeCaches(); // Start and end are swapped, closed edges are traversed the other way round
 }
 
-std::vector<std::pair<int, cv::Point>> EdgeProcessor::getEdgesInSearchArea(cv::Point p, int blockDistance, double thresholdAngle, double referenceAngle)
+std::vector<std::pair<int, cv::Point>> EdgeProcessor::getEdgesInSearchArea(const EndpointIndex &endpoints, cv::Point p, int blockDistance, double thresholdAngle, double referenceAngle)
 {
 	std::vector<std::pair<int, cv::Point>> edgesInSearchArea; // Saves all found edgeIds and their connection point
 
-	for (int dy = -blockDistance; dy <= blockDistance; ++dy)
+	// Only endpoints can be connection points, so the other pixels of the search area need not be checked
+	std::vector<cv::Point> nearbyEndpoints;
+	endpoints.query(p, blockDistance, nearbyEndpoints);
+
+	for (const cv::Point &neighbor : nearbyEndpoints)
 	{
-		for (int dx = -blockDistance; dx <= blockDistance; ++dx)
+		// Check if the neighbor is inside the search area (based on angle)
+		double neighborPointAngle = getAngleBetweenPoints(p, neighbor);
+		if (std::abs(referenceAngle - neighborPointAngle) >= thresholdAngle)
 		{
-			cv::Point neighbor(p.x + dx, p.y + dy);
-
-			// Check if the neighbor is inside the search area (based on angle)
-			double neighborPointAngle = getAngleBetweenPoints(p, neighbor);
-			if (std::abs(referenceAngle - neighborPointAngle) >= thresholdAngle)
-			{
-				continue;
-			}
+			continue;
+		}
 
-			// Exclude pixels outside the image
-			bool isNeighborInsideImage = (neighbor.x >= 0 && neighbor.y >= 0 && neighbor.x < edgeMap.getCols() && neighbor.y < edgeMap.getRows());
+		// Check if neighbor contains an edge, do not connect to clusters
+		if (edgeMap.getNumberOfEdgeIds(neighbor.x, neighbor.y) == 1 && !(edgeMap.isCluster(neighbor.x, neighbor.y)))
+		{
+			int neighborEdgeId = edgeMap.getEdgeIds(neighbor.x, neighbor.y).front(); // Contains only one element
 
-			// Check if neighbor contains an edge, do not connect to clusters
-			if (isNeighborInsideImage && edgeMap.getNumberOfEdgeIds(neighbor.x, neighbor.y) == 1 && !(edgeMap.isCluster(neighbor.x, neighbor.y)))
+			// Do not connect to edge itself, make sure that connection point is start or end point
+			if ((neighbor == edges.getStartPoint(neighborEdgeId) || neighbor == edges.getEndPoint(neighborEdgeId)))
 			{
-				int neighborEdgeId = edgeMap.getEdgeIds(neighbor.x, neighbor.y).front(); // Contains only one element
-
-				// Do not connect to edge itself, make sure that connection point is start or end point
-				if ((neighbor == edges.getStartPoint(neighborEdgeId) || neighbor == edges.getEndPoint(neighborEdgeId)))
-				{
-					edgesInSearchArea.push_back(std::make_pair(neighborEdgeId, neighbor));
-				}
+				edgesInSearchArea.push_back(std::make_pair(neighborEdgeId, neighbor));
 			}
 		}
 	}
@@ -1112,7 +1917,20 @@ std::vector<std::pair<int, cv::Point>> EdgeProcessor::getEdgesInSearchArea(cv::P
 	return edgesInSearchArea;
 }
 
-double EdgeProcessor::getLSMError(std::vector<cv::Point> points, double& a, double& b)
+bool EdgeProcessor::isEdgeEndpoint(cv::Point p)
+{
+	for (int edgeId : edgeMap.getEdgeIds(p.x, p.y))
+	{
+		if (edges.getEdgeSize(edgeId) > 0 && (p == edges.getStartPoint(edgeId) || p == edges.getEndPoint(edgeId)))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+double EdgeProcessor::getLSMError(const std::vector<cv::Point> &points, double& a, double& b)
 {
 	double x_average = 0.0;
 	double y_average = 0.0;
@@ -1152,6 +1970,217 @@ double EdgeProcessor::getLSMError(std::vector<cv::Point> points, double& a, doub
 	return approximationError;
 }
 
+double EdgeProcessor::getLSMError(const Moments &sums, size_t numberPoints, cv::Point front, double& a, double& b)
+{
+	// The sums of integer coordinates are exact in double, so the line is the same as with the points
+	double x_average = static_cast<double>(sums.x) / numberPoints;
+	double y_average = static_cast<double>(sums.y) / numberPoints;
+	double x_squared_average = static_cast<double>(sums.xx) / numberPoints;
+	double xy_average = static_cast<double>(sums.xy) / numberPoints;
+
+	if (std::abs(x_squared_average - (x_average*x_average)) < 1e-9)
+	{
+		return std::numeric_limits<double>::max();
+	}
+
+	a = (xy_average-x_average*y_average) / (x_squared_average-x_average*x_average);
+	b = front.y - a * front.x; // Compute b relative to connection point
+
+	// With coordinates relative to the connection point, the error is sum((a*x - y)^2), whose sums are exact integers
+	int64_t n = static_cast<int64_t>(numberPoints);
+	int64_t x0 = front.x;
+	int64_t y0 = front.y;
+	int64_t xx = sums.xx - 2 * x0 * sums.x + n * x0 * x0;
+	int64_t xy = sums.xy - x0 * sums.y - y0 * sums.x + n * x0 * y0;
+	int64_t yy = sums.yy - 2 * y0 * sums.y + n * y0 * y0;
+
+	return std::max(0.0, a * a * xx - 2.0 * a * xy + yy);
+}
+
+double EdgeProcessor::getEdgeEndAngle(int edgeId, cv::Point point, size_t numberPixels)
+{
+	bool isStart = (point == edges.getStartPoint(edgeId));
+
+	if (!isStart && point != edges.getEndPoint(edgeId))
+	{
+		return getEdgeAngleWithLSM(edges.getPointsAlongEdgeFromPoint(edgeId, point, numberPixels));
+	}
+
+	if (static_cast<size_t>(edgeId) >= edgeEndAngles.size())
+	{
+		reserveEdgeCaches();
+	}
+
+	EdgeEndAngle &cached = edgeEndAngles[edgeId][isStart ? 0 : 1];
+
+	if (!cached.valid || cached.point != point || cached.numberPixels != numberPixels)
+	{
+		cached.valid = true;
+		cached.point = point;
+		cached.numberPixels = numberPixels;
+		cached.angle = useEdgeMoments ? getEdgeAngleWithMoments(edgeId, !isStart, numberPixels)
+									  : getEdgeAngleWithLSM(edges.getPointsAlongEdgeFromPoint(edgeId, point, numberPixels));
+	}
+
+	return cached.angle;
+}
+
+void EdgeProcessor::reserveEdgeCaches()
+{
+	if (edgeEndAngles.size() < edges.size())
+	{
+		edgeEndAngles.resize(edges.size());
+	}
+
+	if (useEdgeMoments && edgeMoments.size() < edges.size())
+	{
+		edgeMoments.resize(edges.size());
+	}
+}
+
+void EdgeProcessor::invalidateEdgeCaches(int edgeId)
+{
+	if (static_cast<size_t>(edgeId) < edgeEndAngles.size())
+	{
+		edgeEndAngles[edgeId] = std::array<EdgeEndAngle, 2>();
+	}
+
+	if (static_cast<size_t>(edgeId) < edgeMoments.size())
+	{
+		std::vector<Moments>().swap(edgeMoments[edgeId]); // Release the memory
+	}
+}
+
+void EdgeProcessor::clearEdgeCaches()
+{
+	edgeEndAngles.clear();
+	edgeMoments.clear();
+}
+
+void EdgeProcessor::remapEdgeCaches(const std::vector<int> &newEdgeIds)
+{
+	// New edgeIds are never larger than the previous ones, so the entries can be moved forward in place
+	for (size_t edgeId = 0; edgeId < newEdgeIds.size(); edgeId++)
+	{
+		int newEdgeId = newEdgeIds[edgeId];
+
+		if (newEdgeId < 0 || newEdgeId == static_cast<int>(edgeId))
+		{
+			continue;
+		}
+
+		// Edges without cache entry must not keep the entry of the edge which had their new edgeId
+		if (static_cast<size_t>(newEdgeId) < edgeEndAngles.size())
+		{
+			edgeEndAngles[newEdgeId] = (edgeId < edgeEndAngles.size()) ? edgeEndAngles[edgeId] : std::array<EdgeEndAngle, 2>();
+		}
+
+		if (static_cast<size_t>(newEdgeId) < edgeMoments.size())
+		{
+			edgeMoments[newEdgeId] = (edgeId < edgeMoments.size()) ? std::move(edgeMoments[edgeId]) : std::vector<Moments>();
+		}
+	}
+
+	edgeEndAngles.resize(std::min(edgeEndAngles.size(), edges.size()));
+	edgeMoments.resize(std::min(edgeMoments.size(), edges.size()));
+}
+
+const std::vector<EdgeProcessor::Moments> &EdgeProcessor::getEdgeMoments(int edgeId)
+{
+	if (static_cast<size_t>(edgeId) >= edgeMoments.size())
+	{
+		reserveEdgeCaches();
+	}
+
+	std::vector<Moments> &moments = edgeMoments[edgeId];
+
+	if (moments.empty())
+	{
+		std::vector<cv::Point> edge = edges.getEdge(edgeId);
+		moments.resize(edge.size() + 1);
+
+		for (size_t i = 0; i < edge.size(); i++)
+		{
+			int64_t x = edge[i].x;
+			int64_t y = edge[i].y;
+
+			moments[i + 1].x = moments[i].x + x;
+			moments[i + 1].y = moments[i].y + y;
+			moments[i + 1].xx = moments[i].xx + x * x;
+			moments[i + 1].xy = moments[i].xy + x * y;
+			moments[i + 1].yy = moments[i].yy + y * y;
+		}
+	}
+
+	return moments;
+}
+
+double EdgeProcessor::getEdgeAngleWithMoments(int edgeId, bool fromBack, size_t numberPixels)
+{
+	const std::vector<Moments> &moments = getEdgeMoments(edgeId);
+	size_t size = moments.size() - 1;
+	size_t n = std::min(numberPixels, size);
+
+	if (n == 0)
+	{
+		return 0.0; // No points, no direction
+	}
+
+	// The n points from the start are [0, n), the n points from the end are [size - n, size) (in reverse order)
+	size_t first = fromBack ? size - n : 0;
+
+	Moments sums;
+	sums.x = moments[first + n].x - moments[first].x;
+	sums.y = moments[first + n].y - moments[first].y;
+	sums.xx = moments[first + n].xx - moments[first].xx;
+	sums.xy = moments[first + n].xy - moments[first].xy;
+	sums.yy = moments[first + n].yy - moments[first].yy;
+
+	auto pointAt = [&](size_t i)
+	{
+		return cv::Point(static_cast<int>(moments[i + 1].x - moments[i].x), static_cast<int>(moments[i + 1].y - moments[i].y));
+	};
+
+	cv::Point front = fromBack ? pointAt(size - 1) : pointAt(0);
+	cv::Point back = fromBack ? pointAt(size - n) : pointAt(n - 1);
+
+	// Same steps as getEdgeAngleWithLSM
+	double a = 0.0;
+	double b = 0.0;
+
+	double error = getLSMError(sums, n, front, a, b);
+
+	double dx = front.x - back.x;
+	double dy = (a * front.x + b) - (a * back.x + b);
+	double angle = atan2(dx, dy);
+
+	// Swap x and y to check if it gives a better fit
+	Moments swappedSums;
+	swappedSums.x = sums.y;
+	swappedSums.y = sums.x;
+	swappedSums.xx = sums.yy;
+	swappedSums.xy = sums.xy;
+	swappedSums.yy = sums.xx;
+
+	double newError = getLSMError(swappedSums, n, cv::Point(front.y, front.x), a, b);
+	if (newError < error)
+	{
+		dx = front.y - back.y;
+		dy = (a * front.y + b) - (a * back.y + b);
+		angle = atan2(dy, dx);
+	}
+
+	// Normalize angle from [-180, 180] to [0, 360] degrees
+	angle = angle * (180 / M_PI);
+
+	if (angle < 0)
+	{
+	    angle += 360.0;
+	}
+
+	return angle;
+}
+
 double EdgeProcessor::getEdgeAngleWithLSM(std::vector<cv::Point> points)
 {
 	double a = 0.0;
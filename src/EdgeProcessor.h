@@ -1,6 +1,8 @@
 #ifndef EDGEPROCESSOR_H_
 #define EDGEPROCESSOR_H_
 
+#include <array>
+#include <functional>
 #include <vector>
 #include <utility>
 
@@ -8,9 +10,14 @@
 
 #include "EdgeMap.h"
 #include "Edges.h"
+#include "EndpointIndex.h"
+
+struct TracingStatistics;
 
 class EdgeProcessor
 {
+	friend class TracingBenchmark; // Times the private stages (bench/tracing_bench.cpp)
+
 public:
 	/** Constructor
 	 */
@@ -22,6 +29,59 @@ public:
 	 */
 	void traceEdges(cv::Mat &img);
 
+	/**
+	 * Traces the next frame of an image sequence (e.g. a video) based on the result of the previous frame. The frame is
+	 * compared with the previous one in tiles of setTileSize, only the edges and clusters near changed tiles are removed
+	 * and traced again. The edges are the same as with traceEdges, but edges which did not change keep their edgeIds;
+	 * new edges get the edgeIds of removed edges (ascending) or are appended. The first frame, frames of another size,
+	 * frames in which most tiles changed and frames after postprocessing or traceEdges are traced from scratch.
+	 * @img 			Input Image (next frame).
+	 */
+	void traceNextFrame(cv::Mat &img);
+
+	/** Select the data structure of the edgeIdMap used by the next call of traceEdges (default: EdgeMap::Backend::Automatic,
+	 *  which uses the sparse backend for images with less than 3% edge pixels and the dense backend otherwise).
+	 */
+	void setEdgeMapBackend(EdgeMap::Backend backend);
+
+	/** Select the data structure of the edges used by the next call of traceEdges (default: Edges::Storage::Points).
+	 *  Edges::Storage::ChainCode needs much less memory for long edges, but each change of an edge re-encodes it.
+	 *  Edges::Storage::Pool keeps all points in two coordinate arrays, so passes over all edges read memory linearly.
+	 */
+	void setEdgeStorage(Edges::Storage storage);
+
+	/** Number of threads used by traceEdges and connectEdgesInClusters (default: 1). With more than one thread, the image is
+	 *  split into tiles which are processed in parallel, and clusters which share no edges are evaluated in parallel.
+	 *  The result (edges, edgeIds and clusters) is identical to the result with one thread.
+	 *  @numberOfThreads	Number of threads, 0 = number of hardware threads.
+	 */
+	void setNumberOfThreads(int numberOfThreads);
+
+	/** Side length of the square tiles used for parallel cluster labeling and tracing (default: 256).
+	 */
+	void setTileSize(int tileSize);
+
+	/** Attach statistics which record the wall time of each phase (preprocessing, tracing, each postprocessing and cleanup
+	 *  call) and counters such as merges and connection candidates (default: nullptr = no statistics). The statistics are
+	 *  reset by traceEdges and must outlive their use by this EdgeProcessor.
+	 */
+	void setStatistics(TracingStatistics *statistics);
+
+	/** Compute the line-fit angles at the edge ends (connectEdgesInClusters, bridgeEdgeGaps) from cumulative moments of the
+	 *  edge points instead of the points themselves (default: false). The moments of an edge are computed once after
+	 *  each change of the edge, then the angle for any numberPixels costs the same, which helps when numberPixels is
+	 *  large or varied. Needs 40 bytes per point of the evaluated edges. The angles can differ from the default in
+	 *  the last bits, which can change the choice between the two line fits in rare near-ties.
+	 */
+	void setEdgeMoments(bool useEdgeMoments);
+
+	/** Order in which bridgeEdgeGaps connects edges (default: false = greedily in the order of the edgeIds). With true,
+	 *  the pairs of endpoints of all edges are scored in one sweep and connected in the order of increasing costs from
+	 *  a priority queue. Each pair is scored once (again only near the ends of merged edges), and the chosen bridges do
+	 *  not depend on the numbering of the edges.
+	 */
+	void setGlobalGapBridging(bool useGlobalGapBridging);
+
 	/* Print information about the input image and traced edges.
 	 */
 	void printEdgeInfos(cv::Mat &img);
@@ -34,7 +94,8 @@ public:
 	 */
 	const Edges &getEdges() const;
 
-	/** Erase all empty edges from edge vector and update edgeIdMap appropriately.
+	/** Erase all empty edges from edge vector and update edgeIdMap appropriately. The edgeIdMap is rewritten from
+	 *  scratch, which also removes the edgeId redirections of merged edges.
 	 */
 	void cleanUpEdges();
 
@@ -118,48 +179,243 @@ private:
 
 	EdgeMap edgeMap; 	//!< Represents the edgeIdMap and ambiguityMap (see class EdgeMap for details).
 
+	EdgeMap::Backend edgeMapBackend;	//!< Data structure of the edgeIdMap used by traceEdges.
+
+	Edges::Storage edgeStorage;			//!< Data structure of the edges used by traceEdges.
+
+	int numberOfThreads;	//!< Number of threads used by traceEdges and connectEdgesInClusters (0 = number of hardware threads).
+
+	int tileSize;			//!< Side length of the tiles used for parallel cluster labeling and tracing.
+
+	cv::Mat binaryCodes;	//!< Binary code of the neighborhood of each pixel (see Neighborhood.h).
+
+	cv::Mat ambiguityMask;	//!< Marks edge pixels which are cluster points (255), traceEdge marks traced non-cluster pixels (1).
+
+	TracingStatistics *statistics;	//!< Optional statistics (nullptr = none).
+
+	bool useEdgeMoments;	//!< Compute the edge end angles from cumulative moments (see setEdgeMoments).
+
+	bool useGlobalGapBridging;	//!< Connect the pairs of bridgeEdgeGaps in the order of their costs (see setGlobalGapBridging).
+
+	cv::Mat previousFrame;	//!< Frame traced by traceNextFrame, empty if the edges and clusters do not belong to a traced frame.
+
+	/** Cached angle of an edge at one of its ends (see getEdgeEndAngle).
+	 */
+	struct EdgeEndAngle
+	{
+		bool valid = false;			//!< False until computed and after the edge was modified.
+		cv::Point point;			//!< End point from which the angle was computed.
+		size_t numberPixels = 0;	//!< Number of pixels used to compute the angle.
+		double angle = 0.0;			//!< Angle in deg (see getEdgeAngleWithLSM).
+	};
+
+	std::vector<std::array<EdgeEndAngle, 2>> edgeEndAngles;	//!< Cached angles at the start [0] and end [1] of each edge.
+
+	/** Sums over points of an edge, used to fit straight lines (see getLSMError).
+	 */
+	struct Moments
+	{
+		int64_t x = 0;
+		int64_t y = 0;
+		int64_t xx = 0;
+		int64_t xy = 0;
+		int64_t yy = 0;
+	};
+
+	std::vector<std::vector<Moments>> edgeMoments;	//!< Moments of the first k points of each edge at [k] (only with useEdgeMoments, empty until used).
+
 	/**
-	 * Get direct neighbors (as in our sense) of point p clockwise from top left.
-	 * Diagonal neighbors are only returned if they do not have any orthogonal neighbors.
-	 * @img				Input Image.
-	 * @p				Point of interest.
+	 * Reset and initialization of traceEdges: removes all edges, clusters and cached data and initializes the edgeIdMap
+	 * for the size of the image.
+	 * @img 			Input Image.
 	 */
-	std::vector<cv::Point> getDirectNeighbors(cv::Mat &img, cv::Point p);
+	void resetTracing(const cv::Mat &img);
 
 	/**
-	 * Returns occupancy of all neighbors of p as binary code.
-	 * @img				Input Image.
+	 * Chooses the dense or sparse backend of the edgeIdMap based on the edge density estimated from a subset of rows.
+	 * @img 			Input Image.
+	 */
+	EdgeMap::Backend selectEdgeMapBackend(const cv::Mat &img) const;
+
+	/**
+	 * Returns occupancy of all neighbors of p as binary code (see Neighborhood.h).
+	 * Direct neighbors and cluster status are looked up with the code in NEIGHBORHOOD_TABLE.
 	 * @p				Point of interest.
 	 */
-	uint8_t getBinaryCode(cv::Mat &img, cv::Point p);
+	uint8_t getBinaryCode(cv::Point p) const;
+
+	/**
+	 * Preprocessing to identify all cluster points (creates the ambiguityMap). Computes binaryCodes and ambiguityMask
+	 * in one vectorized pass and then groups the marked pixels to clusters (see groupClusters).
+	 * @img 			Input Image.
+	 */
+	void preprocessClusters(const cv::Mat &img);
 
 	/**
-	 * Check if 3x3 region contains at least one four-cluster based on its binary code (four-clusters are always located in corners).
-	 * @binaryCode		Binary code of the occupancy of all neighbors (represented as integer).
+	 * Tracing loop of traceEdges (clusters must have been preprocessed): traces each edge component starting at its
+	 * first pixel in raster order.
+	 * @img 			Input Image.
 	 */
-	const bool containsFourCluster(uint8_t binaryCode);
+	void traceEdgesSerial(const cv::Mat &img);
 
 	/**
-	 * Preprocessing to identify all cluster points (creates the ambiguityMap)
+	 * Parallel version of traceEdgesSerial (clusters must have been preprocessed). The edge components
+	 * (connected non-cluster edge pixels) are traced from their seeds concurrently, the results are then committed
+	 * in seed order, which gives the same edges and edgeIds as tracing in raster order.
 	 * @img 			Input Image.
 	 */
-	void preprocessClusters(cv::Mat &img);
+	void traceEdgesParallel(const cv::Mat &img);
+
+	/**
+	 * Incremental tracing of traceNextFrame: removes the edges and clusters within two pixels of the changed tiles
+	 * (the neighborhood of the pixels within one pixel changes), classifies the pixels of the changed tiles again,
+	 * then groups the cluster points and traces the edges of the removed edges and changed tiles (in raster order,
+	 * as traceEdgesSerial).
+	 * @img 			Input Image (next frame).
+	 * @changedTiles	Tiles in which img differs from previousFrame.
+	 */
+	void retraceChangedTiles(const cv::Mat &img, const std::vector<cv::Rect> &changedTiles);
 
 	/**
-	 * Tracing function which is called recursively.
-	 * @img			Input Image.
-	 * @startPoint	Current point that is traced.
-	 * @edge		Current edge to which the point belongs.
+	 * Traces all edges reachable from the start point. Works iteratively with an explicit task stack,
+	 * so edges of any length are traced in constant stack space. Only marks the traced pixels in the ambiguityMask,
+	 * the caller adds the edges and their edgeIds.
+	 * @startPoint		Point where tracing starts (must not be a cluster point).
+	 * @componentEdges	Output: traced edges. An edge traced in two directions is merged into the first edge,
+	 * 					followed by an empty edge (as with mergeEdges).
 	 */
-	void traceEdge(cv::Mat &img, cv::Point startPoint, std::vector<cv::Point> &edge);
+	void traceEdge(cv::Point startPoint, std::vector<std::vector<cv::Point>> &componentEdges);
 
 	/**
-	 * Function to merge (connect) two edges.
+	 * Counts and logs the merge of an edge traced in two directions (as mergeEdges).
+	 * @firstEdgeId		Identifier of the first edge of the traced component.
+	 * @numberOfEdges	Number of edges of the traced component.
+	 */
+	void recordComponentMerge(int firstEdgeId, int numberOfEdges) const;
+
+	/**
+	 * Function to merge (connect) two edges. The points are joined without copying (see Edges::join) and the edgeId of
+	 * the second edge is redirected in the edgeIdMap (see EdgeMap::redirectEdgeId), so merging takes near-constant time.
+	 * Postprocessing functions which merge call Edges::flattenJoinedEdges before they return.
 	 * @firstId				Identifier of the first edge to be merged.
 	 * @secondId			Identifier of the second edge to be merged.
 	 */
 	void mergeEdges(int firstId, int secondId);
 
+	/**
+	 * Adds an edge which connects two edges to edges and edgeIdMap (it is merged with them afterwards).
+	 * @points				Points of the connecting edge.
+	 * @returns				EdgeId of the connecting edge.
+	 */
+	int addConnectingEdge(const std::vector<cv::Point> &points);
+
+	/** Cluster as passed to the visitor of forEachCluster.
+	 */
+	struct ClusterView
+	{
+		cv::Point position;									//!< First point in raster order, identifies the cluster in EdgeMap calls.
+		const std::vector<cv::Point> *points;				//!< Cluster points (valid until the clusters are modified).
+		std::vector<int> edgeIds;							//!< Ordered edgeIds of the cluster when it is visited.
+		std::vector<std::pair<int, cv::Point>> endPoints;	//!< Start and end points in the cluster of these edges (edgeId, point).
+	};
+
+	/**
+	 * Cluster registry for the cluster-based postprocessing: visits each cluster once, in the raster order of its first
+	 * point (the order in which a scan over all pixels reaches the clusters). Clusters cleared by an earlier visit are
+	 * skipped. The cost depends on the number of clusters and cluster points, not on the image size.
+	 * @visitor			Called for each cluster, may merge edges and clear clusters.
+	 */
+	void forEachCluster(const std::function<void(const ClusterView &)> &visitor);
+
+	/** Pair of connection points in a cluster with the smallest costs (see connectEdgesInClusters).
+	 */
+	struct ClusterConnection
+	{
+		int firstEdgeId = -1;				//!< First edge to be merged, -1 if no pair is below the threshold angle.
+		int secondEdgeId = -1;				//!< Second edge to be merged (the first edge itself to close it).
+		cv::Point firstPoint;				//!< Connection point of the first edge.
+		cv::Point secondPoint;				//!< Connection point of the second edge.
+		uint64_t evaluatedCandidates = 0;	//!< Number of pairs of connection points whose costs were computed.
+	};
+
+	/**
+	 * Finds the pair of connection points in a cluster with the smallest costs below the threshold angle. Only reads
+	 * the edges, so clusters which do not share edges can be evaluated concurrently.
+	 * @clusterEdgeIds		Ordered edgeIds of the cluster.
+	 * @connectionPoints	Start and/or end point in the cluster of each edge in clusterEdgeIds (see findConnectionPointsInCluster).
+	 * @numberPixels, ...	See connectEdgesInClusters.
+	 */
+	ClusterConnection findClusterConnection(const std::vector<int> &clusterEdgeIds, const std::vector<std::vector<cv::Point>> &connectionPoints,
+											size_t numberPixels, double thresholdAngle, double alpha, double beta, bool connectSameEdge);
+
+	/**
+	 * Merges the best pair of edges in the cluster at the given position until no pair is below the threshold angle.
+	 * @position			Point of the cluster.
+	 * @numberPixels, ...	See connectEdgesInClusters.
+	 * @firstConnection		Result of findClusterConnection for the current state of the cluster, nullptr to compute it.
+	 */
+	void connectEdgesInCluster(cv::Point position, size_t numberPixels, double thresholdAngle, double alpha, double beta, bool connectSameEdge,
+							   const ClusterConnection *firstConnection);
+
+	/**
+	 * Parallel version of connectEdgesInClusters (without the final flattenJoinedEdges). Runs of consecutive clusters
+	 * which share no edges (and no bounding box area) are evaluated concurrently, the merges are committed in the serial
+	 * order, so the result is identical to the serial version.
+	 */
+	void connectEdgesInClustersParallel(size_t numberPixels, double thresholdAngle, double alpha, double beta, bool connectSameEdge);
+
+	/**
+	 * Angle of the edge at its start or end point, computed with getEdgeAngleWithLSM (or getEdgeAngleWithMoments) from
+	 * the numberPixels points along the edge. The angle is cached per edge end until the edge is merged or removed, so
+	 * repeated evaluations (such as the candidate loops and passes of connectEdgesInClusters and bridgeEdgeGaps) do not
+	 * copy the points again. Different edges can be queried concurrently if the caches are large enough for all edgeIds
+	 * (see reserveEdgeCaches).
+	 * @edgeId			Identifier of the edge.
+	 * @point			Start or end point of the edge (other points are computed without caching).
+	 * @numberPixels	Number of pixels considered to compute the angle.
+	 * @returns			Angle in deg.
+	 */
+	double getEdgeEndAngle(int edgeId, cv::Point point, size_t numberPixels);
+
+	/**
+	 * Sizes the angle and moment caches for all current edgeIds.
+	 */
+	void reserveEdgeCaches();
+
+	/**
+	 * Drops the cached angles and moments of an edge, must be called whenever the points of the edge change.
+	 * @edgeId			Identifier of the edge.
+	 */
+	void invalidateEdgeCaches(int edgeId);
+
+	/**
+	 * Drops the cached angles and moments of all edges (when edgeIds or all edges change).
+	 */
+	void clearEdgeCaches();
+
+	/**
+	 * Moves the cached angles and moments of all edges to their new edgeIds (after Edges::eraseEmptyEdges).
+	 * @newEdgeIds		New edgeId of each previous edgeId (-1 for erased edges).
+	 */
+	void remapEdgeCaches(const std::vector<int> &newEdgeIds);
+
+	/**
+	 * Cumulative moments of the edge (computed if the edge has none).
+	 * @edgeId			Identifier of the edge.
+	 * @returns			Moments of the first k points at [k], for k = 0 ... size of the edge.
+	 */
+	const std::vector<Moments> &getEdgeMoments(int edgeId);
+
+	/**
+	 * Same angle as getEdgeAngleWithLSM for the numberPixels points from one end of the edge, computed in constant time
+	 * from the cumulative moments of the edge.
+	 * @edgeId			Identifier of the edge.
+	 * @fromBack		Use the points from the end point of the edge (otherwise from the start point).
+	 * @numberPixels	Number of pixels considered to compute the angle.
+	 * @returns			Angle in deg.
+	 */
+	double getEdgeAngleWithMoments(int edgeId, bool fromBack, size_t numberPixels);
+
 	/**
 	 * Computes the angle between the given points in the image plane.
 	 * @returns			Angle in deg.
@@ -173,7 +429,18 @@ private:
 	 * @b				Parameter (y-intercept) of the straight line in the form y = ax + b.
 	 * @returns			Approximation error.
 	 */
-	double getLSMError(std::vector<cv::Point> points, double& a, double& b);
+	double getLSMError(const std::vector<cv::Point> &points, double& a, double& b);
+
+	/**
+	 * Same as getLSMError, but computed from the sums over the points.
+	 * @sums			Sums over the points.
+	 * @numberPoints	Number of points.
+	 * @front			First point (connection point).
+	 * @a				Parameter (slope) of the straight line in the form y = ax + b.
+	 * @b				Parameter (y-intercept) of the straight line in the form y = ax + b.
+	 * @returns			Approximation error.
+	 */
+	double getLSMError(const Moments &sums, size_t numberPoints, cv::Point front, double& a, double& b);
 
 	/**
 	 * Computes the angle of the straight line approximated with the LSM method.
@@ -205,13 +472,59 @@ private:
 
 	/**
 	 * Finds all start and end points of edges in the search area and returns them together with their corresponding edgeId.
+	 * Only the points of the endpoint index inside the search area are checked (in raster order).
+	 * @endpoints		Index with (at least) all current start and end points of the edges.
 	 * @p				Reference point.
-	 * @edgeId			The edgeId to which the reference point belongs.
-	 * @blockDistance	L1 (Manhattan) distance considered to search for nearby edges.
+	 * @blockDistance	Distance considered to search for nearby edges.
 	 * @thresholdAngle	Angle difference must be smaller than or equal to this threshold.
 	 * @referenceAngle	Angle taken as reference, returned edges points must be closer than thresholdAngle to this angle.
 	 */
-	std::vector<std::pair<int, cv::Point>> getEdgesInSearchArea(cv::Point p, int blockDistance, double thresholdAngle, double referenceAngle);
+	std::vector<std::pair<int, cv::Point>> getEdgesInSearchArea(const EndpointIndex &endpoints, cv::Point p, int blockDistance, double thresholdAngle, double referenceAngle);
+
+	/**
+	 * Checks if the point is the start or end point of any edge at this position of the edgeIdMap.
+	 */
+	bool isEdgeEndpoint(cv::Point p);
+
+	/**
+	 * Costs of bridging the gap between the end of a reference edge and the end of a candidate edge (see bridgeEdgeGaps).
+	 * @referencePoint	Start or end point of the reference edge.
+	 * @referenceAngle	Angle of the reference edge at referencePoint.
+	 * @candidateEdgeId	Identifier of the candidate edge.
+	 * @candidatePoint	Start or end point of the candidate edge.
+	 * @numberPixels, ...	See bridgeEdgeGaps.
+	 * @angleDiff		Output: difference between the angles of the two edges (compared with thresholdAngle).
+	 * @returns			Costs C = alpha*angleDiff + beta*distance.
+	 */
+	double getBridgeCosts(cv::Point referencePoint, double referenceAngle, int candidateEdgeId, cv::Point candidatePoint,
+						  size_t numberPixels, double alpha, double beta, double &angleDiff);
+
+	/** Scored pair of endpoints in the priority queue of bridgeEdgeGapsGlobal.
+	 */
+	struct BridgeCandidate
+	{
+		double costs;					//!< Costs of the bridge (see getBridgeCosts).
+		cv::Point referencePoint;		//!< End point of the reference edge.
+		cv::Point candidatePoint;		//!< End point of the candidate edge.
+		int referenceEdgeId;			//!< Reference edge, merged with the bridge and the candidate edge.
+		int candidateEdgeId;			//!< Candidate edge (the reference edge itself to close it).
+		uint32_t referenceVersion;		//!< Number of changes of the reference edge when the pair was scored.
+		uint32_t candidateVersion;		//!< Number of changes of the candidate edge when the pair was scored.
+
+		/** Orders by costs, then by the positions of the points (so ties do not depend on the edgeIds).
+		 */
+		bool operator>(const BridgeCandidate &other) const;
+	};
+
+	/**
+	 * Version of bridgeEdgeGaps with global scheduling (see setGlobalGapBridging): scores the pairs of all edge ends,
+	 * then connects the pair with the smallest costs until the queue is empty. Entries of edges which were merged
+	 * since they were scored are skipped when they are popped; the ends of a merged edge and the pairs of the edge ends
+	 * near them with the merged edge are scored again.
+	 * @endpoints		Index with all current start and end points of the edges.
+	 * @numberPixels, ...	See bridgeEdgeGaps.
+	 */
+	void bridgeEdgeGapsGlobal(EndpointIndex &endpoints, size_t numberPixels, double thresholdAngle, int blockDistance, double alpha, double beta);
 };
 
 #endif /* EDGEPROCESSOR_H_ */
@@ -1,61 +1,431 @@
 #include "Edges.h"
+#include <algorithm>
 #include <iostream>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "Neighborhood.h"
+
+namespace
+{
+	constexpr size_t MIN_COMPACTION_BYTES = 1 << 16;	// Unused bytes below this size are never compacted
+
+	/** Chain code of a step to one of the 8 neighbors, indexed by (dy + 1) * 3 + (dx + 1). The codes are the
+	 *  neighbor indices of detail::NEIGHBOR_DX and detail::NEIGHBOR_DY, -1 marks the step (0, 0).
+	 */
+	constexpr int8_t CHAIN_CODES[9] = {0, 1, 2, 7, -1, 3, 6, 5, 4};
+
+	/** Chain code of a step, -1 if the points are not neighbors.
+	 */
+	int getChainCode(cv::Point step)
+	{
+		if (step.x < -1 || step.x > 1 || step.y < -1 || step.y > 1)
+		{
+			return -1;
+		}
+
+		return CHAIN_CODES[(step.y + 1) * 3 + step.x + 1];
+	}
+
+	/** Step i of the chain codes of an edge.
+	 */
+	cv::Point getStep(const uint8_t *codes, size_t i)
+	{
+		size_t bit = 3 * i;
+		unsigned int bits = codes[bit / 8] >> (bit % 8);
+
+		// A code can span two bytes
+		if (bit % 8 > 5)
+		{
+			bits |= codes[bit / 8 + 1] << (8 - bit % 8);
+		}
+
+		return cv::Point(detail::NEIGHBOR_DX[bits & 7], detail::NEIGHBOR_DY[bits & 7]);
+	}
+
+	/** Number of bytes of the chain codes of an edge with given number of points.
+	 */
+	size_t getNumberOfCodeBytes(size_t size)
+	{
+		return (size > 1) ? (3 * (size - 1) + 7) / 8 : 0;
+	}
+
+} // end namespace
+
+void EdgePoints::Iterator::decodeStep()
+{
+	point += getStep(source.codes, index - 1);
+}
+
+std::vector<cv::Point> EdgePoints::toVector() const
+{
+	std::vector<cv::Point> edge;
+	edge.reserve(count);
+	edge.insert(edge.end(), begin(), end());
+	return edge;
+}
+
+void Edges::setStorage(Storage storage)
+{
+	if (storage == Edges::storage)
+	{
+		return;
+	}
+
+	flattenJoinedEdges();
+
+	std::vector<std::vector<cv::Point>> edges;
+	edges.reserve(size());
+
+	for (size_t edgeId = 0; edgeId < size(); edgeId++)
+	{
+		edges.push_back(getEdge(edgeId));
+	}
+
+	clear();
+	Edges::storage = storage;
+
+	for (auto& edge : edges)
+	{
+		pushBack(std::move(edge));
+	}
+}
+
+Edges::Storage Edges::getStorage() const
+{
+	return storage;
+}
+
+size_t Edges::getMemoryUsage() const
+{
+	if (storage == Storage::ChainCode)
+	{
+		return chainCodeEdges.capacity() * sizeof(ChainCodeEdge) + chainCodes.capacity() + irregularPoints.capacity() * sizeof(cv::Point);
+	}
+
+	if (storage == Storage::Pool)
+	{
+		return poolEdges.capacity() * sizeof(PoolEdge) + (poolX16.capacity() + poolY16.capacity()) * sizeof(uint16_t) +
+			   (poolX32.capacity() + poolY32.capacity()) * sizeof(int32_t);
+	}
+
+	size_t bytes = data.capacity() * sizeof(std::vector<cv::Point>);
+
+	for (const auto& edge : data)
+	{
+		bytes += edge.capacity() * sizeof(cv::Point);
+	}
+
+	return bytes;
+}
 
 void Edges::clear()
 {
 	data.clear();
+	chainCodeEdges.clear();
+	chainCodes.clear();
+	irregularPoints.clear();
+	poolEdges.clear();
+	poolX16.clear();
+	poolY16.clear();
+	poolX32.clear();
+	poolY32.clear();
+	widePool = false;
+	unusedBytes = 0;
+	joinedEdges.clear();
+	pieces.clear();
 }
 
 void Edges::pushBack(std::vector<cv::Point> edge)
 {
-	data.push_back(edge);
+	if (!joinedEdges.empty())
+	{
+		joinedEdges.push_back({JoinState::Stored, NO_PIECE, NO_PIECE, 0, cv::Point(), cv::Point()});
+	}
+
+	if (storage == Storage::ChainCode)
+	{
+		chainCodeEdges.push_back(encode(edge));
+		return;
+	}
+
+	if (storage == Storage::Pool)
+	{
+		poolEdges.push_back(append(edge));
+		return;
+	}
+
+	data.push_back(std::move(edge));
 }
 
 void Edges::insert(int edgeId, std::vector<cv::Point> edge)
 {
-	data.insert(data.begin() + edgeId, edge);
+	flattenJoinedEdges();
+
+	if (storage == Storage::ChainCode)
+	{
+		chainCodeEdges.insert(chainCodeEdges.begin() + edgeId, encode(edge));
+		return;
+	}
+
+	if (storage == Storage::Pool)
+	{
+		poolEdges.insert(poolEdges.begin() + edgeId, append(edge));
+		return;
+	}
+
+	data.insert(data.begin() + edgeId, std::move(edge));
 }
 
 void Edges::overwrite(int edgeId, std::vector<cv::Point> edge)
 {
-	data[edgeId] = edge;
+	if (isJoined(edgeId))
+	{
+		storeJoinedEdge(edgeId, std::move(edge));
+		return;
+	}
+
+	overwriteStored(edgeId, std::move(edge));
+}
+
+void Edges::overwriteStored(int edgeId, std::vector<cv::Point> edge)
+{
+	if (storage == Storage::ChainCode)
+	{
+		ChainCodeEdge previous = chainCodeEdges[edgeId];
+		chainCodeEdges[edgeId] = encode(edge);
+		release(getNumberOfBytes(previous));
+		return;
+	}
+
+	if (storage == Storage::Pool)
+	{
+		PoolEdge &pooled = poolEdges[edgeId];
+		bool fits = edge.size() <= pooled.size;
+
+		for (size_t i = 0; i < edge.size() && fits && !widePool; i++)
+		{
+			fits = edge[i].x >= 0 && edge[i].y >= 0 && edge[i].x <= UINT16_MAX && edge[i].y <= UINT16_MAX;
+		}
+
+		if (!fits)
+		{
+			PoolEdge previous = pooled;
+			poolEdges[edgeId] = append(edge);
+			release(getNumberOfBytes(previous));
+			return;
+		}
+
+		// Shorter edges are written in place, the rest of the previous points is unused
+		for (size_t i = 0; i < edge.size(); i++)
+		{
+			if (widePool)
+			{
+				poolX32[pooled.offset + i] = edge[i].x;
+				poolY32[pooled.offset + i] = edge[i].y;
+			}
+			else
+			{
+				poolX16[pooled.offset + i] = edge[i].x;
+				poolY16[pooled.offset + i] = edge[i].y;
+			}
+		}
+
+		PoolEdge unused = {pooled.offset + (uint32_t)edge.size(), pooled.size - (uint32_t)edge.size()};
+		pooled.size = edge.size();
+		release(getNumberOfBytes(unused));
+		return;
+	}
+
+	data[edgeId] = std::move(edge);
 }
 
 void Edges::popBack()
 {
+	if (!joinedEdges.empty())
+	{
+		if (isJoined(size() - 1))
+		{
+			flattenJoinedEdges();
+		}
+		else
+		{
+			joinedEdges.pop_back();
+		}
+	}
+
+	if (storage == Storage::ChainCode)
+	{
+		ChainCodeEdge previous = chainCodeEdges.back();
+		chainCodeEdges.pop_back();
+		release(getNumberOfBytes(previous));
+		return;
+	}
+
+	if (storage == Storage::Pool)
+	{
+		PoolEdge previous = poolEdges.back();
+		poolEdges.pop_back();
+
+		// The points of the last edge are usually at the end of the arrays
+		if (previous.offset + previous.size == getPoolSize())
+		{
+			poolX16.resize(widePool ? 0 : previous.offset);
+			poolY16.resize(widePool ? 0 : previous.offset);
+			poolX32.resize(widePool ? previous.offset : 0);
+			poolY32.resize(widePool ? previous.offset : 0);
+			return;
+		}
+
+		release(getNumberOfBytes(previous));
+		return;
+	}
+
 	data.pop_back();
 }
 
 size_t Edges::size() const
 {
-	return data.size();
+	if (storage == Storage::ChainCode)
+	{
+		return chainCodeEdges.size();
+	}
+
+	return (storage == Storage::Pool) ? poolEdges.size() : data.size();
 }
 
-void Edges::eraseEmptyEdges()
+std::vector<int> Edges::eraseEmptyEdges()
 {
-	std::vector<cv::Point> emptyEdge;
-	data.erase(std::remove(data.begin(), data.end(), emptyEdge), data.end());
+	flattenJoinedEdges();
+
+	// The remaining edges keep their order
+	std::vector<int> newEdgeIds(size(), -1);
+	int newEdgeId = 0;
+
+	for (size_t edgeId = 0; edgeId < newEdgeIds.size(); edgeId++)
+	{
+		if (getEdgeSize(edgeId) > 0)
+		{
+			newEdgeIds[edgeId] = newEdgeId++;
+		}
+	}
+
+	if (storage == Storage::ChainCode)
+	{
+		// Empty edges have no codes
+		chainCodeEdges.erase(std::remove_if(chainCodeEdges.begin(), chainCodeEdges.end(), [](const ChainCodeEdge &edge) { return edge.size == 0; }),
+							 chainCodeEdges.end());
+	}
+	else if (storage == Storage::Pool)
+	{
+		poolEdges.erase(std::remove_if(poolEdges.begin(), poolEdges.end(), [](const PoolEdge &edge) { return edge.size == 0; }), poolEdges.end());
+	}
+	else
+	{
+		data.erase(std::remove_if(data.begin(), data.end(), [](const std::vector<cv::Point> &edge) { return edge.empty(); }), data.end());
+	}
+
+	return newEdgeIds;
 }
 
 void Edges::clearEdge(int edgeId)
 {
+	if (isJoined(edgeId))
+	{
+		storeJoinedEdge(edgeId, std::vector<cv::Point>());
+		return;
+	}
+
+	clearStored(edgeId);
+}
+
+void Edges::clearStored(int edgeId)
+{
+	if (storage == Storage::ChainCode)
+	{
+		ChainCodeEdge previous = chainCodeEdges[edgeId];
+		chainCodeEdges[edgeId] = ChainCodeEdge();
+		release(getNumberOfBytes(previous));
+		return;
+	}
+
+	if (storage == Storage::Pool)
+	{
+		PoolEdge previous = poolEdges[edgeId];
+		poolEdges[edgeId] = PoolEdge();
+		release(getNumberOfBytes(previous));
+		return;
+	}
+
 	data[edgeId].clear();
 }
 
-const std::vector<cv::Point> &Edges::getEdge(int index) const
+std::vector<cv::Point> Edges::getEdge(int index) const
 {
-	return data[index];
+	if (isJoined(index))
+	{
+		return getJoinedEdge(index);
+	}
+
+	return (storage == Storage::Points) ? data[index] : getPoints(index).toVector();
 }
 
-const std::vector<std::vector<cv::Point>> &Edges::getEdges() const
+EdgePoints Edges::getPoints(int edgeId) const
 {
-	return data;
+	return getStoredPoints(edgeId);
 }
 
-int Edges::getEdgeId(std::vector<cv::Point> edge)
+EdgePoints Edges::getStoredPoints(int edgeId) const
 {
+	if (storage == Storage::ChainCode)
+	{
+		const ChainCodeEdge &edge = chainCodeEdges[edgeId];
+
+		if (edge.irregular)
+		{
+			return EdgePoints(irregularPoints.data() + edge.offset, edge.size);
+		}
+
+		return EdgePoints(chainCodes.data() + edge.offset, edge.start, edge.end, edge.size);
+	}
+
+	if (storage == Storage::Pool)
+	{
+		const PoolEdge &edge = poolEdges[edgeId];
+
+		if (widePool)
+		{
+			return EdgePoints(poolX32.data() + edge.offset, poolY32.data() + edge.offset, edge.size);
+		}
+
+		return EdgePoints(poolX16.data() + edge.offset, poolY16.data() + edge.offset, edge.size);
+	}
+
+	return EdgePoints(data[edgeId].data(), data[edgeId].size());
+}
+
+int Edges::getEdgeId(const std::vector<cv::Point> &edge)
+{
+	flattenJoinedEdges();
+
 	int edgeId = 0;
 
+	if (storage != Storage::Points)
+	{
+		for (; edgeId < (int)size(); edgeId++)
+		{
+			EdgePoints points = getPoints(edgeId);
+
+			if (points.size() == edge.size() && std::equal(edge.begin(), edge.end(), points.begin()))
+			{
+				break;
+			}
+		}
+
+		return edgeId;
+	}
+
 	for (const auto& edgeVector : data)
 	{
 		if (edgeVector == edge)
@@ -69,44 +439,184 @@ int Edges::getEdgeId(std::vector<cv::Point> edge)
 	return edgeId;
 }
 
+int Edges::getEdgeId(int index)
+{
+	flattenJoinedEdges();
+
+	size_t edgeSize = getEdgeSize(index);
+	EdgePoints points = getPoints(index);
+
+	for (int edgeId = 0; edgeId < index; edgeId++)
+	{
+		if (getEdgeSize(edgeId) == edgeSize)
+		{
+			EdgePoints otherPoints = getPoints(edgeId);
+
+			if (std::equal(points.begin(), points.end(), otherPoints.begin()))
+			{
+				return edgeId;
+			}
+		}
+	}
+
+	return index;
+}
+
+std::vector<int> Edges::getEdgeIds()
+{
+	flattenJoinedEdges();
+
+	std::vector<int> edgeIds(size());
+	std::unordered_map<uint64_t, std::vector<int>> edgesByHash; // Hash of the points -> edgeIds of distinct edges
+
+	for (size_t edgeId = 0; edgeId < size(); edgeId++)
+	{
+		EdgePoints points = getPoints(edgeId);
+
+		// FNV-1a over the coordinates
+		uint64_t hash = 0xcbf29ce484222325ull;
+
+		for (const cv::Point &point : points)
+		{
+			hash = (hash ^ static_cast<uint32_t>(point.x)) * 0x100000001b3ull;
+			hash = (hash ^ static_cast<uint32_t>(point.y)) * 0x100000001b3ull;
+		}
+
+		std::vector<int> &candidates = edgesByHash[hash];
+		edgeIds[edgeId] = edgeId;
+
+		for (int candidate : candidates)
+		{
+			EdgePoints candidatePoints = getPoints(candidate);
+
+			if (candidatePoints.size() == points.size() && std::equal(points.begin(), points.end(), candidatePoints.begin()))
+			{
+				edgeIds[edgeId] = candidate;
+				break;
+			}
+		}
+
+		if (edgeIds[edgeId] == static_cast<int>(edgeId))
+		{
+			candidates.push_back(edgeId);
+		}
+	}
+
+	return edgeIds;
+}
+
 cv::Point Edges::getStartPoint(int edgeId) const
 {
-	return data[edgeId].front();
+	if (isJoined(edgeId))
+	{
+		return joinedEdges[edgeId].start;
+	}
+
+	if (storage == Storage::ChainCode)
+	{
+		return chainCodeEdges[edgeId].start;
+	}
+
+	return (storage == Storage::Pool) ? getPoolPoint(poolEdges[edgeId].offset) : data[edgeId].front();
 }
 
 cv::Point Edges::getEndPoint(int edgeId) const
 {
-	return data[edgeId].back();
+	if (isJoined(edgeId))
+	{
+		return joinedEdges[edgeId].end;
+	}
+
+	if (storage == Storage::ChainCode)
+	{
+		return chainCodeEdges[edgeId].end;
+	}
+
+	return (storage == Storage::Pool) ? getPoolPoint(poolEdges[edgeId].offset + poolEdges[edgeId].size - 1) : data[edgeId].back();
 }
 
 size_t Edges::getEdgeSize(int edgeId) const
 {
-	return data[edgeId].size();
+	if (isJoined(edgeId))
+	{
+		return (joinedEdges[edgeId].state == JoinState::Joined) ? joinedEdges[edgeId].size : 0;
+	}
+
+	return getStoredSize(edgeId);
+}
+
+size_t Edges::getStoredSize(int edgeId) const
+{
+	if (storage == Storage::ChainCode)
+	{
+		return chainCodeEdges[edgeId].size;
+	}
+
+	return (storage == Storage::Pool) ? poolEdges[edgeId].size : data[edgeId].size();
 }
 
-void Edges::eraseEdge(std::vector<cv::Point> edge)
+void Edges::eraseEdge(const std::vector<cv::Point> &edge)
 {
-	data.erase(std::find(data.begin(), data.end(), edge));
+	eraseEdge(getEdgeId(edge));
+}
+
+void Edges::eraseEdge(int edgeId)
+{
+	flattenJoinedEdges();
+
+	if (storage == Storage::ChainCode)
+	{
+		ChainCodeEdge previous = chainCodeEdges[edgeId];
+		chainCodeEdges.erase(chainCodeEdges.begin() + edgeId);
+		release(getNumberOfBytes(previous));
+		return;
+	}
+
+	if (storage == Storage::Pool)
+	{
+		PoolEdge previous = poolEdges[edgeId];
+		poolEdges.erase(poolEdges.begin() + edgeId);
+		release(getNumberOfBytes(previous));
+		return;
+	}
+
+	data.erase(data.begin() + edgeId);
 }
 
 std::vector<cv::Point> Edges::getPointsAlongEdgeFromPoint(int edgeId, cv::Point point, size_t numberPixels)
 {
-	std::vector<cv::Point> edge = data[edgeId];
 	std::vector<cv::Point> nPoints;
+	size_t size = getEdgeSize(edgeId);
 
-	if (edge.front() == point)
+	if (size == 0)
 	{
-		for (size_t i=0; i < std::min(numberPixels, edge.size()); i++)
-		{
-			nPoints.push_back(edge[i]);
-		}
+		return nPoints;
 	}
-	else if (edge.back() == point)
+
+	bool fromBack = (getStartPoint(edgeId) != point);
+
+	if (fromBack && getEndPoint(edgeId) != point)
 	{
-		for (int i=edge.size()-1; i >= std::max(static_cast<int>(edge.size()-numberPixels), 0); i--)
-		{
-			nPoints.push_back(edge[i]);
-		}
+		return nPoints;
+	}
+
+	size_t n = std::min(numberPixels, size);
+	nPoints.reserve(n);
+
+	if (!isJoined(edgeId))
+	{
+		// Only the first (or last) n points are decoded
+		collectStoredPoints(edgeId, 0, size, fromBack, n, nPoints);
+		return nPoints;
+	}
+
+	// Go through the pieces from the start (or end) of the edge
+	const JoinedEdge &joinedEdge = joinedEdges[edgeId];
+
+	for (int32_t piece = fromBack ? joinedEdge.tail : joinedEdge.head; piece != NO_PIECE && nPoints.size() < n;
+		 piece = fromBack ? pieces[piece].previous : pieces[piece].next)
+	{
+		collectPiecePoints(pieces[piece], fromBack, n - nPoints.size(), nPoints);
 	}
 
 	return nPoints;
@@ -136,8 +646,552 @@ bool Edges::isThreePixelL(int edgeId)
 
 void Edges::reverseAll()
 {
+	flattenJoinedEdges();
+
+	if (storage == Storage::ChainCode)
+	{
+		// Encode the reversed edges into new buffers
+		Edges reversed;
+		reversed.setStorage(Storage::ChainCode);
+
+		for (size_t edgeId = 0; edgeId < size(); edgeId++)
+		{
+			std::vector<cv::Point> edge = getEdge(edgeId);
+			std::reverse(edge.begin(), edge.end());
+			reversed.pushBack(std::move(edge));
+		}
+
+		*this = std::move(reversed);
+		return;
+	}
+
+	if (storage == Storage::Pool)
+	{
+		for (const auto& edge : poolEdges)
+		{
+			if (widePool)
+			{
+				std::reverse(poolX32.begin() + edge.offset, poolX32.begin() + edge.offset + edge.size);
+				std::reverse(poolY32.begin() + edge.offset, poolY32.begin() + edge.offset + edge.size);
+			}
+			else
+			{
+				std::reverse(poolX16.begin() + edge.offset, poolX16.begin() + edge.offset + edge.size);
+				std::reverse(poolY16.begin() + edge.offset, poolY16.begin() + edge.offset + edge.size);
+			}
+		}
+
+		return;
+	}
+
     for (auto& edge : data)
     {
         std::reverse(edge.begin(), edge.end());
     }
 }
+
+void Edges::join(int edgeId, int otherId, bool prepend, bool reverseOther, size_t skipFront, size_t skipBack)
+{
+	// The stored points of absorbed edges belong to other edges
+	if (isJoined(edgeId) && joinedEdges[edgeId].state == JoinState::Absorbed)
+	{
+		flattenJoinedEdges();
+	}
+
+	if (isJoined(otherId) && joinedEdges[otherId].state == JoinState::Absorbed)
+	{
+		flattenJoinedEdges();
+	}
+
+	startJoin(edgeId);
+	startJoin(otherId);
+
+	JoinedEdge &edge = joinedEdges[edgeId];
+	JoinedEdge &other = joinedEdges[otherId];
+
+	// Leave out points at the start of the other edge
+	while (skipFront > 0 && other.head != NO_PIECE)
+	{
+		Piece &piece = pieces[other.head];
+		uint32_t skip = std::min<size_t>(skipFront, piece.end - piece.begin);
+
+		if (piece.reversed)
+		{
+			piece.end -= skip;
+		}
+		else
+		{
+			piece.begin += skip;
+		}
+
+		other.size -= skip;
+		skipFront -= skip;
+
+		// Unlink empty pieces
+		if (piece.begin == piece.end)
+		{
+			other.head = piece.next;
+
+			if (other.head != NO_PIECE)
+			{
+				pieces[other.head].previous = NO_PIECE;
+			}
+			else
+			{
+				other.tail = NO_PIECE;
+			}
+		}
+	}
+
+	// Leave out points at the end of the other edge
+	while (skipBack > 0 && other.tail != NO_PIECE)
+	{
+		Piece &piece = pieces[other.tail];
+		uint32_t skip = std::min<size_t>(skipBack, piece.end - piece.begin);
+
+		if (piece.reversed)
+		{
+			piece.begin += skip;
+		}
+		else
+		{
+			piece.end -= skip;
+		}
+
+		other.size -= skip;
+		skipBack -= skip;
+
+		if (piece.begin == piece.end)
+		{
+			other.tail = piece.previous;
+
+			if (other.tail != NO_PIECE)
+			{
+				pieces[other.tail].next = NO_PIECE;
+			}
+			else
+			{
+				other.head = NO_PIECE;
+			}
+		}
+	}
+
+	if (other.head != NO_PIECE)
+	{
+		std::vector<cv::Point> endPoints;
+		collectPiecePoints(pieces[other.head], false, 1, endPoints);
+		collectPiecePoints(pieces[other.tail], true, 1, endPoints);
+		other.start = endPoints[0];
+		other.end = endPoints[1];
+	}
+
+	if (reverseOther)
+	{
+		for (int32_t piece = other.head; piece != NO_PIECE; piece = pieces[piece].previous)
+		{
+			std::swap(pieces[piece].previous, pieces[piece].next);
+			pieces[piece].reversed = !pieces[piece].reversed;
+		}
+
+		std::swap(other.head, other.tail);
+		std::swap(other.start, other.end);
+	}
+
+	// Link the pieces of the other edge before or after the pieces of the edge
+	if (other.head != NO_PIECE)
+	{
+		if (edge.head == NO_PIECE)
+		{
+			edge.head = other.head;
+			edge.tail = other.tail;
+			edge.start = other.start;
+			edge.end = other.end;
+		}
+		else if (prepend)
+		{
+			pieces[other.tail].next = edge.head;
+			pieces[edge.head].previous = other.tail;
+			edge.head = other.head;
+			edge.start = other.start;
+		}
+		else
+		{
+			pieces[edge.tail].next = other.head;
+			pieces[other.head].previous = edge.tail;
+			edge.tail = other.tail;
+			edge.end = other.end;
+		}
+
+		edge.size += other.size;
+	}
+
+	other = {JoinState::Absorbed, NO_PIECE, NO_PIECE, 0, cv::Point(), cv::Point()};
+}
+
+void Edges::flattenJoinedEdges()
+{
+	if (joinedEdges.empty())
+	{
+		return;
+	}
+
+	// Collect the points of all joined edges first, they can be stored under the edgeIds of absorbed edges
+	std::vector<std::pair<int, std::vector<cv::Point>>> flattenedEdges;
+
+	for (size_t edgeId = 0; edgeId < joinedEdges.size(); edgeId++)
+	{
+		if (joinedEdges[edgeId].state == JoinState::Joined)
+		{
+			flattenedEdges.emplace_back(edgeId, getJoinedEdge(edgeId));
+		}
+	}
+
+	for (size_t edgeId = 0; edgeId < joinedEdges.size(); edgeId++)
+	{
+		if (joinedEdges[edgeId].state == JoinState::Absorbed)
+		{
+			clearStored(edgeId);
+		}
+	}
+
+	joinedEdges.clear();
+	pieces.clear();
+
+	for (auto& flattenedEdge : flattenedEdges)
+	{
+		overwriteStored(flattenedEdge.first, std::move(flattenedEdge.second));
+	}
+}
+
+bool Edges::isJoined(int edgeId) const
+{
+	return !joinedEdges.empty() && joinedEdges[edgeId].state != JoinState::Stored;
+}
+
+void Edges::startJoin(int edgeId)
+{
+	if (joinedEdges.empty())
+	{
+		joinedEdges.assign(size(), {JoinState::Stored, NO_PIECE, NO_PIECE, 0, cv::Point(), cv::Point()});
+	}
+
+	JoinedEdge &edge = joinedEdges[edgeId];
+
+	if (edge.state != JoinState::Stored)
+	{
+		return;
+	}
+
+	edge.state = JoinState::Joined;
+	edge.size = getStoredSize(edgeId);
+
+	if (edge.size > 0)
+	{
+		EdgePoints points = getStoredPoints(edgeId);
+		edge.head = edge.tail = pieces.size();
+		edge.start = points.front();
+		edge.end = points.back();
+		pieces.push_back({edgeId, 0, static_cast<uint32_t>(edge.size), false, NO_PIECE, NO_PIECE});
+	}
+}
+
+void Edges::collectPiecePoints(const Piece &piece, bool fromBack, size_t count, std::vector<cv::Point> &points) const
+{
+	// A reversed piece runs backward through the stored points
+	collectStoredPoints(piece.slot, piece.begin, piece.end, fromBack != piece.reversed, count, points);
+}
+
+void Edges::collectStoredPoints(int edgeId, size_t begin, size_t end, bool backward, size_t count, std::vector<cv::Point> &points) const
+{
+	count = std::min(count, end - begin);
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (storage == Storage::ChainCode && !chainCodeEdges[edgeId].irregular)
+	{
+		const ChainCodeEdge &edge = chainCodeEdges[edgeId];
+		const uint8_t *codes = chainCodes.data() + edge.offset;
+
+		if (!backward)
+		{
+			cv::Point current = edge.start;
+
+			for (size_t i = 0; i < begin; i++)
+			{
+				current += getStep(codes, i);
+			}
+
+			for (size_t k = 0; k < count; k++)
+			{
+				points.push_back(current);
+
+				if (k + 1 < count)
+				{
+					current += getStep(codes, begin + k);
+				}
+			}
+		}
+		else
+		{
+			// Walk back from the end point, step i leads from point i to point i + 1
+			cv::Point current = edge.end;
+
+			for (size_t i = edge.size - 1; i >= end; i--)
+			{
+				current -= getStep(codes, i - 1);
+			}
+
+			for (size_t k = 0; k < count; k++)
+			{
+				points.push_back(current);
+
+				if (k + 1 < count)
+				{
+					current -= getStep(codes, end - 2 - k);
+				}
+			}
+		}
+
+		return;
+	}
+
+	for (size_t k = 0; k < count; k++)
+	{
+		size_t i = backward ? end - 1 - k : begin + k;
+
+		if (storage == Storage::ChainCode)
+		{
+			points.push_back(irregularPoints[chainCodeEdges[edgeId].offset + i]);
+		}
+		else
+		{
+			points.push_back((storage == Storage::Pool) ? getPoolPoint(poolEdges[edgeId].offset + i) : data[edgeId][i]);
+		}
+	}
+}
+
+std::vector<cv::Point> Edges::getJoinedEdge(int edgeId) const
+{
+	std::vector<cv::Point> edge;
+
+	if (joinedEdges[edgeId].state != JoinState::Joined)
+	{
+		return edge;
+	}
+
+	edge.reserve(joinedEdges[edgeId].size);
+
+	for (int32_t piece = joinedEdges[edgeId].head; piece != NO_PIECE; piece = pieces[piece].next)
+	{
+		collectPiecePoints(pieces[piece], false, edge.capacity(), edge);
+	}
+
+	return edge;
+}
+
+void Edges::storeJoinedEdge(int edgeId, std::vector<cv::Point> edge)
+{
+	// The stored points of an absorbed edge are part of another edge
+	if (joinedEdges[edgeId].state == JoinState::Absorbed)
+	{
+		flattenJoinedEdges();
+		overwriteStored(edgeId, std::move(edge));
+		return;
+	}
+
+	// Only this edge uses the stored points of its pieces
+	for (int32_t piece = joinedEdges[edgeId].head; piece != NO_PIECE; piece = pieces[piece].next)
+	{
+		if (pieces[piece].slot != edgeId)
+		{
+			clearStored(pieces[piece].slot);
+			joinedEdges[pieces[piece].slot].state = JoinState::Stored;
+		}
+	}
+
+	joinedEdges[edgeId] = {JoinState::Stored, NO_PIECE, NO_PIECE, 0, cv::Point(), cv::Point()};
+	overwriteStored(edgeId, std::move(edge));
+}
+
+Edges::ChainCodeEdge Edges::encode(const std::vector<cv::Point> &edge)
+{
+	ChainCodeEdge encoded = ChainCodeEdge();
+
+	if (edge.empty())
+	{
+		return encoded;
+	}
+
+	encoded.start = edge.front();
+	encoded.end = edge.back();
+	encoded.size = edge.size();
+
+	for (size_t i = 1; i < edge.size() && !encoded.irregular; i++)
+	{
+		encoded.irregular = getChainCode(edge[i] - edge[i - 1]) < 0;
+	}
+
+	if (encoded.irregular)
+	{
+		encoded.offset = irregularPoints.size();
+		irregularPoints.insert(irregularPoints.end(), edge.begin(), edge.end());
+		return encoded;
+	}
+
+	encoded.offset = chainCodes.size();
+	chainCodes.resize(chainCodes.size() + getNumberOfCodeBytes(edge.size()), 0);
+	uint8_t *codes = chainCodes.data() + encoded.offset;
+
+	for (size_t i = 1; i < edge.size(); i++)
+	{
+		size_t bit = 3 * (i - 1);
+		unsigned int code = getChainCode(edge[i] - edge[i - 1]);
+		codes[bit / 8] |= code << (bit % 8);
+
+		if (bit % 8 > 5)
+		{
+			codes[bit / 8 + 1] |= code >> (8 - bit % 8);
+		}
+	}
+
+	return encoded;
+}
+
+Edges::PoolEdge Edges::append(const std::vector<cv::Point> &edge)
+{
+	for (size_t i = 0; i < edge.size() && !widePool; i++)
+	{
+		if (edge[i].x < 0 || edge[i].y < 0 || edge[i].x > UINT16_MAX || edge[i].y > UINT16_MAX)
+		{
+			widenPool();
+		}
+	}
+
+	PoolEdge pooled = {(uint32_t)getPoolSize(), (uint32_t)edge.size()};
+
+	for (const auto& point : edge)
+	{
+		if (widePool)
+		{
+			poolX32.push_back(point.x);
+			poolY32.push_back(point.y);
+		}
+		else
+		{
+			poolX16.push_back(point.x);
+			poolY16.push_back(point.y);
+		}
+	}
+
+	return pooled;
+}
+
+void Edges::widenPool()
+{
+	poolX32.assign(poolX16.begin(), poolX16.end());
+	poolY32.assign(poolY16.begin(), poolY16.end());
+	poolX16 = std::vector<uint16_t>();
+	poolY16 = std::vector<uint16_t>();
+	unusedBytes *= sizeof(int32_t) / sizeof(uint16_t);
+	widePool = true;
+}
+
+size_t Edges::getPoolSize() const
+{
+	return widePool ? poolX32.size() : poolX16.size();
+}
+
+cv::Point Edges::getPoolPoint(size_t index) const
+{
+	return widePool ? cv::Point(poolX32[index], poolY32[index]) : cv::Point(poolX16[index], poolY16[index]);
+}
+
+size_t Edges::getNumberOfBytes(const ChainCodeEdge &edge) const
+{
+	return edge.irregular ? edge.size * sizeof(cv::Point) : getNumberOfCodeBytes(edge.size);
+}
+
+size_t Edges::getNumberOfBytes(const PoolEdge &edge) const
+{
+	return edge.size * 2 * (widePool ? sizeof(int32_t) : sizeof(uint16_t));
+}
+
+void Edges::release(size_t bytes)
+{
+	unusedBytes += bytes;
+	size_t usedBytes = (storage == Storage::Pool) ? getNumberOfBytes(PoolEdge{0, (uint32_t)getPoolSize()}) :
+							chainCodes.size() + irregularPoints.size() * sizeof(cv::Point);
+
+	if (unusedBytes > MIN_COMPACTION_BYTES && 2 * unusedBytes > usedBytes)
+	{
+		compact();
+	}
+}
+
+void Edges::compact()
+{
+	if (storage == Storage::Pool)
+	{
+		// Copy the points in the order of the edgeIds, so passes over all edges read the arrays linearly
+		auto compactArrays = [this](auto &x, auto &y)
+		{
+			size_t usedPoints = 0;
+
+			for (const auto& edge : poolEdges)
+			{
+				usedPoints += edge.size;
+			}
+
+			std::remove_reference_t<decltype(x)> usedX, usedY;
+			usedX.reserve(usedPoints);
+			usedY.reserve(usedPoints);
+
+			for (auto& edge : poolEdges)
+			{
+				usedX.insert(usedX.end(), x.begin() + edge.offset, x.begin() + edge.offset + edge.size);
+				usedY.insert(usedY.end(), y.begin() + edge.offset, y.begin() + edge.offset + edge.size);
+				edge.offset = usedX.size() - edge.size;
+			}
+
+			x = std::move(usedX);
+			y = std::move(usedY);
+		};
+
+		if (widePool)
+		{
+			compactArrays(poolX32, poolY32);
+		}
+		else
+		{
+			compactArrays(poolX16, poolY16);
+		}
+
+		unusedBytes = 0;
+		return;
+	}
+
+	std::vector<uint8_t> usedCodes;
+	std::vector<cv::Point> usedPoints;
+
+	for (auto& edge : chainCodeEdges)
+	{
+		if (edge.irregular)
+		{
+			usedPoints.insert(usedPoints.end(), irregularPoints.begin() + edge.offset, irregularPoints.begin() + edge.offset + edge.size);
+			edge.offset = usedPoints.size() - edge.size;
+		}
+		else
+		{
+			size_t bytes = getNumberOfCodeBytes(edge.size);
+			usedCodes.insert(usedCodes.end(), chainCodes.begin() + edge.offset, chainCodes.begin() + edge.offset + bytes);
+			edge.offset = usedCodes.size() - bytes;
+		}
+	}
+
+	chainCodes = std::move(usedCodes);
+	irregularPoints = std::move(usedPoints);
+	unusedBytes = 0;
+}
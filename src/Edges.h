@@ -1,22 +1,200 @@
 #ifndef EDGES_H
 #define EDGES_H
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
 #include <opencv2/core.hpp>
 
+/** Read-only view of the points of one edge, valid until the edges are modified. With the chain code storage, the
+ *  points are decoded while iterating. Start point, end point and size are available in constant time.
+ */
+class EdgePoints
+{
+public:
+	/** Location of the points of one edge, exactly one of points, codes, x16/y16 and x32/y32 is set.
+	 */
+	struct Source
+	{
+		const cv::Point *points = nullptr;	//!< Points (Points storage or irregular edge).
+		const uint8_t *codes = nullptr;		//!< Chain codes of the edge (chain code storage).
+		const uint16_t *x16 = nullptr;		//!< Coordinates of the edge (pool storage, 16 bit).
+		const uint16_t *y16 = nullptr;
+		const int32_t *x32 = nullptr;		//!< Coordinates of the edge (pool storage, 32 bit).
+		const int32_t *y32 = nullptr;
+	};
+
+	/** Forward iterator over the points of an edge.
+	 */
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = cv::Point;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const cv::Point *;
+		using reference = const cv::Point &;
+
+		Iterator() : index(0), count(0) {}
+		Iterator(const Source &source, cv::Point start, size_t index, size_t count) :
+			source(source), index(index), count(count), point(start) {}
+
+		const cv::Point &operator*() const { return source.points ? source.points[index] : point; }
+		const cv::Point *operator->() const { return &**this; }
+		Iterator &operator++()
+		{
+			index++;
+
+			if (source.points || index >= count)
+			{
+				return *this;
+			}
+
+			if (source.x16)
+			{
+				point = cv::Point(source.x16[index], source.y16[index]);
+			}
+			else if (source.x32)
+			{
+				point = cv::Point(source.x32[index], source.y32[index]);
+			}
+			else
+			{
+				decodeStep();
+			}
+
+			return *this;
+		}
+		Iterator operator++(int) { Iterator previous = *this; ++*this; return previous; }
+		bool operator==(const Iterator &other) const { return index == other.index; }
+		bool operator!=(const Iterator &other) const { return index != other.index; }
+
+	private:
+		Source source;		//!< Points of the edge.
+		size_t index;		//!< Index of the current point.
+		size_t count;		//!< Number of points of the edge.
+		cv::Point point;	//!< Current point (all storages except points).
+
+		/** Adds the step to the point at index to point (chain code storage).
+		 */
+		void decodeStep();
+	};
+
+	EdgePoints() : count(0) {}
+	EdgePoints(const cv::Point *points, size_t count) : count(count)
+	{
+		source.points = points;
+
+		if (count > 0)
+		{
+			firstPoint = points[0];
+			lastPoint = points[count - 1];
+		}
+	}
+	EdgePoints(const uint8_t *codes, cv::Point firstPoint, cv::Point lastPoint, size_t count) :
+		count(count), firstPoint(firstPoint), lastPoint(lastPoint)
+	{
+		source.codes = codes;
+	}
+	EdgePoints(const uint16_t *x, const uint16_t *y, size_t count) : count(count)
+	{
+		source.x16 = x;
+		source.y16 = y;
+
+		if (count > 0)
+		{
+			firstPoint = cv::Point(x[0], y[0]);
+			lastPoint = cv::Point(x[count - 1], y[count - 1]);
+		}
+	}
+	EdgePoints(const int32_t *x, const int32_t *y, size_t count) : count(count)
+	{
+		source.x32 = x;
+		source.y32 = y;
+
+		if (count > 0)
+		{
+			firstPoint = cv::Point(x[0], y[0]);
+			lastPoint = cv::Point(x[count - 1], y[count - 1]);
+		}
+	}
+
+	Iterator begin() const { return Iterator(source, firstPoint, 0, count); }
+	Iterator end() const { return Iterator(source, firstPoint, count, count); }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const cv::Point &front() const { return firstPoint; }
+	const cv::Point &back() const { return lastPoint; }
+
+	/** Copy of the points.
+	 */
+	std::vector<cv::Point> toVector() const;
+
+private:
+	Source source;
+	size_t count;
+	cv::Point firstPoint;
+	cv::Point lastPoint;
+};
+
 class Edges
 {
 public:
+	/** Data structures used for the edges.
+	 */
+	enum class Storage
+	{
+		Points,		//!< One std::vector of points per edge.
+		ChainCode,	//!< Start and end point per edge and a 3 bit Freeman chain code per step, all codes in one buffer
+					//!< (edges with steps to non-neighbors keep their points). Needs much less memory for long edges.
+		Pool		//!< Offset and size per edge, the x and y coordinates of all edges in two arrays (16 bit as long as
+					//!< all coordinates are in [0, 65535], otherwise 32 bit). One allocation for all points.
+	};
 
 	Edges() = default;
 
+	/** Change the data structure, the edges are converted.
+	 */
+	void setStorage(Storage storage);
+
+	/** Data structure used for the edges.
+	 */
+	Storage getStorage() const;
+
+	/** Approximate heap memory used by the edges in bytes.
+	 */
+	size_t getMemoryUsage() const;
+
 	void clear();
 
 	void pushBack(std::vector<cv::Point> edge);
 
 	void insert(int edgeId, std::vector<cv::Point> edge);
 
+	/** Replace the points of an edge. Edges must only be overwritten concurrently with the Points storage.
+	 */
 	void overwrite(int edgeId, std::vector<cv::Point> edge);
 
+	/** Move the points of edge otherId to the front or back of edge edgeId, edge otherId becomes empty. No points are
+	 *  copied, the joined edge is a list of pieces of the stored edges until flattenJoinedEdges is called, so the time
+	 *  depends only on the number of pieces of otherId. Size, start and end point of joined edges are available in
+	 *  constant time, getEdge and getPointsAlongEdgeFromPoint collect their points from the pieces.
+	 *  @edgeId			Edge which is extended.
+	 *  @otherId		Edge which is moved into edgeId.
+	 *  @prepend		Insert the points of otherId before the points of edgeId (otherwise after them).
+	 *  @reverseOther	Insert the points of otherId in reverse order.
+	 *  @skipFront		Number of points at the start of otherId (before reversing) which are left out.
+	 *  @skipBack		Number of points at the end of otherId (before reversing) which are left out.
+	 */
+	void join(int edgeId, int otherId, bool prepend, bool reverseOther, size_t skipFront, size_t skipBack);
+
+	/** Store the points of all joined edges. Must be called before getPoints is used for a joined edge (operations
+	 *  which move edges, such as insert and eraseEmptyEdges, call it).
+	 */
+	void flattenJoinedEdges();
+
 	void popBack();
 
 	bool isClosed(int edgeId);
@@ -24,22 +202,38 @@ public:
 	bool isThreePixelL(int edgeId);
 
 	/** Erases all empty edges from the edge vector
+	 *  @returns		New edgeId of each previous edgeId (-1 for erased edges).
 	 */
-	void eraseEmptyEdges();
+	std::vector<int> eraseEmptyEdges();
 
 	void clearEdge(int edgeId);
 
 	void reverseAll();
 
-	const std::vector<cv::Point> &getEdge(int index) const;
+	/** Copy of the points of the edge with edgeId (use getPoints to read them without copying).
+	 */
+	std::vector<cv::Point> getEdge(int index) const;
+
+	/** Read-only view of the points of the edge with edgeId, valid until the edges are modified. The edge must not be
+	 *  joined since the last call of flattenJoinedEdges.
+	 */
+	EdgePoints getPoints(int edgeId) const;
 
 	size_t size() const;
 
-	const std::vector<std::vector<cv::Point>> &getEdges() const;
+	/** Get Edge Id of given edge (the first edge with the same points, size() if there is none).
+	 */
+	int getEdgeId(const std::vector<cv::Point> &edge);
 
-	/** Get Edge Id of given edge.
+	/** Get Edge Id of the edge with the given index (the first edge with the same points, index itself if there is none
+	 *  before it). Compares only edges of the same size, without copying the points.
 	 */
-	int getEdgeId(std::vector<cv::Point> edge);
+	int getEdgeId(int index);
+
+	/** Get Edge Id of every edge, as returned by getEdgeId for its points (identical edges get the Id of the first of
+	 *  them). The edges are compared by a hash of their points in a single pass.
+	 */
+	std::vector<int> getEdgeIds();
 
 	/** Get the start point of edge with edgeId.
 	 */
@@ -53,7 +247,13 @@ public:
 	 */
 	size_t getEdgeSize(int edgeId) const;
 
-	void eraseEdge(std::vector<cv::Point> edge);
+	/** Erase the first edge with the given points (the edge has to exist).
+	 */
+	void eraseEdge(const std::vector<cv::Point> &edge);
+
+	/** Erase the edge with edgeId, the following edges move forward by one.
+	 */
+	void eraseEdge(int edgeId);
 
 	/** Get n points from the edge starting from the given start or end point.
 	 * @edgeId: EdgeId of the edge which should be used.
@@ -63,10 +263,147 @@ public:
 	std::vector<cv::Point> getPointsAlongEdgeFromPoint(int edgeId, cv::Point point, size_t numberPixels);
 
 private:
+	/** Edge of the chain code storage.
+	 */
+	struct ChainCodeEdge
+	{
+		cv::Point start;	//!< First point.
+		cv::Point end;		//!< Last point.
+		uint32_t size : 31;		//!< Number of points.
+		uint32_t irregular : 1;	//!< Set if the edge has steps to non-neighbors (stored as points).
+		uint32_t offset;		//!< Offset of the chain codes in chainCodes, or of the points in irregularPoints.
+	};
+
+	/** Edge of the pool storage.
+	 */
+	struct PoolEdge
+	{
+		uint32_t offset;	//!< Index of the first point in the coordinate arrays.
+		uint32_t size;		//!< Number of points.
+	};
+
+	/** Stored points [begin, end) of the edge with edgeId slot, part of a joined edge.
+	 */
+	struct Piece
+	{
+		int32_t slot;		//!< EdgeId under which the points are stored.
+		uint32_t begin;		//!< Index of the first stored point of the piece.
+		uint32_t end;		//!< Index after the last stored point of the piece.
+		bool reversed;		//!< Set if the piece runs from the stored point end - 1 down to begin.
+		int32_t previous;	//!< Index of the previous piece in pieces, NO_PIECE for the first piece.
+		int32_t next;		//!< Index of the next piece in pieces, NO_PIECE for the last piece.
+	};
+
+	/** State of an edgeId with respect to join.
+	 */
+	enum class JoinState : uint8_t
+	{
+		Stored,		//!< The points are stored under the edgeId.
+		Joined,		//!< The points are the list of pieces of the edge (the edge has been extended by join).
+		Absorbed	//!< The edge has been moved into another edge, the stored points are a piece of that edge.
+	};
+
+	/** Edge in the join table.
+	 */
+	struct JoinedEdge
+	{
+		JoinState state;
+		int32_t head;		//!< First piece (joined edges).
+		int32_t tail;		//!< Last piece (joined edges).
+		size_t size;		//!< Number of points (joined edges).
+		cv::Point start;	//!< First point (joined edges).
+		cv::Point end;		//!< Last point (joined edges).
+	};
+
+	static constexpr int32_t NO_PIECE = -1;
+
+	Storage storage = Storage::Points; //!< Data structure used for the edges.
+
 	/*  Vector with all traced edges. Each edge is a vector of points (std::vector<cv::Point>).
-	 *  Position of each edge in data corresponds to edgeId.
+	 *  Position of each edge in data corresponds to edgeId (Points storage).
 	 */
 	std::vector<std::vector<cv::Point>> data;
+
+	std::vector<ChainCodeEdge> chainCodeEdges;	//!< Edges by edgeId (chain code storage).
+	std::vector<uint8_t> chainCodes;			//!< Chain codes of all edges, 3 bits per step (chain code storage).
+	std::vector<cv::Point> irregularPoints;		//!< Points of edges with steps to non-neighbors (chain code storage).
+
+	std::vector<PoolEdge> poolEdges;	//!< Edges by edgeId (pool storage).
+	std::vector<uint16_t> poolX16;		//!< Coordinates of all edges while they fit in 16 bit (pool storage).
+	std::vector<uint16_t> poolY16;
+	std::vector<int32_t> poolX32;		//!< Coordinates of all edges otherwise (pool storage).
+	std::vector<int32_t> poolY32;
+	bool widePool = false;				//!< Set if the pool uses the 32 bit coordinates.
+
+	size_t unusedBytes = 0;				//!< Bytes of overwritten edges in the buffers of the chain code or pool storage.
+
+	std::vector<JoinedEdge> joinedEdges;	//!< Join state by edgeId, empty if no edge has been joined since the last flattening.
+	std::vector<Piece> pieces;				//!< Pieces of all joined edges.
+
+	/** Checks if the points of the edge are not (only) stored under its edgeId.
+	 */
+	bool isJoined(int edgeId) const;
+
+	/** Turns a stored edge into a joined edge with one piece.
+	 */
+	void startJoin(int edgeId);
+
+	/** Appends up to count points of a piece to points, starting at its first point (or its last point if fromBack).
+	 */
+	void collectPiecePoints(const Piece &piece, bool fromBack, size_t count, std::vector<cv::Point> &points) const;
+
+	/** Appends up to count of the stored points [begin, end) of an edge to points, starting at begin (or at end - 1 if
+	 *  backward). Chain codes are decoded from the nearer end point.
+	 */
+	void collectStoredPoints(int edgeId, size_t begin, size_t end, bool backward, size_t count, std::vector<cv::Point> &points) const;
+
+	/** Points of a joined edge.
+	 */
+	std::vector<cv::Point> getJoinedEdge(int edgeId) const;
+
+	/** Replace a joined edge by a stored edge. The stored points of its pieces are released.
+	 */
+	void storeJoinedEdge(int edgeId, std::vector<cv::Point> edge);
+
+	/** Storage operations on the points stored under an edgeId (the edge must not be joined).
+	 */
+	void overwriteStored(int edgeId, std::vector<cv::Point> edge);
+	void clearStored(int edgeId);
+	EdgePoints getStoredPoints(int edgeId) const;
+	size_t getStoredSize(int edgeId) const;
+
+	/** Encodes an edge at the end of chainCodes or irregularPoints (chain code storage).
+	 */
+	ChainCodeEdge encode(const std::vector<cv::Point> &edge);
+
+	/** Appends the points of an edge to the coordinate arrays (pool storage).
+	 */
+	PoolEdge append(const std::vector<cv::Point> &edge);
+
+	/** Switches the pool to 32 bit coordinates.
+	 */
+	void widenPool();
+
+	/** Number of points in the coordinate arrays (pool storage).
+	 */
+	size_t getPoolSize() const;
+
+	/** Point at given index of the coordinate arrays (pool storage).
+	 */
+	cv::Point getPoolPoint(size_t index) const;
+
+	/** Bytes used by the codes or points of an edge in the buffers.
+	 */
+	size_t getNumberOfBytes(const ChainCodeEdge &edge) const;
+	size_t getNumberOfBytes(const PoolEdge &edge) const;
+
+	/** Marks bytes of the buffers as unused and compacts the buffers if more than half of them is unused.
+	 */
+	void release(size_t bytes);
+
+	/** Rewrites the buffers of the chain code or pool storage without unused bytes, in the order of the edgeIds.
+	 */
+	void compact();
 };
 
 #endif // EDGES_H
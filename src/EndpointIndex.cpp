@@ -0,0 +1,84 @@
+#include "EndpointIndex.h"
+
+#include <algorithm>
+
+EndpointIndex::EndpointIndex(int cols, int rows, int cellSize)
+{
+	EndpointIndex::cellSize = std::max(1, cellSize);
+	gridCols = (std::max(0, cols) + EndpointIndex::cellSize - 1) / EndpointIndex::cellSize;
+	gridRows = (std::max(0, rows) + EndpointIndex::cellSize - 1) / EndpointIndex::cellSize;
+	cells.resize(static_cast<size_t>(gridCols) * gridRows);
+}
+
+std::vector<cv::Point> *EndpointIndex::getCell(cv::Point p)
+{
+	if (p.x < 0 || p.y < 0 || p.x / cellSize >= gridCols || p.y / cellSize >= gridRows)
+	{
+		return nullptr;
+	}
+
+	return &cells[static_cast<size_t>(p.y / cellSize) * gridCols + p.x / cellSize];
+}
+
+void EndpointIndex::insert(cv::Point p)
+{
+	std::vector<cv::Point> *cell = getCell(p);
+
+	if (cell && std::find(cell->begin(), cell->end(), p) == cell->end())
+	{
+		cell->push_back(p);
+	}
+}
+
+void EndpointIndex::remove(cv::Point p)
+{
+	std::vector<cv::Point> *cell = getCell(p);
+
+	if (cell)
+	{
+		auto it = std::find(cell->begin(), cell->end(), p);
+		if (it != cell->end())
+		{
+			// The order within a cell does not matter, queries sort their result
+			*it = cell->back();
+			cell->pop_back();
+		}
+	}
+}
+
+void EndpointIndex::query(cv::Point p, int radius, std::vector<cv::Point> &points) const
+{
+	points.clear();
+
+	int minX = std::max(0, p.x - radius);
+	int minY = std::max(0, p.y - radius);
+	int maxX = p.x + radius;
+	int maxY = p.y + radius;
+
+	if (maxX < minX || maxY < minY)
+	{
+		return;
+	}
+
+	int lastCellX = std::min(gridCols - 1, maxX / cellSize);
+	int lastCellY = std::min(gridRows - 1, maxY / cellSize);
+
+	for (int cellY = minY / cellSize; cellY <= lastCellY; cellY++)
+	{
+		for (int cellX = minX / cellSize; cellX <= lastCellX; cellX++)
+		{
+			for (const cv::Point &point : cells[static_cast<size_t>(cellY) * gridCols + cellX])
+			{
+				if (point.x >= minX && point.x <= maxX && point.y >= minY && point.y <= maxY)
+				{
+					points.push_back(point);
+				}
+			}
+		}
+	}
+
+	std::sort(points.begin(), points.end(), [](const cv::Point &a, const cv::Point &b)
+	{
+		return (a.y < b.y) || (a.y == b.y && a.x < b.x);
+	});
+}
@@ -0,0 +1,45 @@
+#ifndef ENDPOINTINDEX_H
+#define ENDPOINTINDEX_H
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/** Uniform grid over the start and end points of the edges, so that the endpoints near a point can be found without
+ *  scanning every pixel of the search area. Each cell stores the endpoints inside it (each point once).
+ */
+class EndpointIndex
+{
+public:
+	/** Creates an empty index.
+	 *  @cols			Width of the image.
+	 *  @rows			Height of the image.
+	 *  @cellSize		Side length of the grid cells (queries with a radius of about cellSize touch 3x3 cells).
+	 */
+	EndpointIndex(int cols, int rows, int cellSize);
+
+	/** Adds the point (nothing happens if it is already in the index or outside the image).
+	 */
+	void insert(cv::Point p);
+
+	/** Removes the point (nothing happens if it is not in the index).
+	 */
+	void remove(cv::Point p);
+
+	/** Finds all points in the square window around p.
+	 *  @p				Center of the window.
+	 *  @radius			Maximum distance to p along x and y.
+	 *  @points			Found points in raster order (the content is replaced).
+	 */
+	void query(cv::Point p, int radius, std::vector<cv::Point> &points) const;
+
+private:
+	int cellSize;
+	int gridCols;
+	int gridRows;
+	std::vector<std::vector<cv::Point>> cells;
+
+	std::vector<cv::Point> *getCell(cv::Point p);
+};
+
+#endif // ENDPOINTINDEX_H
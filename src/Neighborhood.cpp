@@ -0,0 +1,240 @@
+#include "Neighborhood.h"
+
+#include "Parallel.h"
+
+#if defined(__AVX512BW__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	constexpr int ROWS_PER_BAND = 64; // Number of rows processed by one thread at a time
+
+	/** Binary code of a pixel at the image border, neighbors outside of the image are empty.
+	 */
+	uint8_t getBinaryCodeAtBorder(const cv::Mat &img, int x, int y)
+	{
+		uint8_t code = 0;
+
+		for (int i = 0; i < 8; i++)
+		{
+			int nx = x + detail::NEIGHBOR_DX[i];
+			int ny = y + detail::NEIGHBOR_DY[i];
+
+			if (nx >= 0 && ny >= 0 && nx < img.cols && ny < img.rows && img.at<uchar>(ny, nx) > 0)
+			{
+				code |= detail::NEIGHBOR_BITS[i];
+			}
+		}
+
+		return code;
+	}
+
+	/** Scalar classification of one pixel at the image border.
+	 */
+	void classifyBorderPixel(const cv::Mat &img, uchar *codes, uchar *mask, int x, int y)
+	{
+		uint8_t code = getBinaryCodeAtBorder(img, x, y);
+		codes[x] = code;
+		mask[x] = (img.at<uchar>(y, x) > 0 && NEIGHBORHOOD_TABLE[code].isCluster) ? CLUSTER_POINT : 0;
+	}
+
+	/** Scalar classification of the pixels [x, cols) of one row (all neighbors must be inside of the image).
+	 */
+	void classifyRowScalar(const uchar *middle, size_t step, uchar *codes, uchar *mask, int x, int cols)
+	{
+		for (; x < cols; x++)
+		{
+			uint8_t code = getBinaryCode(middle + x, step);
+			codes[x] = code;
+			mask[x] = (middle[x] > 0 && NEIGHBORHOOD_TABLE[code].isCluster) ? CLUSTER_POINT : 0;
+		}
+	}
+
+#if defined(__AVX512BW__)
+
+	constexpr int VECTOR_WIDTH = 64;
+
+	/** Classification of one row with AVX-512, returns the number of processed pixels.
+	 */
+	int classifyRowSimd(const uchar *middle, size_t step, uchar *codes, uchar *mask, int cols)
+	{
+		const uchar *top = middle - step;
+		const uchar *bottom = middle + step;
+		const __m512i zero = _mm512_setzero_si512();
+
+		int x = 0;
+		for (; x + VECTOR_WIDTH <= cols; x += VECTOR_WIDTH)
+		{
+			// Occupancy of the pixels and their neighbors (one bit per pixel)
+			__mmask64 c = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(middle + x), zero);
+			__mmask64 tl = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(top + x - 1), zero);
+			__mmask64 tc = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(top + x), zero);
+			__mmask64 tr = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(top + x + 1), zero);
+			__mmask64 mr = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(middle + x + 1), zero);
+			__mmask64 br = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(bottom + x + 1), zero);
+			__mmask64 bc = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(bottom + x), zero);
+			__mmask64 bl = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(bottom + x - 1), zero);
+			__mmask64 ml = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(middle + x - 1), zero);
+
+			__m512i code = _mm512_maskz_set1_epi8(tl, static_cast<char>(128));
+			code = _mm512_or_si512(code, _mm512_maskz_set1_epi8(tc, 64));
+			code = _mm512_or_si512(code, _mm512_maskz_set1_epi8(tr, 32));
+			code = _mm512_or_si512(code, _mm512_maskz_set1_epi8(mr, 16));
+			code = _mm512_or_si512(code, _mm512_maskz_set1_epi8(br, 8));
+			code = _mm512_or_si512(code, _mm512_maskz_set1_epi8(bc, 4));
+			code = _mm512_or_si512(code, _mm512_maskz_set1_epi8(bl, 2));
+			code = _mm512_or_si512(code, _mm512_maskz_set1_epi8(ml, 1));
+			_mm512_storeu_si512(codes + x, code);
+
+			// Four-clusters and number of direct neighbors (diagonal neighbors only without adjacent orthogonal neighbors)
+			__mmask64 fourCluster = (tl & tc & ml) | (tc & tr & mr) | (mr & br & bc) | (bc & bl & ml);
+
+			__m512i count = _mm512_maskz_set1_epi8(tc, 1);
+			count = _mm512_add_epi8(count, _mm512_maskz_set1_epi8(mr, 1));
+			count = _mm512_add_epi8(count, _mm512_maskz_set1_epi8(bc, 1));
+			count = _mm512_add_epi8(count, _mm512_maskz_set1_epi8(ml, 1));
+			count = _mm512_add_epi8(count, _mm512_maskz_set1_epi8(tl & ~tc & ~ml, 1));
+			count = _mm512_add_epi8(count, _mm512_maskz_set1_epi8(tr & ~tc & ~mr, 1));
+			count = _mm512_add_epi8(count, _mm512_maskz_set1_epi8(br & ~mr & ~bc, 1));
+			count = _mm512_add_epi8(count, _mm512_maskz_set1_epi8(bl & ~bc & ~ml, 1));
+			__mmask64 moreThanTwo = _mm512_cmpgt_epi8_mask(count, _mm512_set1_epi8(2));
+
+			_mm512_storeu_si512(mask + x, _mm512_maskz_set1_epi8(c & (fourCluster | moreThanTwo), static_cast<char>(CLUSTER_POINT)));
+		}
+
+		return x;
+	}
+
+#elif defined(__AVX2__) || defined(__SSE2__)
+
+#if defined(__AVX2__)
+	typedef __m256i Vector;
+	constexpr int VECTOR_WIDTH = 32;
+	inline Vector load(const uchar *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+	inline void store(uchar *p, Vector v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+	inline Vector set1(char value) { return _mm256_set1_epi8(value); }
+	inline Vector bitAnd(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+	inline Vector bitAndNot(Vector a, Vector b) { return _mm256_andnot_si256(a, b); } // ~a & b
+	inline Vector bitOr(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+	inline Vector add(Vector a, Vector b) { return _mm256_add_epi8(a, b); }
+	inline Vector greaterThan(Vector a, Vector b) { return _mm256_cmpgt_epi8(a, b); }
+	inline Vector isZero(Vector a) { return _mm256_cmpeq_epi8(a, _mm256_setzero_si256()); }
+#else
+	typedef __m128i Vector;
+	constexpr int VECTOR_WIDTH = 16;
+	inline Vector load(const uchar *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+	inline void store(uchar *p, Vector v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+	inline Vector set1(char value) { return _mm_set1_epi8(value); }
+	inline Vector bitAnd(Vector a, Vector b) { return _mm_and_si128(a, b); }
+	inline Vector bitAndNot(Vector a, Vector b) { return _mm_andnot_si128(a, b); } // ~a & b
+	inline Vector bitOr(Vector a, Vector b) { return _mm_or_si128(a, b); }
+	inline Vector add(Vector a, Vector b) { return _mm_add_epi8(a, b); }
+	inline Vector greaterThan(Vector a, Vector b) { return _mm_cmpgt_epi8(a, b); }
+	inline Vector isZero(Vector a) { return _mm_cmpeq_epi8(a, _mm_setzero_si128()); }
+#endif
+
+	/** Classification of one row with AVX2 or SSE2, returns the number of processed pixels.
+	 */
+	int classifyRowSimd(const uchar *middle, size_t step, uchar *codes, uchar *mask, int cols)
+	{
+		const uchar *top = middle - step;
+		const uchar *bottom = middle + step;
+		const Vector ones = set1(static_cast<char>(0xFF));
+
+		int x = 0;
+		for (; x + VECTOR_WIDTH <= cols; x += VECTOR_WIDTH)
+		{
+			// Occupancy of the pixels and their neighbors (0xFF if occupied, 0 otherwise)
+			Vector c = bitAndNot(isZero(load(middle + x)), ones);
+			Vector tl = bitAndNot(isZero(load(top + x - 1)), ones);
+			Vector tc = bitAndNot(isZero(load(top + x)), ones);
+			Vector tr = bitAndNot(isZero(load(top + x + 1)), ones);
+			Vector mr = bitAndNot(isZero(load(middle + x + 1)), ones);
+			Vector br = bitAndNot(isZero(load(bottom + x + 1)), ones);
+			Vector bc = bitAndNot(isZero(load(bottom + x)), ones);
+			Vector bl = bitAndNot(isZero(load(bottom + x - 1)), ones);
+			Vector ml = bitAndNot(isZero(load(middle + x - 1)), ones);
+
+			Vector code = bitAnd(tl, set1(static_cast<char>(128)));
+			code = bitOr(code, bitAnd(tc, set1(64)));
+			code = bitOr(code, bitAnd(tr, set1(32)));
+			code = bitOr(code, bitAnd(mr, set1(16)));
+			code = bitOr(code, bitAnd(br, set1(8)));
+			code = bitOr(code, bitAnd(bc, set1(4)));
+			code = bitOr(code, bitAnd(bl, set1(2)));
+			code = bitOr(code, bitAnd(ml, set1(1)));
+			store(codes + x, code);
+
+			// Four-clusters are always located in corners
+			Vector fourCluster = bitAnd(bitAnd(tl, tc), ml);
+			fourCluster = bitOr(fourCluster, bitAnd(bitAnd(tc, tr), mr));
+			fourCluster = bitOr(fourCluster, bitAnd(bitAnd(mr, br), bc));
+			fourCluster = bitOr(fourCluster, bitAnd(bitAnd(bc, bl), ml));
+
+			// Number of direct neighbors: occupied pixels are -1 (0xFF), so the sum is the negative count
+			Vector count = add(add(tc, mr), add(bc, ml));
+			count = add(count, bitAndNot(ml, bitAndNot(tc, tl)));
+			count = add(count, bitAndNot(mr, bitAndNot(tc, tr)));
+			count = add(count, bitAndNot(bc, bitAndNot(mr, br)));
+			count = add(count, bitAndNot(ml, bitAndNot(bc, bl)));
+			Vector moreThanTwo = greaterThan(set1(-2), count);
+
+			store(mask + x, bitAnd(c, bitOr(fourCluster, moreThanTwo)));
+		}
+
+		return x;
+	}
+
+#else
+
+	int classifyRowSimd(const uchar *, size_t, uchar *, uchar *, int)
+	{
+		return 0;
+	}
+
+#endif
+
+} // end namespace
+
+void classifyNeighborhoods(const cv::Mat &img, cv::Mat &binaryCodes, cv::Mat &ambiguityMask, int numberOfThreads)
+{
+	int rows = img.rows;
+	int cols = img.cols;
+
+	binaryCodes.create(rows, cols, CV_8UC1);
+	ambiguityMask.create(rows, cols, CV_8UC1);
+
+	size_t step = img.step;
+	int numberOfBands = (rows + ROWS_PER_BAND - 1) / ROWS_PER_BAND;
+
+	// Rows are independent of each other
+	parallelFor(numberOfBands, resolveNumberOfThreads(numberOfThreads), [&](int band, int)
+	{
+		for (int y = band * ROWS_PER_BAND; y < std::min(rows, (band + 1) * ROWS_PER_BAND); y++)
+		{
+			uchar *codes = binaryCodes.ptr<uchar>(y);
+			uchar *mask = ambiguityMask.ptr<uchar>(y);
+
+			// First and last row and column: bounds checks instead of a padded copy of the image
+			if (y == 0 || y == rows - 1 || cols < 3)
+			{
+				for (int x = 0; x < cols; x++)
+				{
+					classifyBorderPixel(img, codes, mask, x, y);
+				}
+
+				continue;
+			}
+
+			const uchar *middle = img.ptr<uchar>(y);
+			classifyBorderPixel(img, codes, mask, 0, y);
+
+			// Vectorized main part, remaining pixels are processed with scalar code
+			int x = 1 + classifyRowSimd(middle + 1, step, codes + 1, mask + 1, cols - 2);
+			classifyRowScalar(middle, step, codes, mask, x, cols - 1);
+
+			classifyBorderPixel(img, codes, mask, cols - 1, y);
+		}
+	});
+}
@@ -0,0 +1,170 @@
+#ifndef NEIGHBORHOOD_H
+#define NEIGHBORHOOD_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <opencv2/core.hpp>
+
+/*
+Binary code of the 3x3 neighborhood of a pixel p, 7 = most significant bit
+7 6 5
+0 p 4
+1 2 3
+*/
+
+// Four-clusters (2x2 blocks including p) are always located in corners
+constexpr uint8_t UPPER_LEFT	= 0b11000001; // 193
+constexpr uint8_t UPPER_RIGHT	= 0b01110000; // 112
+constexpr uint8_t LOWER_RIGHT	= 0b00011100; // 28
+constexpr uint8_t LOWER_LEFT	= 0b00000111; // 7
+
+/** Value of cluster points in the ambiguityMask (see classifyNeighborhoods).
+ */
+constexpr uint8_t CLUSTER_POINT = 255;
+
+/** Direct neighbors (as in our sense) and cluster status of a pixel, which only depend on its binary code.
+ */
+struct NeighborhoodInfo
+{
+	uint8_t numberOfNeighbors;	//!< Number of direct neighbors.
+	bool isCluster;				//!< True if a pixel with this neighborhood is a cluster point.
+	int8_t dx[8];				//!< Horizontal offsets of the direct neighbors, clockwise from top left.
+	int8_t dy[8];				//!< Vertical offsets of the direct neighbors, clockwise from top left.
+};
+
+/** Check if 3x3 region contains at least one four-cluster based on its binary code.
+ */
+constexpr bool containsFourCluster(uint8_t binaryCode)
+{
+	return ((binaryCode & UPPER_LEFT) == UPPER_LEFT ||
+		    (binaryCode & UPPER_RIGHT) == UPPER_RIGHT ||
+		    (binaryCode & LOWER_RIGHT) == LOWER_RIGHT ||
+		    (binaryCode & LOWER_LEFT) == LOWER_LEFT);
+}
+
+/** Returns the binary code of a pixel whose neighbors are all inside of the image (no bounds checks).
+ *  @center			Pointer to the pixel.
+ *  @step			Row step of the image in bytes.
+ */
+inline uint8_t getBinaryCode(const unsigned char *center, size_t step)
+{
+	const unsigned char *top = center - step;
+	const unsigned char *bottom = center + step;
+
+	return static_cast<uint8_t>(
+		((top[-1] > 0) << 7) | ((top[0] > 0) << 6) | ((top[1] > 0) << 5) | ((center[1] > 0) << 4) |
+		((bottom[1] > 0) << 3) | ((bottom[0] > 0) << 2) | ((bottom[-1] > 0) << 1) | (center[-1] > 0));
+}
+
+namespace detail
+{
+	// Bit of each neighbor position, clockwise from top left (same order as the direct neighbors)
+	constexpr uint8_t NEIGHBOR_BITS[8] = {128, 64, 32, 16, 8, 4, 2, 1};
+	constexpr int8_t NEIGHBOR_DX[8] = {-1, 0, 1, 1, 1, 0, -1, -1};
+	constexpr int8_t NEIGHBOR_DY[8] = {-1, -1, -1, 0, 1, 1, 1, 0};
+
+	constexpr std::array<NeighborhoodInfo, 256> makeNeighborhoodTable()
+	{
+		std::array<NeighborhoodInfo, 256> table{};
+
+		for (int code = 0; code < 256; code++)
+		{
+			NeighborhoodInfo info{};
+
+			for (int i = 0; i < 8; i++)
+			{
+				if (!(code & NEIGHBOR_BITS[i]))
+				{
+					continue;
+				}
+
+				// Diagonal neighbors (even positions) are only direct neighbors if both adjacent orthogonal neighbors are empty
+				if (i % 2 == 0 && ((code & NEIGHBOR_BITS[(i + 7) % 8]) || (code & NEIGHBOR_BITS[i + 1])))
+				{
+					continue;
+				}
+
+				info.dx[info.numberOfNeighbors] = NEIGHBOR_DX[i];
+				info.dy[info.numberOfNeighbors] = NEIGHBOR_DY[i];
+				info.numberOfNeighbors++;
+			}
+
+			info.isCluster = containsFourCluster(static_cast<uint8_t>(code)) || info.numberOfNeighbors > 2;
+			table[code] = info;
+		}
+
+		return table;
+	}
+
+	/** Reference implementation of the direct neighbors on an explicit 3x3 patch (one if-check per neighbor), used
+	 *  to verify the table at compile time.
+	 */
+	constexpr bool verifyNeighborhoodTable(const std::array<NeighborhoodInfo, 256> &table)
+	{
+		for (int code = 0; code < 256; code++)
+		{
+			bool img[3][3] = {{(code & 128) != 0, (code & 64) != 0, (code & 32) != 0},
+							  {(code & 1) != 0, true, (code & 16) != 0},
+							  {(code & 2) != 0, (code & 4) != 0, (code & 8) != 0}};
+
+			int x[8] = {};
+			int y[8] = {};
+			int n = 0;
+
+			if (img[0][0] && !(img[0][1] || img[1][0])) { x[n] = -1; y[n] = -1; n++; } // top left
+			if (img[0][1]) { x[n] = 0; y[n] = -1; n++; } // top center
+			if (img[0][2] && !(img[0][1] || img[1][2])) { x[n] = 1; y[n] = -1; n++; } // top right
+			if (img[1][2]) { x[n] = 1; y[n] = 0; n++; } // middle right
+			if (img[2][2] && !(img[1][2] || img[2][1])) { x[n] = 1; y[n] = 1; n++; } // bottom right
+			if (img[2][1]) { x[n] = 0; y[n] = 1; n++; } // bottom center
+			if (img[2][0] && !(img[2][1] || img[1][0])) { x[n] = -1; y[n] = 1; n++; } // bottom left
+			if (img[1][0]) { x[n] = -1; y[n] = 0; n++; } // middle left
+
+			if (table[code].numberOfNeighbors != n)
+			{
+				return false;
+			}
+
+			for (int i = 0; i < n; i++)
+			{
+				if (table[code].dx[i] != x[i] || table[code].dy[i] != y[i])
+				{
+					return false;
+				}
+			}
+
+			if (table[code].isCluster != (containsFourCluster(static_cast<uint8_t>(code)) || n > 2))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+} // end namespace detail
+
+/** Lookup table indexed by the binary code of a pixel, computed at compile time.
+ */
+inline constexpr std::array<NeighborhoodInfo, 256> NEIGHBORHOOD_TABLE = detail::makeNeighborhoodTable();
+
+static_assert(detail::verifyNeighborhoodTable(NEIGHBORHOOD_TABLE), "Neighborhood table differs from the direct neighbor definition");
+static_assert(NEIGHBORHOOD_TABLE[0].numberOfNeighbors == 0 && !NEIGHBORHOOD_TABLE[0].isCluster, "Isolated pixel");
+static_assert(NEIGHBORHOOD_TABLE[0b01000100].numberOfNeighbors == 2 && !NEIGHBORHOOD_TABLE[0b01000100].isCluster, "Vertical line");
+static_assert(NEIGHBORHOOD_TABLE[0b11000000].numberOfNeighbors == 1, "Diagonal neighbor next to an orthogonal neighbor");
+static_assert(NEIGHBORHOOD_TABLE[0b01010100].isCluster, "T-junction");
+static_assert(NEIGHBORHOOD_TABLE[UPPER_LEFT].isCluster && NEIGHBORHOOD_TABLE[LOWER_RIGHT].isCluster, "Four-cluster");
+
+/** Computes the binary code of every pixel and marks all ambiguity (cluster) points in one pass over the image.
+ *  Whole rows are processed with AVX-512, AVX2 or SSE2 instructions (depending on the target), remaining pixels with scalar code.
+ *  Pixels outside of the image are empty, the image is read in place (no padded copy).
+ *  @img				Binary image (CV_8UC1, any row step).
+ *  @binaryCodes		Output: Binary code of each pixel (CV_8UC1, size of the image).
+ *  @ambiguityMask		Output: CLUSTER_POINT for edge pixels which are cluster points, otherwise 0 (CV_8UC1, size of the image).
+ *  @numberOfThreads	Bands of rows are processed on this number of threads (0 = number of hardware threads).
+ */
+void classifyNeighborhoods(const cv::Mat &img, cv::Mat &binaryCodes, cv::Mat &ambiguityMask, int numberOfThreads=1);
+
+#endif // NEIGHBORHOOD_H
@@ -0,0 +1,123 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** Number of threads to use for a requested number of threads (0 = number of hardware threads).
+ */
+inline int resolveNumberOfThreads(int numberOfThreads)
+{
+	if (numberOfThreads > 0)
+	{
+		return numberOfThreads;
+	}
+
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	return (hardwareThreads > 0) ? static_cast<int>(hardwareThreads) : 1;
+}
+
+/** Calls function(task, thread) for every task in [0, numberOfTasks) using up to numberOfThreads threads.
+ *  Tasks are handed out in ascending order to the next idle thread, thread is in [0, numberOfThreads) and
+ *  identifies the executing thread (e.g. to select per-thread scratch data). The calling thread works as thread 0.
+ */
+template <typename Function>
+void parallelFor(int numberOfTasks, int numberOfThreads, Function function)
+{
+	numberOfThreads = std::max(1, std::min(numberOfThreads, numberOfTasks));
+
+	std::atomic<int> nextTask(0);
+
+	auto worker = [&](int thread)
+	{
+		for (int task = nextTask++; task < numberOfTasks; task = nextTask++)
+		{
+			function(task, thread);
+		}
+	};
+
+	std::vector<std::thread> threads;
+
+	for (int thread = 1; thread < numberOfThreads; thread++)
+	{
+		threads.emplace_back(worker, thread);
+	}
+
+	worker(0);
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+/** First-in first-out queue with a maximum size for passing work between pipeline stages. Producers block while the
+ *  queue is full and consumers block while it is empty, so a fast stage cannot run arbitrarily far ahead of a slow one.
+ */
+template <typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)), closed(false) {}
+
+	/** Appends an item, waits while the queue is full. Returns false (and drops the item) if the queue is closed.
+	 */
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [&] { return items.size() < capacity || closed; });
+
+		if (closed)
+		{
+			return false;
+		}
+
+		items.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
+	}
+
+	/** Removes the first item, waits while the queue is empty. Returns false if the queue is closed and empty.
+	 */
+	bool pop(T &item)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+
+		if (items.empty())
+		{
+			return false;
+		}
+
+		item = std::move(items.front());
+		items.pop_front();
+		notFull.notify_one();
+		return true;
+	}
+
+	/** No more items are added, waiting consumers return once the remaining items are taken.
+	 */
+	void close()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		notFull.notify_all();
+		notEmpty.notify_all();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable notFull;
+	std::condition_variable notEmpty;
+	std::deque<T> items;
+	size_t capacity;
+	bool closed;
+};
+
+#endif // PARALLEL_H
@@ -0,0 +1,549 @@
+#include "ResultFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(cv::Point) == 2 * sizeof(int32_t) && std::is_standard_layout<cv::Point>::value,
+			  "Cluster points are read in place as cv::Point");
+
+namespace
+{
+	constexpr char MAGIC[4] = {'E', 'T', 'R', 'F'};
+	constexpr uint32_t HAS_EDGE_ID_MAP = 1;		// Header flags
+	constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;	// Written in native byte order, reads differently on other machines
+
+	constexpr size_t WRITE_BUFFER_SIZE = 1 << 20;
+	constexpr int32_t NO_EDGE = -1;				// Label of pixels without edgeId (as in EdgeMap)
+
+	/** Header at the beginning of a result file. Offsets are in bytes from the beginning of the file.
+	 */
+	struct FileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t flags;
+		int32_t rows;
+		int32_t cols;
+		uint32_t byteOrder;
+		uint64_t numberOfEdges;
+		uint64_t pointStreamSize;
+		uint64_t numberOfClusters;
+		uint64_t numberOfClusterPoints;
+		uint64_t numberOfOverflowEntries;
+		uint64_t numberOfOverflowEdgeIds;
+		uint64_t pointStreamOffset;
+		uint64_t edgeTableOffset;
+		uint64_t edgeSizesOffset;
+		uint64_t clusterTableOffset;
+		uint64_t clusterPointsOffset;
+		uint64_t edgeIdMapOffset;
+		uint64_t overflowTableOffset;
+		uint64_t overflowEdgeIdsOffset;
+	};
+
+	static_assert(sizeof(FileHeader) % 8 == 0, "Sections following the header have to be aligned");
+
+	uint32_t zigzagEncode(int32_t value)
+	{
+		return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+	}
+
+	int32_t zigzagDecode(uint32_t value)
+	{
+		return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+	}
+
+	void appendVarint(std::vector<uint8_t> &stream, uint32_t value)
+	{
+		while (value >= 0x80)
+		{
+			stream.push_back(static_cast<uint8_t>(value) | 0x80);
+			value >>= 7;
+		}
+
+		stream.push_back(static_cast<uint8_t>(value));
+	}
+
+	/** Reads a varint, returns false if the encoding ends before the varint.
+	 */
+	bool readVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value)
+	{
+		value = 0;
+
+		for (int shift = 0; shift < 35 && data < end; shift += 7)
+		{
+			uint8_t byte = *data++;
+			value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+
+			if (!(byte & 0x80))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/** Appends the encoding of one point (difference to the previous point) to the point stream.
+	 */
+	void appendDelta(std::vector<uint8_t> &stream, int dx, int dy)
+	{
+		if (dx >= -7 && dx <= 7 && dy >= -7 && dy <= 7)
+		{
+			stream.push_back(static_cast<uint8_t>((dx + 8) << 4 | (dy + 8)));
+			return;
+		}
+
+		stream.push_back(0);
+		appendVarint(stream, zigzagEncode(dx));
+		appendVarint(stream, zigzagEncode(dy));
+	}
+
+	/** Sequential writing of the sections, keeps track of the position and of failures.
+	 */
+	class SectionWriter
+	{
+	public:
+		explicit SectionWriter(FILE *file) : file(file), position(0), failed(false) {}
+
+		void write(const void *bytes, size_t size)
+		{
+			if (size > 0 && fwrite(bytes, 1, size, file) != size)
+			{
+				failed = true;
+			}
+
+			position += size;
+		}
+
+		template <typename T>
+		void writeArray(const std::vector<T> &values)
+		{
+			write(values.data(), values.size() * sizeof(T));
+		}
+
+		/** Pads the file with zeros to the next multiple of 8 bytes, returns the position (start of the next section).
+		 */
+		uint64_t align()
+		{
+			static const uint8_t zeros[8] = {};
+			write(zeros, (8 - position % 8) % 8);
+			return position;
+		}
+
+		uint64_t getPosition() const { return position; }
+		bool hasFailed() const { return failed; }
+
+	private:
+		FILE *file;
+		uint64_t position;
+		bool failed;
+	};
+
+	/** Checks if an array of count elements of given size at offset lies within the file and is aligned.
+	 */
+	bool isValidSection(uint64_t offset, uint64_t count, size_t elementSize, size_t fileSize)
+	{
+		return offset % elementSize == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+	}
+
+} // end namespace
+
+EncodedEdgeSpan::Iterator::Iterator(const uint8_t *data, const uint8_t *dataEnd, size_t remaining) :
+	data(data), dataEnd(dataEnd), remaining(remaining + 1), point(0, 0)
+{
+	decode();
+}
+
+void EncodedEdgeSpan::Iterator::decode()
+{
+	if (remaining == 0 || --remaining == 0)
+	{
+		return;
+	}
+
+	if (data >= dataEnd)
+	{
+		remaining = 0;
+		return;
+	}
+
+	uint8_t byte = *data++;
+
+	if ((byte & 0xf0) && (byte & 0x0f))
+	{
+		point.x += (byte >> 4) - 8;
+		point.y += (byte & 0x0f) - 8;
+		return;
+	}
+
+	uint32_t dx, dy;
+
+	if (!readVarint(data, dataEnd, dx) || !readVarint(data, dataEnd, dy))
+	{
+		remaining = 0;
+		return;
+	}
+
+	point.x += zigzagDecode(dx);
+	point.y += zigzagDecode(dy);
+}
+
+std::vector<cv::Point> EncodedEdgeSpan::toVector() const
+{
+	std::vector<cv::Point> points;
+	points.reserve(count);
+
+	for (const auto& point : *this)
+	{
+		points.push_back(point);
+	}
+
+	return points;
+}
+
+bool ResultFileWriter::write(const Edges &edges, const EdgeMap &edgeMap, bool writeEdgeIdMap, const std::string &path, bool printMessage)
+{
+	int rows = edgeMap.getRows();
+	int cols = edgeMap.getCols();
+
+	FILE *file = fopen(path.c_str(), "wb");
+
+	if (!file)
+	{
+		std::cerr << "Failed to write " << path << ". Check folder structure." << std::endl;
+		return false;
+	}
+
+	std::vector<char> fileBuffer(WRITE_BUFFER_SIZE);
+	setvbuf(file, fileBuffer.data(), _IOFBF, fileBuffer.size());
+
+	FileHeader header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = ResultFileReader::VERSION;
+	header.byteOrder = BYTE_ORDER_MARK;
+	header.flags = writeEdgeIdMap ? HAS_EDGE_ID_MAP : 0;
+	header.rows = rows;
+	header.cols = cols;
+	header.numberOfEdges = edges.size();
+
+	// The header is written again at the end, when all offsets are known
+	SectionWriter writer(file);
+	writer.write(&header, sizeof(header));
+
+	// Point stream (encoded edge by edge, so only one edge is held in memory)
+	std::vector<uint64_t> edgeTable;
+	std::vector<uint32_t> edgeSizes;
+	std::vector<uint8_t> stream;
+	edgeTable.reserve(edges.size() + 1);
+	edgeSizes.reserve(edges.size());
+
+	header.pointStreamOffset = writer.getPosition();
+
+	for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+	{
+		cv::Point previous(0, 0);
+		stream.clear();
+
+		for (const auto& point : edges.getPoints(edgeId))
+		{
+			appendDelta(stream, point.x - previous.x, point.y - previous.y);
+			previous = point;
+		}
+
+		edgeTable.push_back(writer.getPosition() - header.pointStreamOffset);
+		edgeSizes.push_back(edges.getEdgeSize(edgeId));
+		writer.writeArray(stream);
+	}
+
+	header.pointStreamSize = writer.getPosition() - header.pointStreamOffset;
+	edgeTable.push_back(header.pointStreamSize);
+
+	// Edge table and sizes
+	header.edgeTableOffset = writer.align();
+	writer.writeArray(edgeTable);
+	header.edgeSizesOffset = writer.align();
+	writer.writeArray(edgeSizes);
+
+	// Clusters
+	std::vector<uint64_t> clusterTable(1, 0);
+
+	for (const auto *clusterPoints : edgeMap.getAllClusterPoints())
+	{
+		clusterTable.push_back(clusterTable.back() + clusterPoints->size());
+	}
+
+	header.numberOfClusters = clusterTable.size() - 1;
+	header.numberOfClusterPoints = clusterTable.back();
+	header.clusterTableOffset = writer.align();
+	writer.writeArray(clusterTable);
+	header.clusterPointsOffset = writer.align();
+
+	for (const auto *clusterPoints : edgeMap.getAllClusterPoints())
+	{
+		writer.writeArray(*clusterPoints);
+	}
+
+	// EdgeIdMap in the layout of the dense backend
+	if (writeEdgeIdMap)
+	{
+		std::vector<int32_t> labels(static_cast<size_t>(rows) * cols, NO_EDGE);
+		std::vector<uint64_t> overflowTable(1, 0);
+		std::vector<int32_t> overflowEdgeIds;
+
+		for (int index : edgeMap.getEdgePixelIndices())
+		{
+			EdgeIdSpan edgeIds = edgeMap.getEdgeIds(index % cols, index / cols);
+
+			if (edgeIds.size() == 1)
+			{
+				labels[index] = edgeIds.front();
+			}
+			else if (edgeIds.size() > 1)
+			{
+				labels[index] = -static_cast<int32_t>(overflowTable.size() - 1) - 2;
+				overflowEdgeIds.insert(overflowEdgeIds.end(), edgeIds.begin(), edgeIds.end());
+				overflowTable.push_back(overflowEdgeIds.size());
+			}
+		}
+
+		header.numberOfOverflowEntries = overflowTable.size() - 1;
+		header.numberOfOverflowEdgeIds = overflowEdgeIds.size();
+		header.edgeIdMapOffset = writer.align();
+		writer.writeArray(labels);
+		header.overflowTableOffset = writer.align();
+		writer.writeArray(overflowTable);
+		header.overflowEdgeIdsOffset = writer.align();
+		writer.writeArray(overflowEdgeIds);
+	}
+
+	writer.align();
+
+	// Header with the final offsets
+	bool failed = writer.hasFailed() || fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1;
+
+	if (fclose(file) != 0 || failed)
+	{
+		std::cerr << "Failed to write " << path << "." << std::endl;
+		return false;
+	}
+
+	if (printMessage)
+	{
+		std::cout << "File " << path << " written.\n";
+	}
+
+	return true;
+}
+
+ResultFileReader::~ResultFileReader()
+{
+	close();
+}
+
+bool ResultFileReader::open(const std::string &path)
+{
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+	{
+		std::cerr << "Could not open " << path << "." << std::endl;
+		return false;
+	}
+
+	struct stat status;
+	void *mapping = MAP_FAILED;
+
+	if (fstat(fd, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(FileHeader)))
+	{
+		mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+
+	::close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		std::cerr << "Could not map " << path << " (no result file)." << std::endl;
+		return false;
+	}
+
+	data = static_cast<const uint8_t *>(mapping);
+	fileSize = status.st_size;
+
+	// Check the header and the bounds of all sections, the tables themselves are checked on access
+	const FileHeader &header = *reinterpret_cast<const FileHeader *>(data);
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.byteOrder != BYTE_ORDER_MARK)
+	{
+		std::cerr << path << " was written with a different byte order." << std::endl;
+		close();
+		return false;
+	}
+
+	bool hasMap = header.flags & HAS_EDGE_ID_MAP;
+	uint64_t numberOfPixels = (header.rows > 0 && header.cols > 0) ? static_cast<uint64_t>(header.rows) * header.cols : 0;
+
+	bool valid = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version >= 1 && header.version <= VERSION
+		&& header.rows >= 0 && header.cols >= 0
+		&& isValidSection(header.pointStreamOffset, header.pointStreamSize, 1, fileSize)
+		&& header.numberOfEdges < UINT64_MAX && isValidSection(header.edgeTableOffset, header.numberOfEdges + 1, 8, fileSize)
+		&& isValidSection(header.edgeSizesOffset, header.numberOfEdges, 4, fileSize)
+		&& header.numberOfClusters < UINT64_MAX && isValidSection(header.clusterTableOffset, header.numberOfClusters + 1, 8, fileSize)
+		&& isValidSection(header.clusterPointsOffset, header.numberOfClusterPoints, 8, fileSize)
+		&& (!hasMap || (isValidSection(header.edgeIdMapOffset, numberOfPixels, 4, fileSize)
+			&& header.numberOfOverflowEntries < UINT64_MAX && isValidSection(header.overflowTableOffset, header.numberOfOverflowEntries + 1, 8, fileSize)
+			&& isValidSection(header.overflowEdgeIdsOffset, header.numberOfOverflowEdgeIds, 4, fileSize)));
+
+	if (!valid)
+	{
+		std::cerr << path << " is no valid result file (version " << VERSION << " or older)." << std::endl;
+		close();
+		return false;
+	}
+
+	version = header.version;
+	rows = header.rows;
+	cols = header.cols;
+
+	numberOfEdges = header.numberOfEdges;
+	edgeTable = reinterpret_cast<const uint64_t *>(data + header.edgeTableOffset);
+	edgeSizes = reinterpret_cast<const uint32_t *>(data + header.edgeSizesOffset);
+	pointStream = data + header.pointStreamOffset;
+	pointStreamSize = header.pointStreamSize;
+
+	numberOfClusters = header.numberOfClusters;
+	clusterTable = reinterpret_cast<const uint64_t *>(data + header.clusterTableOffset);
+	clusterPoints = reinterpret_cast<const cv::Point *>(data + header.clusterPointsOffset);
+	numberOfClusterPoints = header.numberOfClusterPoints;
+
+	if (hasMap)
+	{
+		labels = reinterpret_cast<const int32_t *>(data + header.edgeIdMapOffset);
+		numberOfOverflowEntries = header.numberOfOverflowEntries;
+		overflowTable = reinterpret_cast<const uint64_t *>(data + header.overflowTableOffset);
+		overflowEdgeIds = reinterpret_cast<const int32_t *>(data + header.overflowEdgeIdsOffset);
+		numberOfOverflowEdgeIds = header.numberOfOverflowEdgeIds;
+	}
+
+	return true;
+}
+
+void ResultFileReader::close()
+{
+	if (data)
+	{
+		munmap(const_cast<uint8_t *>(data), fileSize);
+	}
+
+	data = nullptr;
+	fileSize = 0;
+	version = 0;
+	rows = 0;
+	cols = 0;
+	numberOfEdges = 0;
+	numberOfClusters = 0;
+	numberOfClusterPoints = 0;
+	labels = nullptr;
+	numberOfOverflowEntries = 0;
+}
+
+bool ResultFileReader::isOpen() const
+{
+	return data != nullptr;
+}
+
+uint32_t ResultFileReader::getVersion() const
+{
+	return version;
+}
+
+int ResultFileReader::getRows() const
+{
+	return rows;
+}
+
+int ResultFileReader::getCols() const
+{
+	return cols;
+}
+
+size_t ResultFileReader::getNumberOfEdges() const
+{
+	return numberOfEdges;
+}
+
+EncodedEdgeSpan ResultFileReader::getEdge(size_t edgeId) const
+{
+	uint64_t begin = edgeTable[edgeId];
+	uint64_t end = edgeTable[edgeId + 1];
+
+	if (begin > end || end > pointStreamSize)
+	{
+		return EncodedEdgeSpan();
+	}
+
+	return EncodedEdgeSpan(pointStream + begin, pointStream + end, edgeSizes[edgeId]);
+}
+
+size_t ResultFileReader::getNumberOfClusters() const
+{
+	return numberOfClusters;
+}
+
+PointSpan ResultFileReader::getCluster(size_t index) const
+{
+	uint64_t begin = clusterTable[index];
+	uint64_t end = clusterTable[index + 1];
+
+	if (begin > end || end > numberOfClusterPoints)
+	{
+		return PointSpan();
+	}
+
+	return PointSpan(clusterPoints + begin, end - begin);
+}
+
+bool ResultFileReader::hasEdgeIdMap() const
+{
+	return labels != nullptr;
+}
+
+EdgeIdSpan ResultFileReader::getEdgeIds(int x, int y) const
+{
+	if (!labels)
+	{
+		return EdgeIdSpan();
+	}
+
+	const int32_t &label = labels[x + static_cast<size_t>(y) * cols];
+
+	if (label >= 0)
+	{
+		return EdgeIdSpan(&label, 1);
+	}
+
+	uint64_t entry = -(static_cast<int64_t>(label) + 2);
+
+	if (label == NO_EDGE || entry >= numberOfOverflowEntries)
+	{
+		return EdgeIdSpan();
+	}
+
+	uint64_t begin = overflowTable[entry];
+	uint64_t end = overflowTable[entry + 1];
+
+	if (begin > end || end > numberOfOverflowEdgeIds)
+	{
+		return EdgeIdSpan();
+	}
+
+	return EdgeIdSpan(overflowEdgeIds + begin, end - begin);
+}
@@ -0,0 +1,215 @@
+#ifndef RESULTFILE_H
+#define RESULTFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "EdgeMap.h"
+#include "Edges.h"
+
+/*
+Binary result file (.etr) with the traced edges, the clusters and optionally the edgeIdMap. All numbers are in the native byte order
+of the writing machine and all sections start at a multiple of 8 bytes, so the file can be memory-mapped and read in place.
+Files are not portable between machines of different byte order, the reader rejects them by the byte order mark:
+
+	header				Magic "ETRF", version, byte order mark 0x01020304, image size, number of elements and offset of each section (see ResultFile.cpp).
+	point stream		Points of all edges, delta-encoded. Each point is the difference to the previous point of the edge
+						(the first point is the difference to (0, 0)): one byte (dx + 8) << 4 | (dy + 8) for -7 <= dx, dy <= 7,
+						otherwise a zero byte followed by dx and dy as zigzag varints.
+	edge table			uint64 byte offset of each edge in the point stream, one entry more than the number of edges.
+	edge sizes			uint32 number of points of each edge.
+	cluster table		uint64 index of the first point of each cluster, one entry more than the number of clusters.
+	cluster points		int32 x, y of the points of all clusters.
+	edgeIdMap			int32 label per pixel (optional): -1 no edge, >= 0 the only edgeId of the pixel, otherwise the
+						edgeIds of the pixel are overflow entry -(label + 2).
+	overflow table		uint64 index of the first edgeId of each overflow entry, one entry more than the number of entries.
+	overflow edgeIds	int32 edgeIds of the pixels with several edgeIds.
+
+Edges are stored with their edgeIds (empty edges included), clusters in the order of EdgeMap::getAllClusterPoints.
+*/
+
+/** Read-only view of the points of one edge in a result file. The points are decoded while iterating, nothing is copied.
+ *  Valid as long as the ResultFileReader is open.
+ */
+class EncodedEdgeSpan
+{
+public:
+	/** Forward iterator which decodes one point per step.
+	 */
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = cv::Point;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const cv::Point *;
+		using reference = const cv::Point &;
+
+		Iterator() : data(nullptr), dataEnd(nullptr), remaining(0) {}
+		Iterator(const uint8_t *data, const uint8_t *dataEnd, size_t remaining);
+
+		const cv::Point &operator*() const { return point; }
+		const cv::Point *operator->() const { return &point; }
+		Iterator &operator++() { decode(); return *this; }
+		bool operator==(const Iterator &other) const { return remaining == other.remaining; }
+		bool operator!=(const Iterator &other) const { return remaining != other.remaining; }
+
+	private:
+		const uint8_t *data;	//!< Encoding of the next point.
+		const uint8_t *dataEnd;	//!< End of the encoded edge.
+		size_t remaining;		//!< Number of points including the current one, 0 at the end.
+		cv::Point point;		//!< Current point.
+
+		/** Decodes the next point, ends the iteration if the encoding is truncated.
+		 */
+		void decode();
+	};
+
+	EncodedEdgeSpan() : data(nullptr), dataEnd(nullptr), count(0) {}
+	EncodedEdgeSpan(const uint8_t *data, const uint8_t *dataEnd, size_t count) : data(data), dataEnd(dataEnd), count(count) {}
+
+	Iterator begin() const { return Iterator(data, dataEnd, count); }
+	Iterator end() const { return Iterator(); }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	/** Decoded points of the edge.
+	 */
+	std::vector<cv::Point> toVector() const;
+
+private:
+	const uint8_t *data;
+	const uint8_t *dataEnd;
+	size_t count;
+};
+
+/** Read-only view of the points of one cluster in a result file (stored as plain array, nothing is copied).
+ *  Valid as long as the ResultFileReader is open.
+ */
+class PointSpan
+{
+public:
+	PointSpan() : data(nullptr), count(0) {}
+	PointSpan(const cv::Point *data, size_t count) : data(data), count(count) {}
+
+	const cv::Point *begin() const { return data; }
+	const cv::Point *end() const { return data + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const cv::Point &operator[](size_t i) const { return data[i]; }
+
+private:
+	const cv::Point *data;
+	size_t count;
+};
+
+class ResultFileWriter
+{
+public:
+	/** Write the edges, clusters and edgeIdMap of a result as binary result file (see above).
+	 * 	@edges 			Internal class which holds the traced edges.
+	 * 	@edgeMap		Internal class to represent the edgeIdMap and edgeClusterMap.
+	 *  @writeEdgeIdMap	Write the edgeIdMap (4 bytes per pixel of the image).
+	 *  @path			Path of the result file.
+	 *  @printMessage	Print a message when the file is written.
+	 *  @returns		True if the file was written.
+	 */
+	static bool write(const Edges &edges, const EdgeMap &edgeMap, bool writeEdgeIdMap=true, const std::string &path="./output/tracedEdges.etr", bool printMessage=true);
+};
+
+/** Memory-maps a result file. Opening only checks the header and the section sizes, so it takes constant time;
+ *  edges, clusters and edgeIds are read in place on access.
+ */
+class ResultFileReader
+{
+public:
+	/** Version of the file format written by ResultFileWriter, newer files are rejected.
+	 */
+	static constexpr uint32_t VERSION = 1;
+
+	ResultFileReader() = default;
+	~ResultFileReader();
+
+	ResultFileReader(const ResultFileReader &) = delete;
+	ResultFileReader &operator=(const ResultFileReader &) = delete;
+
+	/** Open a result file (a file opened before is closed). Failures are reported on std::cerr.
+	 *  @path			Path of the result file.
+	 *  @returns		True if the file is a valid result file.
+	 */
+	bool open(const std::string &path);
+
+	/** Unmap the file, all spans become invalid.
+	 */
+	void close();
+
+	bool isOpen() const;
+
+	/** Format version of the file.
+	 */
+	uint32_t getVersion() const;
+
+	/** Number of image rows.
+	 */
+	int getRows() const;
+
+	/** Number of image columns.
+	 */
+	int getCols() const;
+
+	/** Number of edges (including empty edges).
+	 */
+	size_t getNumberOfEdges() const;
+
+	/** Points of the edge with given edgeId (empty if the edge table is corrupt).
+	 */
+	EncodedEdgeSpan getEdge(size_t edgeId) const;
+
+	/** Number of clusters.
+	 */
+	size_t getNumberOfClusters() const;
+
+	/** Points of the cluster with given index (empty if the cluster table is corrupt).
+	 */
+	PointSpan getCluster(size_t index) const;
+
+	/** Checks if the file contains the edgeIdMap.
+	 */
+	bool hasEdgeIdMap() const;
+
+	/** EdgeIds at given position, empty if the file has no edgeIdMap.
+	 */
+	EdgeIdSpan getEdgeIds(int x, int y) const;
+
+private:
+	const uint8_t *data = nullptr;	//!< Mapped file.
+	size_t fileSize = 0;			//!< Size of the mapped file in bytes.
+
+	uint32_t version = 0;
+	int rows = 0;
+	int cols = 0;
+
+	size_t numberOfEdges = 0;
+	const uint64_t *edgeTable = nullptr;
+	const uint32_t *edgeSizes = nullptr;
+	const uint8_t *pointStream = nullptr;
+	uint64_t pointStreamSize = 0;
+
+	size_t numberOfClusters = 0;
+	const uint64_t *clusterTable = nullptr;
+	const cv::Point *clusterPoints = nullptr;
+	uint64_t numberOfClusterPoints = 0;
+
+	const int32_t *labels = nullptr;			//!< EdgeIdMap, nullptr if the file has none.
+	size_t numberOfOverflowEntries = 0;
+	const uint64_t *overflowTable = nullptr;
+	const int32_t *overflowEdgeIds = nullptr;
+	uint64_t numberOfOverflowEdgeIds = 0;
+};
+
+#endif // RESULTFILE_H
@@ -0,0 +1,97 @@
+#include "TracingStatistics.h"
+
+
+namespace
+{
+	uint64_t countNonEmptyEdges(const Edges &edges)
+	{
+		uint64_t count = 0;
+
+		for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+		{
+			count += (edges.getEdgeSize(edgeId) > 0);
+		}
+
+		return count;
+	}
+
+	void writeCandidates(std::ostream &stream, const TracingStatistics::Candidates &candidates)
+	{
+		stream << "{\"evaluated\": " << candidates.evaluated << ", \"accepted\": " << candidates.accepted << "}";
+	}
+
+} // end namespace
+
+void TracingStatistics::clear()
+{
+	*this = TracingStatistics();
+}
+
+double TracingStatistics::getTotalSeconds() const
+{
+	double seconds = 0.0;
+
+	for (const auto& phase : phases)
+	{
+		seconds += phase.seconds;
+	}
+
+	return seconds;
+}
+
+void TracingStatistics::writeJson(std::ostream &stream) const
+{
+	// Phase names are function names, so they need no escaping
+	stream << "{\n";
+	stream << "  \"image\": {\"rows\": " << rows << ", \"cols\": " << cols << ", \"pixels\": " << (uint64_t)rows * cols
+		   << ", \"edgePixels\": " << edgePixels << "},\n";
+
+	stream << "  \"phases\": [";
+
+	for (size_t i = 0; i < phases.size(); i++)
+	{
+		stream << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << phases[i].name << "\", \"seconds\": " << phases[i].seconds << "}";
+	}
+
+	stream << (phases.empty() ? "],\n" : "\n  ],\n");
+	stream << "  \"totalSeconds\": " << getTotalSeconds() << ",\n";
+
+	stream << "  \"clusters\": " << clusters << ",\n";
+	stream << "  \"clusterPoints\": " << clusterPoints << ",\n";
+	stream << "  \"clusterSizeHistogram\": {";
+
+	for (auto it = clusterSizeHistogram.begin(); it != clusterSizeHistogram.end(); ++it)
+	{
+		stream << (it == clusterSizeHistogram.begin() ? "" : ", ") << "\"" << it->first << "\": " << it->second;
+	}
+
+	stream << "},\n";
+	stream << "  \"tracedEdges\": " << tracedEdges << ",\n";
+	stream << "  \"edges\": " << edges << ",\n";
+	stream << "  \"merges\": " << merges << ",\n";
+	stream << "  \"changedTiles\": " << changedTiles << ",\n";
+	stream << "  \"retracedEdges\": " << retracedEdges << ",\n";
+	stream << "  \"connectCandidates\": ";
+	writeCandidates(stream, connectCandidates);
+	stream << ",\n  \"bridgeCandidates\": ";
+	writeCandidates(stream, bridgeCandidates);
+	stream << "\n}\n";
+}
+
+PhaseTimer::PhaseTimer(TracingStatistics *statistics, const char *name, const Edges &edges) :
+	statistics(statistics), name(name), edges(edges), start(std::chrono::steady_clock::now())
+{
+	if (statistics)
+	{
+		statistics->openPhases++;
+	}
+}
+
+PhaseTimer::~PhaseTimer()
+{
+	if (statistics && --statistics->openPhases == 0)
+	{
+		statistics->phases.push_back({name, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()});
+		statistics->edges = countNonEmptyEdges(edges);
+	}
+}
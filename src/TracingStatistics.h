@@ -0,0 +1,91 @@
+#ifndef TRACINGSTATISTICS_H
+#define TRACINGSTATISTICS_H
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Edges.h"
+
+/** Wall time per phase and counters of an EdgeProcessor (see EdgeProcessor::setStatistics).
+ */
+struct TracingStatistics
+{
+	/** Wall time of one phase (preprocessing, tracing or one call of a postprocessing or cleanup function).
+	 */
+	struct Phase
+	{
+		std::string name;	//!< Name of the phase, e.g. the name of the function.
+		double seconds;		//!< Wall time.
+	};
+
+	/** Candidates of a postprocessing function which connects edges.
+	 */
+	struct Candidates
+	{
+		uint64_t evaluated = 0;	//!< Pairs of connection points whose costs were computed.
+		uint64_t accepted = 0;	//!< Pairs which were connected.
+	};
+
+	int rows = 0;						//!< Number of image rows.
+	int cols = 0;						//!< Number of image columns.
+	uint64_t edgePixels = 0;			//!< Number of edge pixels (> 0) in the input image.
+
+	std::vector<Phase> phases;			//!< Phases in the order they were run.
+
+	uint64_t clusters = 0;				//!< Number of clusters found by the preprocessing.
+	uint64_t clusterPoints = 0;			//!< Number of cluster points found by the preprocessing.
+	std::map<size_t, uint64_t> clusterSizeHistogram;	//!< Number of clusters for each cluster size (in points).
+
+	uint64_t tracedEdges = 0;			//!< Number of edges after tracing.
+	uint64_t edges = 0;					//!< Number of non-empty edges after the last phase.
+	uint64_t merges = 0;				//!< Number of merged pairs of edges (tracing and postprocessing, only the retraced edges with traceNextFrame).
+
+	uint64_t changedTiles = 0;			//!< Number of tiles which differ from the previous frame (EdgeProcessor::traceNextFrame).
+	uint64_t retracedEdges = 0;			//!< Number of edges traced again in the changed tiles (EdgeProcessor::traceNextFrame).
+
+	Candidates connectCandidates;		//!< Candidates of connectEdgesInClusters.
+	Candidates bridgeCandidates;		//!< Candidates of bridgeEdgeGaps.
+
+	int openPhases = 0;					//!< Number of running PhaseTimers, phases within phases are not recorded.
+
+	/** Reset all phases and counters.
+	 */
+	void clear();
+
+	/** Sum of the wall times of all phases.
+	 */
+	double getTotalSeconds() const;
+
+	/** Writes all phases and counters as JSON object.
+	 */
+	void writeJson(std::ostream &stream) const;
+};
+
+/** Records the wall time from construction to destruction as phase and updates the number of edges. Does nothing
+ *  without statistics and within another phase (e.g. postprocessing functions called by other postprocessing functions).
+ */
+class PhaseTimer
+{
+public:
+	/** @statistics		Statistics to which the phase is added (may be nullptr).
+	 *  @name			Name of the phase.
+	 *  @edges			Edges of the EdgeProcessor, the non-empty edges are counted at the end of the phase.
+	 */
+	PhaseTimer(TracingStatistics *statistics, const char *name, const Edges &edges);
+	~PhaseTimer();
+
+	PhaseTimer(const PhaseTimer &) = delete;
+	PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+private:
+	TracingStatistics *statistics;
+	const char *name;
+	const Edges &edges;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif // TRACINGSTATISTICS_H
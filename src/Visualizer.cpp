@@ -1,7 +1,14 @@
 #include "Visualizer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <thread>
+
+#include "Parallel.h"
 
 namespace
 {
@@ -10,6 +17,183 @@ namespace
 	constexpr bool MARK_COORDINATES = false;
 	constexpr bool MARK_AMBIGUITY_POINTS = true;
 
+	constexpr size_t WRITE_BUFFER_SIZE = 1 << 20;	// Bytes collected before a buffer is handed to the writing thread
+	constexpr size_t WRITE_QUEUE_CAPACITY = 4;		// Full buffers waiting for the writing thread
+
+	constexpr uchar EDGE_PIXEL = 1;		// Pixel types of saveResultAsCompactSVG (bit flags)
+	constexpr uchar CLUSTER_PIXEL = 2;
+
+	/** Writes text to a file through large buffers. A background thread writes full buffers while the next one is filled.
+	 */
+	class BufferedFileWriter
+	{
+	public:
+		explicit BufferedFileWriter(FILE *file) : file(file), queue(WRITE_QUEUE_CAPACITY), failed(false)
+		{
+			buffer.reserve(WRITE_BUFFER_SIZE);
+			writer = std::thread([this]
+			{
+				std::string fullBuffer;
+
+				while (queue.pop(fullBuffer))
+				{
+					if (fwrite(fullBuffer.data(), 1, fullBuffer.size(), BufferedFileWriter::file) != fullBuffer.size())
+					{
+						failed = true;
+					}
+				}
+			});
+		}
+
+		~BufferedFileWriter()
+		{
+			close();
+		}
+
+		/** Appends formatted text (printf format).
+		 */
+		void print(const char *format, ...)
+		{
+			char text[256];
+			va_list arguments;
+			va_start(arguments, format);
+			int length = vsnprintf(text, sizeof(text), format, arguments);
+			va_end(arguments);
+
+			buffer.append(text, std::min<size_t>(std::max(length, 0), sizeof(text) - 1));
+
+			if (buffer.size() >= WRITE_BUFFER_SIZE)
+			{
+				queue.push(std::move(buffer));
+				buffer = std::string();
+				buffer.reserve(WRITE_BUFFER_SIZE);
+			}
+		}
+
+		/** Appends a number as printf("%f") would, without trailing zeros (e.g. 12.5 instead of 12.500000).
+		 */
+		void printNumber(double value)
+		{
+			char text[64];
+			int length = snprintf(text, sizeof(text), "%f", value);
+
+			while (length > 1 && text[length - 1] == '0')
+			{
+				length--;
+			}
+
+			if (text[length - 1] == '.')
+			{
+				length--;
+			}
+
+			text[length] = '\0';
+			print("%s", text);
+		}
+
+		/** Writes the remaining text, waits for the writing thread and closes the file.
+		 *  @returns		True if all text was written.
+		 */
+		bool close()
+		{
+			if (!file)
+			{
+				return !failed;
+			}
+
+			queue.push(std::move(buffer));
+			queue.close();
+			writer.join();
+
+			if (fclose(file) != 0)
+			{
+				failed = true;
+			}
+
+			file = nullptr;
+			return !failed;
+		}
+
+	private:
+		FILE *file;
+		std::string buffer;
+		BoundedQueue<std::string> queue;
+		std::thread writer;
+		std::atomic<bool> failed;
+	};
+
+	/** Appends path data which covers the given pixels with horizontal and vertical lines of width 1 (one line per run
+	 *  of pixels). Drawn with stroke width 1 and butt caps (SVG defaults), the lines cover exactly the pixel squares.
+	 *  @pixels			Pixels (may contain duplicates), sorted in place.
+	 */
+	void printPixelRuns(BufferedFileWriter &writer, std::vector<cv::Point> &pixels)
+	{
+		// Coordinates are written in half pixels, relative to the end of the previous line (except for the first line)
+		int currentX = 0, currentY = 0;
+		bool first = true;
+
+		auto printLine = [&](int x2, int y2, char direction, int length)
+		{
+			char dx[16], dy[16];
+			snprintf(dx, sizeof(dx), "%s%d%s", (x2 < currentX) ? "-" : "", std::abs(x2 - currentX) / 2, ((x2 - currentX) % 2 != 0) ? ".5" : "");
+			snprintf(dy, sizeof(dy), "%s%d%s", (y2 < currentY) ? "-" : "", std::abs(y2 - currentY) / 2, ((y2 - currentY) % 2 != 0) ? ".5" : "");
+			writer.print("%c%s %s%c%d", first ? 'M' : 'm', dx, dy, direction, length);
+			currentX = x2 + ((direction == 'h') ? 2 * length : 0);
+			currentY = y2 + ((direction == 'v') ? 2 * length : 0);
+			first = false;
+		};
+
+		// Horizontal runs of at least two pixels
+		std::sort(pixels.begin(), pixels.end(), [](const cv::Point &a, const cv::Point &b) { return (a.y < b.y) || (a.y == b.y && a.x < b.x); });
+		pixels.erase(std::unique(pixels.begin(), pixels.end()), pixels.end());
+
+		std::vector<cv::Point> singlePixels;
+
+		for (size_t i = 0; i < pixels.size();)
+		{
+			size_t j = i + 1;
+
+			while (j < pixels.size() && pixels[j].y == pixels[i].y && pixels[j].x == pixels[j - 1].x + 1)
+			{
+				j++;
+			}
+
+			if (j - i > 1)
+			{
+				printLine(2 * pixels[i].x, 2 * pixels[i].y + 1, 'h', j - i);
+			}
+			else
+			{
+				singlePixels.push_back(pixels[i]);
+			}
+
+			i = j;
+		}
+
+		// Vertical runs of the remaining pixels
+		std::sort(singlePixels.begin(), singlePixels.end(), [](const cv::Point &a, const cv::Point &b) { return (a.x < b.x) || (a.x == b.x && a.y < b.y); });
+
+		for (size_t i = 0; i < singlePixels.size();)
+		{
+			size_t j = i + 1;
+
+			while (j < singlePixels.size() && singlePixels[j].x == singlePixels[i].x && singlePixels[j].y == singlePixels[j - 1].y + 1)
+			{
+				j++;
+			}
+
+			printLine(2 * singlePixels[i].x + 1, 2 * singlePixels[i].y, 'v', j - i);
+			i = j;
+		}
+	}
+
+	/** Color as #rrggbb.
+	 */
+	void printColor(BufferedFileWriter &writer, const cv::Scalar &color)
+	{
+		writer.print("#%02x%02x%02x", (int)color.val[0], (int)color.val[1], (int)color.val[2]);
+	}
+
 	/** Generate one color for each edge.
 	 *  @numberOfValues		Number of RGB values to generate.
 	 */
@@ -35,19 +219,19 @@ namespace
 
 } // end namespace
 
-void Visualizer::saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap &edgeMap, bool showInput)
+bool Visualizer::saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap &edgeMap, bool showInput, const std::string &path)
 {
 	// Generate a color for each edge
 	std::vector<cv::Scalar> rgbValues = generateRgbValues(edges.size());
 
 	// Open new SVG file
 	FILE *file;
-	file = fopen("./output/tracedEdges.svg", "w");
+	file = fopen(path.c_str(), "w");
 
 	if (!file)
 	{
-		std::cerr << "Failed to write tracedEdges.svg. Check folder structure." << std::endl;
-		return;
+		std::cerr << "Failed to write " << path << ". Check folder structure." << std::endl;
+		return false;
 	}
 
 	// Setup SVG canvas
@@ -69,17 +253,17 @@ void Visualizer::saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap
 		}
 	}
 
-	// Get all traced edges
-	const std::vector<std::vector<cv::Point>> &edgesData = edges.getEdges();
-
-	// Draw edges exclusively based on edgesData
-	for (int i = 0; i < (int)edgesData.size(); i++)
+	// Draw edges exclusively based on the traced edges
+	for (int i = 0; i < (int)edges.size(); i++)
 	{
-		for (int j = 0; j < (int)edgesData[i].size(); j++)
+		EdgePoints edge = edges.getPoints(i);
+		int j = 0;
+
+		for (auto it = edge.begin(); it != edge.end(); ++it, j++)
 		{
 			// Position
-			int x = edgesData[i][j].x;
-			int y = edgesData[i][j].y;
+			int x = it->x;
+			int y = it->y;
 
 			// Color
 			int r = (int)rgbValues.at(i).val[0];
@@ -97,7 +281,7 @@ void Visualizer::saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap
 				}
 
 				// Mark end point
-				if (j == ((int)edgesData[i].size() - 1))
+				if (j == ((int)edge.size() - 1))
 				{
 					fprintf(file, "<circle cx=\"%f\" cy=\"%f\" r=\"0.1\" fill=\"grey\" />\n", x + 0.5, y + 0.5);
 				}
@@ -122,7 +306,7 @@ void Visualizer::saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap
 	{
 		for (int x = 0; x < img.cols; x++)
 		{
-			const std::vector<int> &edgeIds = edgeMap.getEdgeIds(x, y);
+			EdgeIdSpan edgeIds = edgeMap.getEdgeIds(x, y);
 
 			if (edgeIds.size() > 1)
 			{
@@ -139,8 +323,8 @@ void Visualizer::saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap
 					fprintf(file, "<rect x=\"%d\" y=\"%f\" width=\"1\" height=\"%f\" style=\"fill:rgb(%d,%d,%d);\" />\n", x, y + scale * i, scale, r, g, b);
 
 					// Print edge number
-					const auto& tempEdge = edgesData[j];
-					int index = std::find(tempEdge.begin(), tempEdge.end(), cv::Point(x, y)) - tempEdge.begin();
+					EdgePoints tempEdge = edges.getPoints(j);
+					int index = std::distance(tempEdge.begin(), std::find(tempEdge.begin(), tempEdge.end(), cv::Point(x, y)));
 
 					// Mark edgeId and index of point in that edge in the format [edgeId, index]
 					if (MARK_EDGEID_AND_INDICES)
@@ -183,10 +367,251 @@ void Visualizer::saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap
 	fprintf(file, "</svg>");
 	fclose(file);
 
-	std::cout << "File tracedEdges.svg written.\n";
+	std::cout << "File " << path << " written.\n";
+	return true;
 }
 
-void Visualizer::saveEdgeIdMapAsSVG(cv::Mat &img, const EdgeMap &edgeMap, bool showInput)
+bool Visualizer::saveResultAsCompactSVG(cv::Mat &img, const Edges &edges, const EdgeMap &edgeMap, bool showInput, const std::string &path, bool printMessage)
+{
+	// Same colors and drawing order as saveResultAsSVG
+	std::vector<cv::Scalar> rgbValues = generateRgbValues(std::max<size_t>(1, edges.size()));
+
+	FILE *file = fopen(path.c_str(), "w");
+
+	if (!file)
+	{
+		std::cerr << "Failed to write " << path << ". Check folder structure." << std::endl;
+		return false;
+	}
+
+	BufferedFileWriter writer(file);
+
+	// Setup SVG canvas
+	writer.print("<svg width=\"%d\" height=\"%d\">\n", img.cols, img.rows);
+	writer.print("<rect width=\"100%%\" height=\"100%%\" fill=\"black\" />\n");
+
+	// Pixels and edges are drawn as lines of width 1, which cover exactly the pixel squares (see printPixelRuns)
+	writer.print("<g fill=\"none\">\n");
+
+	// Pixels covered by edges and cluster points, only these pixels are looked up in the edgeMap
+	cv::Mat pixelTypes = cv::Mat::zeros(img.rows, img.cols, CV_8UC1);
+
+	for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+	{
+		for (const auto& point : edges.getPoints(edgeId))
+		{
+			pixelTypes.at<uchar>(point) |= EDGE_PIXEL;
+		}
+	}
+
+	for (const auto* clusterPoints : edgeMap.getAllClusterPoints())
+	{
+		for (const auto& point : *clusterPoints)
+		{
+			pixelTypes.at<uchar>(point) |= CLUSTER_PIXEL;
+		}
+	}
+
+	// Pixels of input image which are not covered by an edge (for reference)
+	std::vector<cv::Point> pixels;
+
+	if (showInput)
+	{
+		for (int y = 0; y < img.rows; y++)
+		{
+			const uchar *row = img.ptr<uchar>(y);
+			const uchar *types = pixelTypes.ptr<uchar>(y);
+
+			for (int x = 0; x < img.cols; x++)
+			{
+				if (row[x] > 0 && !(types[x] & EDGE_PIXEL))
+				{
+					pixels.emplace_back(x, y);
+				}
+			}
+		}
+
+		if (!pixels.empty())
+		{
+			writer.print("<path stroke=\"gray\" d=\"");
+			printPixelRuns(writer, pixels);
+			writer.print("\" />\n");
+		}
+	}
+
+	// One path per edge. Pixels shared by several edges are drawn again below, so the order of the pixels within an
+	// edge does not matter.
+	for (int i = 0; i < (int)edges.size(); i++)
+	{
+		EdgePoints edge = edges.getPoints(i);
+
+		if (!edge.empty())
+		{
+			pixels.assign(edge.begin(), edge.end());
+			writer.print("<path stroke=\"");
+			printColor(writer, rgbValues[i]);
+			writer.print("\" d=\"");
+			printPixelRuns(writer, pixels);
+			writer.print("\" />\n");
+		}
+	}
+
+	writer.print("</g>\n");
+
+	// Markers of start and end points. A marker is only covered by its own pixel (drawn above) or by the shared edges
+	// (drawn below), so all markers can follow the edges. Markers at shared pixels are drawn with the shared edges.
+	if constexpr (MARK_START_AND_END_POINTS)
+	{
+		writer.print("<g fill=\"none\" stroke=\"grey\" stroke-width=\"0.05\">\n");
+
+		for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+		{
+			EdgePoints edge = edges.getPoints(edgeId);
+
+			// In saveResultAsSVG, the marker of the start point is covered if the point occurs again in the edge
+			if (!edge.empty() && edgeMap.getNumberOfEdgeIds(edge.front().x, edge.front().y) <= 1
+				&& std::find(std::next(edge.begin()), edge.end(), edge.front()) == edge.end())
+			{
+				writer.print("<circle cx=\"%d.5\" cy=\"%d.5\" r=\"0.075\" />\n", edge.front().x, edge.front().y);
+			}
+		}
+
+		writer.print("</g>\n<g fill=\"grey\">\n");
+
+		for (size_t edgeId = 0; edgeId < edges.size(); edgeId++)
+		{
+			EdgePoints edge = edges.getPoints(edgeId);
+
+			if (!edge.empty() && edgeMap.getNumberOfEdgeIds(edge.back().x, edge.back().y) <= 1)
+			{
+				writer.print("<circle cx=\"%d.5\" cy=\"%d.5\" r=\"0.1\" />\n", edge.back().x, edge.back().y);
+			}
+		}
+
+		writer.print("</g>\n");
+	}
+
+	for (int i = 0; i < (int)edges.size(); i++)
+	{
+		int j = 0;
+
+		for (const auto& point : edges.getPoints(i))
+		{
+			if constexpr (MARK_EDGEID_AND_INDICES)
+			{
+				writer.print("<text x=\"%f\" y=\"%f\" style=\"fill:grey; font-size:0.15px;\">[%d,%d]</text>\n", point.x + 0.03, point.y + 0.15, i, j);
+			}
+
+			if constexpr (MARK_COORDINATES)
+			{
+				writer.print("<text x=\"%f\" y=\"%f\" style=\"fill:grey; font-size:0.15px;\">[%d,%d]</text>\n", point.x + 0.03, point.y + 0.95, point.x, point.y);
+			}
+
+			j++;
+		}
+	}
+
+	// Shared edges and borders around cluster points, in raster order as in saveResultAsSVG (borders overlap neighbors).
+	// Consecutive borders are combined into one path.
+	bool borderPathOpen = false;
+
+	for (int y = 0; y < img.rows; y++)
+	{
+		const uchar *types = pixelTypes.ptr<uchar>(y);
+
+		for (int x = 0; x < img.cols; x++)
+		{
+			if (!types[x])
+			{
+				continue;
+			}
+
+			EdgeIdSpan edgeIds = edgeMap.getEdgeIds(x, y);
+
+			if (edgeIds.size() > 1)
+			{
+				double scale = (double)1 / edgeIds.size();
+
+				if (borderPathOpen)
+				{
+					writer.print("\" />\n");
+					borderPathOpen = false;
+				}
+
+				for (int i = 0; i < (int)edgeIds.size(); i++)
+				{
+					int j = (int)edgeIds[i]; // current edgeId
+					writer.print("<rect x=\"%d\" y=\"", x);
+					writer.printNumber(y + scale * i);
+					writer.print("\" width=\"1\" height=\"");
+					writer.printNumber(scale);
+					writer.print("\" fill=\"");
+					printColor(writer, rgbValues[j]);
+					writer.print("\" />\n");
+
+					// Start and end point as in saveResultAsSVG, which uses the first occurrence of the point in the edge
+					EdgePoints tempEdge = edges.getPoints(j);
+					bool isStartPoint = !tempEdge.empty() && (tempEdge.front() == cv::Point(x, y));
+					bool isEndPoint = !tempEdge.empty() && (tempEdge.back() == cv::Point(x, y)) && (tempEdge.size() == 1 || !isStartPoint);
+
+					if constexpr (MARK_EDGEID_AND_INDICES)
+					{
+						int index = std::distance(tempEdge.begin(), std::find(tempEdge.begin(), tempEdge.end(), cv::Point(x, y)));
+						writer.print("<text x=\"%f\" y=\"%f\" style=\"fill:grey; font-size:0.15px;\">[%d,%d]</text>\n", x + 0.03, y + 0.15 + scale * i, j, index);
+					}
+
+					if (MARK_START_AND_END_POINTS && isStartPoint)
+					{
+						writer.print("<circle cx=\"%d.5\" cy=\"", x);
+						writer.printNumber(y + (0.5 + i) * scale);
+						writer.print("\" r=\"0.075\" stroke=\"grey\" stroke-width=\"0.05\" fill=\"none\" />\n");
+					}
+
+					if (MARK_START_AND_END_POINTS && isEndPoint)
+					{
+						writer.print("<circle cx=\"%d.5\" cy=\"", x);
+						writer.printNumber(y + (0.5 + i) * scale);
+						writer.print("\" r=\"0.1\" fill=\"grey\" />\n");
+					}
+				}
+			}
+
+			if (MARK_AMBIGUITY_POINTS && (types[x] & CLUSTER_PIXEL))
+			{
+				if (!borderPathOpen)
+				{
+					writer.print("<path fill=\"none\" stroke=\"red\" stroke-width=\"0.1\" d=\"");
+					borderPathOpen = true;
+				}
+
+				writer.print("M%d %dh1v1h-1z", x, y);
+			}
+		}
+	}
+
+	if (borderPathOpen)
+	{
+		writer.print("\" />\n");
+	}
+
+	// End and close SVG file
+	writer.print("</svg>");
+
+	if (!writer.close())
+	{
+		std::cerr << "Failed to write " << path << "." << std::endl;
+		return false;
+	}
+
+	if (printMessage)
+	{
+		std::cout << "File " << path << " written.\n";
+	}
+
+	return true;
+}
+
+bool Visualizer::saveEdgeIdMapAsSVG(cv::Mat &img, const EdgeMap &edgeMap, bool showInput, const std::string &path, bool printMessage)
 {
 	int rows = edgeMap.getRows();
 	int cols = edgeMap.getCols();
@@ -196,12 +621,12 @@ void Visualizer::saveEdgeIdMapAsSVG(cv::Mat &img, const EdgeMap &edgeMap, bool s
 
 	// Open new SVG file
 	FILE *file;
-	file = fopen("./output/edgeIdMap.svg", "w");
+	file = fopen(path.c_str(), "w");
 
 	if (!file)
 	{
-		std::cerr << "Failed to write edgeIdMap.svg. Check folder structure." << std::endl;
-		return;
+		std::cerr << "Failed to write " << path << ". Check folder structure." << std::endl;
+		return false;
 	}
 
 	// Setup SVG canvas
@@ -228,7 +653,7 @@ void Visualizer::saveEdgeIdMapAsSVG(cv::Mat &img, const EdgeMap &edgeMap, bool s
 	{
 		for (int x = 0; x < cols; x++)
 		{
-			const std::vector<int> &edgeIds = edgeMap.getEdgeIds(x, y);
+			EdgeIdSpan edgeIds = edgeMap.getEdgeIds(x, y);
 
 			// At most positions edgeIds.size() is 0 (no edge), loop is skipped then
 			for (int i = 0; i < (int)edgeIds.size(); i++)
@@ -275,38 +700,38 @@ void Visualizer::saveEdgeIdMapAsSVG(cv::Mat &img, const EdgeMap &edgeMap, bool s
 	fprintf(file, "</svg>");
 	fclose(file);
 
-	std::cout << "File edgeIdMap.svg written.\n";
+	if (printMessage)
+	{
+		std::cout << "File " << path << " written.\n";
+	}
+
+	return true;
 }
 
-void Visualizer::saveEdgesAsBinaryImage(cv::Mat &img, const Edges &edges)
+bool Visualizer::saveEdgesAsBinaryImage(cv::Mat &img, const Edges &edges, const std::string &path)
 {
 	cv::Mat blank_image = cv::Mat::zeros(img.size(), CV_8UC1);
 
-	// Get all traced edges
-	const std::vector<std::vector<cv::Point>> &edgesData = edges.getEdges();
-
-	// Draw edges exclusively based on edgesData
-	for (int i = 0; i < (int)edgesData.size(); i++)
+	// Draw edges exclusively based on the traced edges
+	for (int i = 0; i < (int)edges.size(); i++)
 	{
-		for (int j = 0; j < (int)edgesData[i].size(); j++)
+		for (const auto& point : edges.getPoints(i))
 		{
-			// Position
-			int x = edgesData[i][j].x;
-			int y = edgesData[i][j].y;
-
-			blank_image.at<uchar>(y, x) = 255;
+			blank_image.at<uchar>(point.y, point.x) = 255;
 		}
 	}
 
 	// Write the output image
-	bool writeSuccess = cv::imwrite("./output/binary_edges.png", blank_image);
+	bool writeSuccess = cv::imwrite(path, blank_image);
 
 	if (writeSuccess)
 	{
-		std::cout << "File binary_edges.png written.\n";
+		std::cout << "File " << path << " written.\n";
 	}
 	else
 	{
-		std::cerr << "Failed to write binary_edges.png." << std::endl;
+		std::cerr << "Failed to write " << path << "." << std::endl;
 	}
+
+	return writeSuccess;
 }
@@ -1,6 +1,8 @@
 #ifndef VISUALIZER_H
 #define VISUALIZER_H
 
+#include <string>
+
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs.hpp>
 
@@ -15,21 +17,35 @@ public:
 	 * 	@edges 			Internal class which holds the traced edges.
 	 * 	@edgeMap		Internal class to represent the edgeIdMap and edgeClusterMap.
 	 *  @showInput		Draw pixels of input image.
+	 *  @path			Path of the SVG file.
+	 *  @returns		True if the file was written.
+	 */
+	static bool saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap &edgeMap, bool showInput=true, const std::string &path="./output/tracedEdges.svg");
+
+	/** Write the same picture as saveResultAsSVG with much smaller output: each edge is one path of horizontal and vertical
+	 *  pixel runs, markers are grouped and the file is written through large buffers by a background thread.
+	 *  Parameters as for saveResultAsSVG.
+	 *  @printMessage	Print a message when the file is written (off for concurrent writers, whose messages would interleave).
 	 */
-	static void saveResultAsSVG(cv::Mat &img, const Edges &edges, const EdgeMap &edgeMap, bool showInput=true);
+	static bool saveResultAsCompactSVG(cv::Mat &img, const Edges &edges, const EdgeMap &edgeMap, bool showInput=true, const std::string &path="./output/tracedEdges.svg", bool printMessage=true);
 
 	/** Write SVG visualization based on edgeIdMap.
 	 * 	@img			Input image (used to adopt the height and width of the output).
 	 * 	@edgeMap		Internal class to represent the edgeIdMap and edgeClusterMap.
 	 *  @showInput		Draw pixels of input image.
+	 *  @path			Path of the SVG file.
+	 *  @printMessage	Print a message when the file is written.
+	 *  @returns		True if the file was written.
 	 */
-	static void saveEdgeIdMapAsSVG(cv::Mat &img, const EdgeMap &edgeMap, bool showInput=true);
+	static bool saveEdgeIdMapAsSVG(cv::Mat &img, const EdgeMap &edgeMap, bool showInput=true, const std::string &path="./output/edgeIdMap.svg", bool printMessage=true);
 
 	/** Write a binary edge image based on the passed edges.
 	 * 	@img			Input image (used to adopt the height and width of the output).
 	 * 	@edges 			Internal class which holds the traced edges.
+	 *  @path			Path of the image file.
+	 *  @returns		True if the file was written.
 	 */
-	static void saveEdgesAsBinaryImage(cv::Mat &img, const Edges &edges);
+	static bool saveEdgesAsBinaryImage(cv::Mat &img, const Edges &edges, const std::string &path="./output/binary_edges.png");
 };
 
 #endif // VISUALIZER_H
@@ -0,0 +1,277 @@
+#include "edgetracing.h"
+
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "EdgeProcessor.h"
+
+namespace
+{
+	/** Flat arrays of a list of point lists, built on request.
+	 */
+	struct PointLists
+	{
+		std::vector<et_point> points;
+		std::vector<size_t> offsets;
+		bool valid = false;
+
+		void clear()
+		{
+			points.clear();
+			offsets.clear();
+			valid = false;
+		}
+
+		/** Builds the arrays from numberOfLists point lists, getList(i) returns the points of list i.
+		 */
+		template <typename GetList>
+		void assign(size_t numberOfLists, GetList getList)
+		{
+			points.clear();
+			offsets.assign(1, 0);
+
+			for (size_t i = 0; i < numberOfLists; i++)
+			{
+				for (const auto& point : getList(i))
+				{
+					points.push_back({point.x, point.y});
+				}
+
+				offsets.push_back(points.size());
+			}
+
+			valid = true;
+		}
+
+		void get(et_point_lists *lists) const
+		{
+			lists->points = points.data();
+			lists->offsets = offsets.data();
+			lists->number_of_lists = offsets.size() - 1;
+			lists->number_of_points = points.size();
+		}
+
+		int copy(et_point *pointBuffer, size_t pointsCapacity, size_t *offsetBuffer, size_t offsetsCapacity,
+				 size_t *numberOfPoints, size_t *numberOfLists) const
+		{
+			if (numberOfPoints)
+			{
+				*numberOfPoints = points.size();
+			}
+
+			if (numberOfLists)
+			{
+				*numberOfLists = offsets.size() - 1;
+			}
+
+			if (pointsCapacity < points.size() || offsetsCapacity < offsets.size() || (!pointBuffer && !points.empty()) || !offsetBuffer)
+			{
+				return ET_BUFFER_TOO_SMALL;
+			}
+
+			std::copy(points.begin(), points.end(), pointBuffer);
+			std::copy(offsets.begin(), offsets.end(), offsetBuffer);
+			return ET_OK;
+		}
+	};
+
+	/** Exceptions must not cross the C interface.
+	 */
+	template <typename Function>
+	int callSafely(Function function)
+	{
+		try
+		{
+			return function();
+		}
+		catch (const std::exception &)
+		{
+			return ET_INTERNAL_ERROR;
+		}
+		catch (...)
+		{
+			return ET_INTERNAL_ERROR;
+		}
+	}
+
+} // end namespace
+
+struct et_tracer
+{
+	EdgeProcessor edgeProcessor;
+	PointLists edges;
+	PointLists clusters;
+	bool traced = false;
+
+	/** Results which are not built yet are built from the current state of the EdgeProcessor.
+	 */
+	void updateEdges()
+	{
+		if (!edges.valid)
+		{
+			const Edges &tracedEdges = edgeProcessor.getEdges();
+			edges.assign(tracedEdges.size(), [&](size_t i) { return tracedEdges.getPoints(i); });
+		}
+	}
+
+	void updateClusters()
+	{
+		if (!clusters.valid)
+		{
+			std::vector<const std::vector<cv::Point> *> clusterPoints = edgeProcessor.getEdgeIdMap().getAllClusterPoints();
+			clusters.assign(clusterPoints.size(), [&](size_t i) -> const std::vector<cv::Point> & { return *clusterPoints[i]; });
+		}
+	}
+
+	void invalidate()
+	{
+		edges.clear();
+		clusters.clear();
+	}
+};
+
+extern "C" {
+
+et_tracer *et_create(void)
+{
+	try
+	{
+		return new et_tracer();
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void et_destroy(et_tracer *tracer)
+{
+	delete tracer;
+}
+
+int et_set_number_of_threads(et_tracer *tracer, int number_of_threads)
+{
+	if (!tracer || number_of_threads < 0)
+	{
+		return ET_INVALID_ARGUMENT;
+	}
+
+	tracer->edgeProcessor.setNumberOfThreads(number_of_threads);
+	return ET_OK;
+}
+
+int et_trace(et_tracer *tracer, const uint8_t *data, size_t stride, int width, int height)
+{
+	if (!tracer || !data || width <= 0 || height <= 0 || stride < static_cast<size_t>(width))
+	{
+		return ET_INVALID_ARGUMENT;
+	}
+
+	return callSafely([&]
+	{
+		// Header around the pixels of the caller, tracing only reads the image
+		cv::Mat img(height, width, CV_8UC1, const_cast<uint8_t *>(data), stride);
+
+		tracer->invalidate();
+		tracer->edgeProcessor.traceEdges(img);
+		tracer->traced = true;
+		return ET_OK;
+	});
+}
+
+int et_clean_up_edges(et_tracer *tracer)
+{
+	if (!tracer || !tracer->traced)
+	{
+		return ET_INVALID_ARGUMENT;
+	}
+
+	return callSafely([&]
+	{
+		tracer->invalidate();
+		tracer->edgeProcessor.cleanUpEdges();
+		return ET_OK;
+	});
+}
+
+int et_get_edges(et_tracer *tracer, et_point_lists *edges)
+{
+	if (!tracer || !tracer->traced || !edges)
+	{
+		return ET_INVALID_ARGUMENT;
+	}
+
+	return callSafely([&]
+	{
+		tracer->updateEdges();
+		tracer->edges.get(edges);
+		return ET_OK;
+	});
+}
+
+int et_get_clusters(et_tracer *tracer, et_point_lists *clusters)
+{
+	if (!tracer || !tracer->traced || !clusters)
+	{
+		return ET_INVALID_ARGUMENT;
+	}
+
+	return callSafely([&]
+	{
+		tracer->updateClusters();
+		tracer->clusters.get(clusters);
+		return ET_OK;
+	});
+}
+
+int et_copy_edges(et_tracer *tracer, et_point *points, size_t points_capacity, size_t *offsets, size_t offsets_capacity,
+				  size_t *number_of_points, size_t *number_of_edges)
+{
+	if (!tracer || !tracer->traced)
+	{
+		return ET_INVALID_ARGUMENT;
+	}
+
+	return callSafely([&]
+	{
+		tracer->updateEdges();
+		return tracer->edges.copy(points, points_capacity, offsets, offsets_capacity, number_of_points, number_of_edges);
+	});
+}
+
+int et_copy_clusters(et_tracer *tracer, et_point *points, size_t points_capacity, size_t *offsets, size_t offsets_capacity,
+					 size_t *number_of_points, size_t *number_of_clusters)
+{
+	if (!tracer || !tracer->traced)
+	{
+		return ET_INVALID_ARGUMENT;
+	}
+
+	return callSafely([&]
+	{
+		tracer->updateClusters();
+		return tracer->clusters.copy(points, points_capacity, offsets, offsets_capacity, number_of_points, number_of_clusters);
+	});
+}
+
+const char *et_status_string(int status)
+{
+	switch (status)
+	{
+		case ET_OK:
+			return "OK";
+		case ET_INVALID_ARGUMENT:
+			return "Invalid argument";
+		case ET_BUFFER_TOO_SMALL:
+			return "Buffer too small";
+		case ET_INTERNAL_ERROR:
+			return "Internal error";
+		default:
+			return "Unknown status";
+	}
+}
+
+} // extern "C"
@@ -0,0 +1,97 @@
+#ifndef EDGETRACING_H
+#define EDGETRACING_H
+
+/*
+C interface of the edge tracing library. It needs neither OpenCV nor C++ at the call site: the binary image is passed
+as pointer, row stride, width and height and is read in place (no copy). Results are returned as flat arrays, either
+owned by the library (valid until the next call which modifies the tracer) or copied into buffers of the caller.
+
+Flat arrays: the points of edge i are points[offsets[i]] ... points[offsets[i + 1] - 1], offsets has one entry more
+than the number of edges. Clusters are returned in the same layout.
+
+All functions return ET_OK on success or a negative status code (see et_status_string).
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Status codes. */
+enum
+{
+	ET_OK = 0,
+	ET_INVALID_ARGUMENT = -1,	/* Null pointer, invalid size or stride. */
+	ET_BUFFER_TOO_SMALL = -2,	/* Buffer of the caller is too small, the required sizes are returned. */
+	ET_INTERNAL_ERROR = -3		/* Exception inside of the library (e.g. out of memory). */
+};
+
+/** Opaque tracer (one EdgeProcessor), not thread-safe. Use one tracer per thread. */
+typedef struct et_tracer et_tracer;
+
+/** Pixel position. */
+typedef struct et_point
+{
+	int32_t x;
+	int32_t y;
+} et_point;
+
+/** Flat arrays of edges or clusters (see above). */
+typedef struct et_point_lists
+{
+	const et_point *points;		/* All points, concatenated. */
+	const size_t *offsets;		/* Start of each list in points, number_of_lists + 1 entries. */
+	size_t number_of_lists;		/* Number of edges or clusters. */
+	size_t number_of_points;	/* Total number of points (= offsets[number_of_lists]). */
+} et_point_lists;
+
+/** Creates a tracer, returns NULL if out of memory. */
+et_tracer *et_create(void);
+
+/** Destroys a tracer and all library-owned results (NULL is ignored). */
+void et_destroy(et_tracer *tracer);
+
+/** Number of threads used by et_trace (default: 1, 0 = number of hardware threads). */
+int et_set_number_of_threads(et_tracer *tracer, int number_of_threads);
+
+/** Traces a binary edge image (pixels > 0 are edge pixels). The image is only read during the call.
+ *  data		First pixel of the first row (8 bit per pixel).
+ *  stride		Distance between the first pixels of two rows in bytes (>= width).
+ *  width		Number of columns.
+ *  height		Number of rows.
+ */
+int et_trace(et_tracer *tracer, const uint8_t *data, size_t stride, int width, int height);
+
+/** Removes empty edges and makes the edge identifiers continuous (see EdgeProcessor::cleanUpEdges). */
+int et_clean_up_edges(et_tracer *tracer);
+
+/** Library-owned edges of the last trace, valid until the next call of et_trace, et_clean_up_edges or et_destroy. */
+int et_get_edges(et_tracer *tracer, et_point_lists *edges);
+
+/** Library-owned clusters of the last trace, valid until the next call of et_trace, et_clean_up_edges or et_destroy. */
+int et_get_clusters(et_tracer *tracer, et_point_lists *clusters);
+
+/** Copies the edges into buffers of the caller. Returns ET_BUFFER_TOO_SMALL if a capacity is too small, the required
+ *  sizes are returned in any case.
+ *  points				Buffer for points_capacity points (may be NULL if points_capacity is 0).
+ *  offsets				Buffer for offsets_capacity offsets (number of edges + 1 are needed).
+ *  number_of_points	Output: total number of points.
+ *  number_of_edges		Output: number of edges.
+ */
+int et_copy_edges(et_tracer *tracer, et_point *points, size_t points_capacity, size_t *offsets, size_t offsets_capacity,
+				  size_t *number_of_points, size_t *number_of_edges);
+
+/** Copies the clusters into buffers of the caller (same as et_copy_edges). */
+int et_copy_clusters(et_tracer *tracer, et_point *points, size_t points_capacity, size_t *offsets, size_t offsets_capacity,
+					 size_t *number_of_points, size_t *number_of_clusters);
+
+/** Description of a status code. */
+const char *et_status_string(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EDGETRACING_H */
@@ -1,25 +1,77 @@
 #include <iostream>
+#include <string>
 
 // OpenCV
 #include <opencv2/core.hpp>
 #include <opencv2/imgcodecs/imgcodecs.hpp>
 
 // Classes for tracing and result visualization
+#include "BatchProcessor.h"
 #include "EdgeProcessor.h"
+#include "ResultFile.h"
+#include "TracingStatistics.h"
 #include "Visualizer.h"
 
+/** Batch mode: tracing --batch <directory | pattern | manifest.txt> [output directory] [number of threads]
+ */
+int processBatch(int argc, const char *argv[])
+{
+	BatchProcessor batchProcessor;
+
+	if (argc > 3)
+	{
+		batchProcessor.setOutputDirectory(argv[3]);
+	}
+
+	if (argc > 4)
+	{
+		batchProcessor.setNumberOfThreads(std::stoi(argv[4]));
+	}
+
+	// === POSTPROCESSING (applied to each image, see below)
+	// batchProcessor.setPostprocessing([](EdgeProcessor &edgeProcessor) { edgeProcessor.removeEdgesShorterThan(3); });
+	// ===
+
+	std::string baseDirectory;
+	std::vector<std::string> paths = BatchProcessor::collectInputs(argv[2], baseDirectory);
+
+	if (paths.empty())
+	{
+		std::cout << "No images found for " << argv[2] << ". Quit." << std::endl;
+		return -1;
+	}
+
+	std::cout << "Process " << paths.size() << " images..." << std::endl;
+	BatchStatistics statistics = batchProcessor.process(paths, baseDirectory);
+	BatchProcessor::printStatistics(statistics);
+
+	return (statistics.numberOfFailures == 0) ? 0 : 1;
+}
+
 int main(int argc, const char *argv[])
 {
 	cv::Mat img;
 
+	if (argc > 2 && std::string(argv[1]) == "--batch")
+	{
+		return processBatch(argc, argv);
+	}
+
+	// tracing <input image> --json: print the phase times and counters as JSON instead of the status messages
+	bool printJson = (argc > 2 && std::string(argv[2]) == "--json");
+
 	if (argc > 1)
 	{
-		std::cout << "Read Image..." << argv[1] << std::endl;
+		if (!printJson)
+		{
+			std::cout << "Read Image..." << argv[1] << std::endl;
+		}
+
 		img = cv::imread(argv[1], 0);
 
 		if (!img.data)
 		{
-			std::cout << "Could not find or open image. Quit." << std::endl;
+			std::cerr << "Could not find or open image. Quit." << std::endl;
 			return -1;
 		}
 	}
@@ -30,7 +82,9 @@ int main(int argc, const char *argv[])
 	}
 
 	// Identify ambiguities and trace edges
+	TracingStatistics statistics;
 	EdgeProcessor edgeProcessor;
+	edgeProcessor.setStatistics(&statistics);
 	edgeProcessor.traceEdges(img);
 
 	// === POSTPROCESSING
@@ -43,7 +97,11 @@ int main(int argc, const char *argv[])
 
 	// Clean up edges and print status information
 	edgeProcessor.cleanUpEdges(); // Remove empty edges from vector and adjust edgeIdMap for continuous edgeIds (optional)
-	edgeProcessor.printEdgeInfos(img);
+
+	if (!printJson)
+	{
+		edgeProcessor.printEdgeInfos(img);
+	}
 
 	// Get read-only references to internal edges and edgeIdMap
 	const Edges &edges = edgeProcessor.getEdges();
@@ -51,10 +109,17 @@ int main(int argc, const char *argv[])
 
 	// Visualization of the overall result and edgeIdMap
 	// Add these lines after each step to view intermediate results
-	Visualizer::saveResultAsSVG(img, edges, edgeMap);
-	Visualizer::saveEdgeIdMapAsSVG(img, edgeMap);
+	Visualizer::saveResultAsCompactSVG(img, edges, edgeMap, true, "./output/tracedEdges.svg", !printJson); // Same picture as saveResultAsSVG, much smaller file
+	Visualizer::saveEdgeIdMapAsSVG(img, edgeMap, true, "./output/edgeIdMap.svg", !printJson);
+	ResultFileWriter::write(edges, edgeMap, true, "./output/tracedEdges.etr", !printJson); // Binary result for further processing (read with ResultFileReader)
 	//Visualizer::saveEdgesAsBinaryImage(img, edges);
 
+	if (printJson)
+	{
+		statistics.writeJson(std::cout);
+		return 0;
+	}
+
 	std::cout << "Finished." << std::endl;
 	return 0;
 }
@@ -0,0 +1,498 @@
+// Randomized differential test of Edges: applies random sequences of all operations to an Edges object and to a plain
+// vector of edges (the reference) and compares both after each operation. The storage is switched at random, so every
+// sequence runs through the points, chain code and pool storage, including joined edges, in-place overwrites, the
+// widening of the pool to 32 bit and the compaction of the buffers.
+//
+// Usage: edges_test [rounds (default: 24)] [operations per round (default: 8000)]
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "Edges.h"
+
+namespace
+{
+	constexpr size_t MAX_EDGES = 48;			// More edges are erased instead of added
+	constexpr size_t MAX_EDGE_SIZE = 120;
+	constexpr size_t SHORT_EDGE_SIZE = 6;		// Every third edge is at most this long (joins skip over whole pieces)
+	constexpr size_t MAX_SKIP = 4;				// Points left out by join at each end
+	constexpr size_t REBUILD_INTERVAL = 2000;	// Mean number of operations between setStorage or reverseAll, which rebuild
+												// the chain code buffers (lets the unused bytes grow until compaction)
+	constexpr int COORDINATE_RANGE = 1000;		// Start points of regular edges, at least MAX_EDGE_SIZE from the borders
+
+	using Edge = std::vector<cv::Point>;
+
+	const char *getStorageName(Edges::Storage storage)
+	{
+		switch (storage)
+		{
+			case Edges::Storage::ChainCode: return "ChainCode";
+			case Edges::Storage::Pool: return "Pool";
+			default: return "Points";
+		}
+	}
+
+	std::string toString(const Edge &edge)
+	{
+		std::ostringstream stream;
+		stream << "[" << edge.size() << "]";
+
+		for (const auto& point : edge)
+		{
+			stream << " " << point.x << "," << point.y;
+		}
+
+		return stream.str();
+	}
+
+	/** One sequence of random operations on an Edges object and on the reference.
+	 */
+	class DifferentialTest
+	{
+	public:
+		DifferentialTest(unsigned int seed, Edges::Storage storage) : random(seed), allowWidePool(seed % 2 == 1)
+		{
+			edges.setStorage(storage);
+		}
+
+		void run(int numberOfOperations)
+		{
+			for (operationIndex = 0; operationIndex < numberOfOperations; operationIndex++)
+			{
+				applyRandomOperation();
+				checkAllEdges();
+			}
+		}
+
+	private:
+		std::mt19937 random;
+		bool allowWidePool;				//!< Edges may have coordinates outside [0, 65535] (widens the pool).
+		Edges edges;
+		std::vector<Edge> reference;	//!< Same edges as a vector of points per edgeId.
+		bool joined = false;			//!< Edges may have been joined since the last flattening (getPoints not allowed).
+		int operationIndex = 0;
+		std::string operation;			//!< Last operation, for the failure message.
+
+		size_t uniform(size_t max)
+		{
+			return std::uniform_int_distribution<size_t>(0, max)(random);
+		}
+
+		int randomEdgeId()
+		{
+			return uniform(reference.size() - 1);
+		}
+
+		void fail(const std::string &what)
+		{
+			std::ostringstream message;
+			message << what << " (storage " << getStorageName(edges.getStorage()) << ", operation " << operationIndex << ": " << operation << ")";
+			throw std::runtime_error(message.str());
+		}
+
+		void expect(bool condition, const std::string &what)
+		{
+			if (!condition)
+			{
+				fail(what);
+			}
+		}
+
+		/** Random walk of 8-neighbor steps, some edges have one step to a non-neighbor or coordinates outside 16 bit.
+		 */
+		Edge randomEdge(size_t maxSize)
+		{
+			if (uniform(2) == 0)
+			{
+				maxSize = std::min(maxSize, SHORT_EDGE_SIZE);
+			}
+
+			Edge edge(uniform(8) == 0 ? 0 : uniform(maxSize));
+
+			if (edge.empty())
+			{
+				return edge;
+			}
+
+			cv::Point point(MAX_EDGE_SIZE + uniform(COORDINATE_RANGE - 2 * MAX_EDGE_SIZE), MAX_EDGE_SIZE + uniform(COORDINATE_RANGE - 2 * MAX_EDGE_SIZE));
+
+			if (allowWidePool && uniform(16) == 0)
+			{
+				point = (uniform(1) == 0) ? cv::Point(-5, point.y) : cv::Point(UINT16_MAX - 20, point.y);
+			}
+
+			size_t jump = (uniform(3) == 0) ? uniform(edge.size()) : edge.size();
+
+			for (size_t i = 0; i < edge.size(); i++)
+			{
+				edge[i] = point;
+
+				if (i + 1 == jump)
+				{
+					point += cv::Point(2 + (int)uniform(3), -2 - (int)uniform(3));
+				}
+				else
+				{
+					cv::Point step;
+
+					while (step == cv::Point())
+					{
+						step = cv::Point((int)uniform(2) - 1, (int)uniform(2) - 1);
+					}
+
+					point += step;
+				}
+			}
+
+			return edge;
+		}
+
+		void applyRandomOperation()
+		{
+			size_t choice = (uniform(REBUILD_INTERVAL) == 0) ? 18 + uniform(1) : uniform(17);
+
+			// Keep the number of edges bounded
+			if (reference.empty() && choice > 1)
+			{
+				choice = 0;
+			}
+			else if (reference.size() >= MAX_EDGES && choice <= 1)
+			{
+				choice = 9;
+			}
+
+			switch (choice)
+			{
+				case 0:
+				{
+					operation = "pushBack";
+					Edge edge = randomEdge(MAX_EDGE_SIZE);
+					edges.pushBack(edge);
+					reference.push_back(edge);
+					break;
+				}
+				case 1:
+				{
+					size_t edgeId = uniform(reference.size());
+					operation = "insert " + std::to_string(edgeId);
+					Edge edge = randomEdge(MAX_EDGE_SIZE);
+					edges.insert(edgeId, edge);
+					reference.insert(reference.begin() + edgeId, edge);
+					joined = false;
+					break;
+				}
+				case 2:
+				case 3:
+				{
+					// Shorter edges are overwritten in place in the pool
+					int edgeId = randomEdgeId();
+					operation = "overwrite " + std::to_string(edgeId);
+					Edge edge = randomEdge((choice == 2) ? MAX_EDGE_SIZE : reference[edgeId].size());
+					edges.overwrite(edgeId, edge);
+					reference[edgeId] = edge;
+					break;
+				}
+				case 4:
+				case 5:
+				case 6:
+				{
+					if (reference.size() < 2)
+					{
+						operation = "none";
+						break;
+					}
+
+					int edgeId = randomEdgeId();
+					int otherId = randomEdgeId();
+
+					if (edgeId == otherId)
+					{
+						otherId = (otherId + 1) % reference.size();
+					}
+
+					join(edgeId, otherId, uniform(1) == 1, uniform(1) == 1, uniform(MAX_SKIP), uniform(MAX_SKIP));
+					break;
+				}
+				case 7:
+				{
+					operation = "popBack";
+					edges.popBack();
+					reference.pop_back();
+					break;
+				}
+				case 8:
+				{
+					int edgeId = randomEdgeId();
+					operation = "clearEdge " + std::to_string(edgeId);
+					edges.clearEdge(edgeId);
+					reference[edgeId].clear();
+					break;
+				}
+				case 9:
+				{
+					int edgeId = randomEdgeId();
+					operation = "eraseEdge " + std::to_string(edgeId);
+					edges.eraseEdge(edgeId);
+					reference.erase(reference.begin() + edgeId);
+					joined = false;
+					break;
+				}
+				case 10:
+				{
+					Edge edge = reference[randomEdgeId()];
+					operation = "eraseEdge " + toString(edge);
+					edges.eraseEdge(edge);
+					reference.erase(std::find(reference.begin(), reference.end(), edge));
+					joined = false;
+					break;
+				}
+				case 11:
+				{
+					eraseEmptyEdges();
+					break;
+				}
+				case 18:
+				{
+					operation = "reverseAll";
+					edges.reverseAll();
+
+					for (auto& edge : reference)
+					{
+						std::reverse(edge.begin(), edge.end());
+					}
+
+					joined = false;
+					break;
+				}
+				case 13:
+				{
+					operation = "flattenJoinedEdges";
+					edges.flattenJoinedEdges();
+					joined = false;
+					break;
+				}
+				case 14:
+				{
+					// Duplicates for getEdgeId and getEdgeIds
+					if (reference.size() >= MAX_EDGES)
+					{
+						operation = "none";
+						break;
+					}
+
+					Edge edge = reference[randomEdgeId()];
+					operation = "pushBack copy";
+					edges.pushBack(edge);
+					reference.push_back(edge);
+					break;
+				}
+				case 15:
+				{
+					checkEdgeIds();
+					break;
+				}
+				case 16:
+				case 17:
+				{
+					checkPointsAlongEdge();
+					break;
+				}
+				case 12:
+				{
+					checkClosedEdges();
+					break;
+				}
+				default:
+				{
+					Edges::Storage storage = static_cast<Edges::Storage>(uniform(2));
+					operation = std::string("setStorage ") + getStorageName(storage);
+					edges.setStorage(storage);
+					break;
+				}
+			}
+		}
+
+		void join(int edgeId, int otherId, bool prepend, bool reverseOther, size_t skipFront, size_t skipBack)
+		{
+			std::ostringstream description;
+			description << "join " << edgeId << " " << otherId << " prepend " << prepend << " reverse " << reverseOther
+						<< " skip " << skipFront << " " << skipBack;
+			operation = description.str();
+
+			edges.join(edgeId, otherId, prepend, reverseOther, skipFront, skipBack);
+
+			Edge &other = reference[otherId];
+			size_t front = std::min(skipFront, other.size());
+			size_t back = std::min(skipBack, other.size() - front);
+			Edge moved(other.begin() + front, other.end() - back);
+
+			if (reverseOther)
+			{
+				std::reverse(moved.begin(), moved.end());
+			}
+
+			Edge &edge = reference[edgeId];
+			edge.insert(prepend ? edge.begin() : edge.end(), moved.begin(), moved.end());
+			other.clear();
+			joined = true;
+		}
+
+		void eraseEmptyEdges()
+		{
+			operation = "eraseEmptyEdges";
+			std::vector<int> newEdgeIds = edges.eraseEmptyEdges();
+			expect(newEdgeIds.size() == reference.size(), "size of the edgeId remap");
+
+			std::vector<Edge> remaining;
+
+			for (size_t edgeId = 0; edgeId < reference.size(); edgeId++)
+			{
+				expect(newEdgeIds[edgeId] == (reference[edgeId].empty() ? -1 : (int)remaining.size()), "remap of edge " + std::to_string(edgeId));
+
+				if (!reference[edgeId].empty())
+				{
+					remaining.push_back(reference[edgeId]);
+				}
+			}
+
+			reference = std::move(remaining);
+			joined = false;
+		}
+
+		void checkEdgeIds()
+		{
+			operation = "getEdgeId";
+			int edgeId = randomEdgeId();
+			size_t firstEqual = std::find(reference.begin(), reference.end(), reference[edgeId]) - reference.begin();
+
+			expect(edges.getEdgeId(reference[edgeId]) == (int)firstEqual, "getEdgeId of the points of edge " + std::to_string(edgeId));
+			expect(edges.getEdgeId(edgeId) == (int)firstEqual, "getEdgeId of edge " + std::to_string(edgeId));
+			expect(edges.getEdgeId(Edge(1, cv::Point(-COORDINATE_RANGE, -COORDINATE_RANGE))) == (int)reference.size(), "getEdgeId of a missing edge");
+
+			std::vector<int> edgeIds = edges.getEdgeIds();
+			expect(edgeIds.size() == reference.size(), "size of getEdgeIds");
+
+			for (size_t i = 0; i < reference.size(); i++)
+			{
+				int expected = std::find(reference.begin(), reference.end(), reference[i]) - reference.begin();
+				expect(edgeIds[i] == expected, "getEdgeIds of edge " + std::to_string(i));
+			}
+
+			joined = false;
+		}
+
+		void checkPointsAlongEdge()
+		{
+			int edgeId = randomEdgeId();
+			const Edge &edge = reference[edgeId];
+			size_t numberPixels = uniform(edge.size() + 2);
+			cv::Point point(-1, -1);
+
+			if (!edge.empty())
+			{
+				size_t choice = uniform(4);
+				point = (choice == 0) ? edge[uniform(edge.size() - 1)] : (choice % 2 == 1) ? edge.front() : edge.back();
+			}
+
+			operation = "getPointsAlongEdgeFromPoint " + std::to_string(edgeId) + " " + std::to_string(numberPixels);
+
+			Edge expected;
+
+			if (!edge.empty() && (point == edge.front() || point == edge.back()))
+			{
+				size_t n = std::min(numberPixels, edge.size());
+
+				if (point == edge.front())
+				{
+					expected.assign(edge.begin(), edge.begin() + n);
+				}
+				else
+				{
+					expected.assign(edge.rbegin(), edge.rbegin() + n);
+				}
+			}
+
+			expect(edges.getPointsAlongEdgeFromPoint(edgeId, point, numberPixels) == expected, "points along edge " + toString(edge));
+		}
+
+		void checkClosedEdges()
+		{
+			operation = "isClosed";
+
+			for (size_t edgeId = 0; edgeId < reference.size(); edgeId++)
+			{
+				const Edge &edge = reference[edgeId];
+
+				if (edge.empty())
+				{
+					continue;
+				}
+
+				cv::Point distance = edge.front() - edge.back();
+				bool neighbors = std::abs(distance.x) <= 1 && std::abs(distance.y) <= 1;
+
+				expect(edges.isClosed(edgeId) == (neighbors && edge.size() >= 4), "isClosed of edge " + std::to_string(edgeId));
+				expect(edges.isThreePixelL(edgeId) == (neighbors && edge.size() == 3), "isThreePixelL of edge " + std::to_string(edgeId));
+			}
+		}
+
+		void checkAllEdges()
+		{
+			expect(edges.size() == reference.size(), "number of edges " + std::to_string(edges.size()) + " instead of " + std::to_string(reference.size()));
+
+			for (size_t edgeId = 0; edgeId < reference.size(); edgeId++)
+			{
+				const Edge &edge = reference[edgeId];
+				Edge actual = edges.getEdge(edgeId);
+				bool equal = edges.getEdgeSize(edgeId) == edge.size() && actual == edge
+					&& (edge.empty() || (edges.getStartPoint(edgeId) == edge.front() && edges.getEndPoint(edgeId) == edge.back()));
+
+				// getPoints reads only stored edges
+				if (equal && !joined)
+				{
+					EdgePoints points = edges.getPoints(edgeId);
+					equal = points.size() == edge.size() && points.toVector() == edge
+						&& (edge.empty() || (points.front() == edge.front() && points.back() == edge.back()));
+				}
+
+				if (!equal)
+				{
+					fail("Edge " + std::to_string(edgeId) + " is " + toString(actual) + ", expected " + toString(edge));
+				}
+			}
+		}
+	};
+
+} // end namespace
+
+int main(int argc, const char *argv[])
+{
+	int rounds = (argc > 1) ? std::stoi(argv[1]) : 24;
+	int numberOfOperations = (argc > 2) ? std::stoi(argv[2]) : 8000;
+
+	for (int round = 0; round < rounds; round++)
+	{
+		Edges::Storage storage = static_cast<Edges::Storage>(round % 3);
+
+		try
+		{
+			DifferentialTest(round, storage).run(numberOfOperations);
+		}
+		catch (const std::exception &exception)
+		{
+			std::cerr << "Round " << round << " (started with storage " << getStorageName(storage) << ") failed: " << exception.what() << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << rounds << " rounds of " << numberOfOperations << " operations passed." << std::endl;
+	return 0;
+}